@@ -1,130 +1,263 @@
 import subprocess
-import re
 import json
+import math
 import os
 import argparse
-from typing import Dict, List, Optional
+import tempfile
+from typing import Dict, List, Optional, Tuple
+
+# Two-sided 95% Student t quantiles for 1..30 degrees of freedom.
+T_95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+# Largest acceptable relative residual ||b - Ax|| / ||b||.
+RESIDUAL_LIMIT = 1e-12
+
+
+def t_quantile(df: float) -> float:
+    """95% two-sided Student t quantile, normal beyond 30 degrees of freedom."""
+    if df < 1:
+        return float("inf")
+    return T_95[int(df) - 1] if df <= 30 else 1.96
+
+
+def summarize(samples: List[float]) -> Dict:
+    """Mean, standard deviation and 95% confidence half-width of the mean."""
+    n = len(samples)
+    mean = sum(samples) / n if n else 0.0
+    stdev = math.sqrt(sum((x - mean) ** 2 for x in samples) / (n - 1)) if n > 1 else 0.0
+    ci = t_quantile(n - 1) * stdev / math.sqrt(n) if n > 1 else float("inf")
+    return {"mean": mean, "stdev": stdev, "ci95": ci, "count": n}
+
+
+def ratio_ci(num: Dict, den: Dict) -> Tuple[float, float]:
+    """Ratio of two means and its 95% half-width by first-order error propagation."""
+    if num["mean"] <= 0 or den["mean"] <= 0:
+        return 0.0, float("inf")
+    ratio = num["mean"] / den["mean"]
+    return ratio, ratio * math.hypot(num["ci95"] / num["mean"], den["ci95"] / den["mean"])
+
 
 class BenchmarkRunner:
     def __init__(self, executable_path: str = "./build/cholesky_solver"):
         self.executable_path = executable_path
 
-    def run_config(self, n: int, m: int, threads: int) -> Dict:
-        """Runs the solver with given configuration and returns parsed results."""
-        cmd = [self.executable_path, str(n), str(m), str(threads)]
+    def run_config(self, n: int, m: int, threads: int, engine: str = "dag") -> Dict:
+        """Runs the solver once and returns its JSON report (see src/report.h)."""
+        with tempfile.NamedTemporaryFile(suffix=".json", delete=False) as report:
+            report_path = report.name
+        cmd = [self.executable_path, "-e", engine, "-j", report_path, str(n), str(m), str(threads)]
         try:
-            result = subprocess.run(cmd, capture_output=True, text=True, check=True)
-            output = result.stdout
-            
-            # Parsing logic
-            metrics_match = re.search(r"Error:\s+([\d.e+-]+)\s+;\s+Residual:\s+([\d.e+-]+)\s+\(([\d.e+-]+)\)", output)
-            wall_time_match = re.search(r"Total time in seconds:\s+([\d.]+)", output)
-            cpu_time_match = re.search(r"CPU time in seconds:\s+([\d.]+)", output)
-
-            res = {
-                "n": n,
-                "m": m,
-                "threads": threads,
-                "success": True,
-                "error": float(metrics_match.group(1)) if metrics_match else None,
-                "residual": float(metrics_match.group(2)) if metrics_match else None,
-                "residual_rel": float(metrics_match.group(3)) if metrics_match else None,
-            }
-            
-            if wall_time_match:
-                res["time_s"] = float(wall_time_match.group(1))
-            if cpu_time_match:
-                res["cpu_time_s"] = float(cpu_time_match.group(1))
-            
-            return res
+            subprocess.run(cmd, capture_output=True, text=True, check=True)
+            with open(report_path) as f:
+                return json.load(f)
         except subprocess.CalledProcessError as e:
-            return {
-                "n": n,
-                "m": m,
-                "threads": threads,
-                "success": False,
-                "exit_code": e.returncode,
-                "stderr": e.stderr
-            }
-
-def run_suite(runner: BenchmarkRunner, configs: List[Dict]) -> List[Dict]:
+            return {"success": False, "exit_code": e.returncode, "stderr": e.stderr}
+        except (OSError, ValueError) as e:
+            return {"success": False, "stderr": str(e)}
+        finally:
+            if os.path.exists(report_path):
+                os.remove(report_path)
+
+    def run_repeated(self, n: int, m: int, threads: int, engine: str, repeat: int) -> Dict:
+        """Runs a configuration several times and aggregates the reports."""
+        res = {"n": n, "m": m, "threads": threads, "engine": engine, "success": True}
+        reports = []
+        for _ in range(repeat):
+            report = self.run_config(n, m, threads, engine)
+            if not report.get("success"):
+                res.update({"success": False, "exit_code": report.get("exit_code"),
+                            "stderr": report.get("stderr")})
+                return res
+            reports.append(report)
+
+        last = reports[-1]
+        res["m"] = last["config"]["m"]
+        res["error"] = max(r["error"] for r in reports)
+        res["residual"] = max(r["residual"] for r in reports)
+        res["residual_rel"] = max(r["residual_rel"] for r in reports)
+        res["time_samples"] = [r["phases"]["total_s"] for r in reports]
+        res["decomposition_samples"] = [r["phases"]["decomposition_s"] for r in reports]
+        res["time_s"] = summarize(res["time_samples"])["mean"]
+        res["cpu_time_s"] = sum(r["cpu_time_s"] for r in reports) / len(reports)
+        res["decomposition"] = summarize(res["decomposition_samples"])
+        res["gflops"] = (n ** 3 / 3.0) / res["decomposition"]["mean"] / 1e9
+        res["thread_cpu_s"] = last["thread_cpu_s"]
+        res["kernel_isa"] = last["config"]["kernel_isa"]
+        return res
+
+
+def run_suite(runner: BenchmarkRunner, configs: List[Dict], repeat: int) -> List[Dict]:
     results = []
-    # Store T1 times per (N, M) to calculate speedup correctly
-    t1_map = {}
 
-    print(f"{'N':>5} | {'M':>4} | {'Threads':>7} | {'Wall (s)':>10} | {'CPU (s)':>10} | {'Speedup':>8} | {'Error':>10}")
-    print("-" * 75)
+    print(f"{'N':>5} | {'M':>4} | {'Threads':>7} | {'Decomp (s)':>10} | {'95% CI':>9} | "
+          f"{'GFLOP/s':>8} | {'Residual':>9}")
+    print("-" * 74)
 
     for conf in configs:
-        res = runner.run_config(conf['n'], conf['m'], conf['threads'])
-        if res['success']:
-            n = res['n']
-            m = res['m']
-            wall = res['time_s']
-            cpu = res['cpu_time_s']
-            
-            key = (n, m)
-            if res['threads'] == 1:
-                t1_map[key] = wall
-            
-            speedup = t1_map.get(key, wall) / wall if key in t1_map and wall > 0 else 1.0
-            
-            print(f"{n:5d} | {m:4d} | {res['threads']:7d} | {wall:10.2f} | {cpu:10.2f} | {speedup:7.2f}x | {res['error']:.2e}")
+        res = runner.run_repeated(conf["n"], conf["m"], conf["threads"], conf["engine"], repeat)
+        if res["success"]:
+            d = res["decomposition"]
+            print(f"{res['n']:5d} | {res['m']:4d} | {res['threads']:7d} | {d['mean']:10.4f} | "
+                  f"{d['ci95']:9.4f} | {res['gflops']:8.2f} | {res['residual_rel']:.2e}")
         else:
-            print(f"FAILED: N={conf['n']} M={conf['m']} T={conf['threads']}. Exit code: {res.get('exit_code')}")
+            print(f"FAILED: N={conf['n']} M={conf['m']} T={conf['threads']}. "
+                  f"Exit code: {res.get('exit_code')}")
         results.append(res)
     return results
 
-def compare_results(baseline: List[Dict], current: List[Dict], tolerance: float = 1e-12):
+
+def print_scaling(results: List[Dict], weak: bool):
+    """Speedup and parallel efficiency against the single thread run of each series."""
+    print(f"\n--- {'Weak' if weak else 'Strong'} Scaling ---")
+    print(f"{'N':>5} | {'Threads':>7} | {'Speedup':>8} | {'95% CI':>7} | {'Efficiency':>10}")
+    base = next((r for r in results if r["success"] and r["threads"] == 1), None)
+    if not base:
+        print("No single thread run to scale against.")
+        return
+    for res in results:
+        if not res["success"]:
+            continue
+        # Weak scaling keeps the work per thread fixed, so ideal time is constant.
+        ratio, ci = ratio_ci(base["decomposition"], res["decomposition"])
+        speedup = ratio * res["threads"] if weak else ratio
+        ci = ci * res["threads"] if weak else ci
+        print(f"{res['n']:5d} | {res['threads']:7d} | {speedup:7.2f}x | {ci:7.2f} | "
+              f"{100.0 * speedup / res['threads']:9.1f}%")
+
+
+def samples_of(entry: Dict) -> Tuple[List[float], str]:
+    """Timing samples of a result; baselines from before the JSON output have one."""
+    if entry.get("decomposition_samples"):
+        return entry["decomposition_samples"], "decomposition"
+    return entry.get("time_samples") or [entry["time_s"]], "total"
+
+
+def compare_results(baseline: List[Dict], current: List[Dict]) -> bool:
+    """Welch comparison of the mean times; a change counts only if its 95% CI excludes 0."""
     print("\n--- Regression Report ---")
     all_pass = True
-    for b, c in zip(baseline, current):
-        if not c['success']:
-            print(f"FAIL: Configuration N={c['n']} M={c['m']} T={c['threads']} failed to run.")
+    by_key = {(b["n"], b["m"], b["threads"], b.get("engine", "dag")): b
+              for b in baseline if b.get("success")}
+
+    for c in current:
+        name = f"N={c['n']} M={c['m']} T={c['threads']}"
+        if not c["success"]:
+            print(f"FAIL: Configuration {name} failed to run.")
             all_pass = False
             continue
-        
-        err_diff = abs(b['error'] - c['error'])
-        if err_diff > tolerance:
-            print(f"REGRESSION: N={c['n']} M={c['m']} T={c['threads']} - Error diff: {err_diff:.2e} (Baseline: {b['error']:.2e}, Current: {c['error']:.2e})")
+        b = by_key.get((c["n"], c["m"], c["threads"], c.get("engine", "dag")))
+        if not b:
+            print(f"SKIP: {name} has no baseline.")
+            continue
+
+        if c["residual_rel"] > RESIDUAL_LIMIT or c["error"] > 10 * max(b["error"], 1e-300):
+            print(f"REGRESSION: {name} - Residual {c['residual_rel']:.2e}, Error {c['error']:.2e} "
+                  f"(Baseline: {b['error']:.2e})")
+            all_pass = False
+            continue
+
+        base_samples, metric = samples_of(b)
+        cur_samples, cur_metric = samples_of(c)
+        if metric != cur_metric:
+            cur_samples = c.get("time_samples") or [c["time_s"]]
+        bs, cs = summarize(base_samples), summarize(cur_samples)
+
+        # Welch-Satterthwaite degrees of freedom; a single baseline sample is
+        # taken as exact.
+        vb = bs["stdev"] ** 2 / bs["count"] if bs["count"] > 1 else 0.0
+        vc = cs["stdev"] ** 2 / cs["count"] if cs["count"] > 1 else 0.0
+        terms = [v ** 2 / (s["count"] - 1) for v, s in ((vb, bs), (vc, cs)) if s["count"] > 1]
+        df = (vb + vc) ** 2 / sum(terms) if terms and vb + vc > 0 else 0
+        diff = cs["mean"] - bs["mean"]
+        half = t_quantile(df) * math.sqrt(vb + vc) if df else float("inf")
+
+        change = 100.0 * diff / bs["mean"] if bs["mean"] > 0 else 0.0
+        ci = 100.0 * half / bs["mean"] if bs["mean"] > 0 else float("inf")
+        if diff - half > 0:
+            status = "REGRESSION (SLOWER)"
             all_pass = False
+        elif diff + half < 0:
+            status = "PASS (FASTER)"
         else:
-            time_ratio = c['time_s'] / b['time_s'] if b.get('time_s', 0) > 0 else 1.0
             status = "PASS"
-            if time_ratio > 1.2: status = "PASS (SLOWER)"
-            elif time_ratio < 0.8: status = "PASS (FASTER)"
-            
-            speedup = c['cpu_time_s'] / c['time_s'] if c['time_s'] > 0 else 1.0
-            print(f"{status}: N={c['n']} M={c['m']} T={c['threads']} (Error: {c['error']:.2e}, Wall: {c['time_s']:.2f}s, Speedup: {speedup:.2f}x)")
+        print(f"{status}: {name} {metric} {bs['mean']:.4f}s -> {cs['mean']:.4f}s "
+              f"({change:+.1f}% +- {ci:.1f}%, Residual: {c['residual_rel']:.2e})")
 
     if all_pass:
         print("\nAll tests passed successfully.")
     else:
         print("\nSome tests failed or showed regressions.")
+    return all_pass
+
+
+def int_list(text: str) -> List[int]:
+    return [int(x) for x in text.split(",") if x]
+
+
+def build_suite(args) -> List[Dict]:
+    sizes = int_list(args.sizes) if args.sizes else []
+    blocks = int_list(args.blocks) if args.blocks else [64]
+    threads = int_list(args.threads) if args.threads else []
+    cpus = os.cpu_count() or 1
+    default_threads = [t for t in (1, 2, 4, 8, 16, 32, 64, 128) if t <= cpus] or [1]
+    suite = []
+
+    if args.suite == "regression":
+        # The configurations of baseline.json.
+        for n in sizes or [1000, 2000, 5000]:
+            for t in threads or [1, 4]:
+                suite.append({"n": n, "m": blocks[0], "threads": t})
+    elif args.suite == "strong":
+        for t in threads or default_threads:
+            suite.append({"n": (sizes or [3000])[0], "m": blocks[0], "threads": t})
+    elif args.suite == "weak":
+        # N^3 / threads stays constant.
+        n0 = (sizes or [2000])[0]
+        for t in threads or default_threads:
+            suite.append({"n": int(round(n0 * t ** (1.0 / 3.0))), "m": blocks[0], "threads": t})
+    else:
+        for n in sizes or [1000, 2000, 4000]:
+            for m in blocks if args.blocks else [32, 64, 128]:
+                for t in threads or default_threads:
+                    if m <= n:
+                        suite.append({"n": n, "m": m, "threads": t})
+
+    for conf in suite:
+        conf["engine"] = args.engine
+    return suite
+
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
+    parser.add_argument("--suite", choices=["regression", "strong", "weak", "sweep"],
+                        default="regression", help="Configurations to run")
+    parser.add_argument("--sizes", help="Comma-separated matrix sizes (base size for weak)")
+    parser.add_argument("--blocks", help="Comma-separated block sizes")
+    parser.add_argument("--threads", help="Comma-separated thread counts")
+    parser.add_argument("--engine", default="dag", choices=["dag", "barrier", "recursive"])
+    parser.add_argument("--repeat", type=int, default=5, help="Runs per configuration")
     parser.add_argument("--save", help="Save results to file")
     parser.add_argument("--compare", help="Compare against baseline file")
     args = parser.parse_args()
 
     runner = BenchmarkRunner()
-    
-    suite = []
-    for threads in [1, 2, 3, 4, 5]:
-        suite.append({"n": 5000, "m": 64, "threads": threads})
-    
-    results = run_suite(runner, suite)
-    
+    results = run_suite(runner, build_suite(args), max(args.repeat, 1))
+
+    if args.suite in ("strong", "weak"):
+        print_scaling(results, args.suite == "weak")
+
     if args.save:
         with open(args.save, "w") as f:
             json.dump(results, f, indent=2)
         print(f"\nResults saved to {args.save}")
-        
+
     if args.compare:
         if os.path.exists(args.compare):
             with open(args.compare, "r") as f:
                 baseline = json.load(f)
-            compare_results(baseline, results)
+            if not compare_results(baseline, results):
+                raise SystemExit(1)
         else:
             print(f"Baseline file {args.compare} not found.")
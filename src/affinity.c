@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest cpulist read from sysfs.
+#define AFFINITY_LINE_LENGTH 4096
+
+// Parses a Linux CPU list ("0-3,8,10-11") into a CPU set.
+// Returns: 0 on success, -1 if the list is malformed.
+static int affinity_parse_list(const char* list, cpu_set_t* set) {
+  char* end;
+  long first, last;
+
+  CPU_ZERO(set);
+  while (*list && *list != '\n') {
+    first = strtol(list, &end, 10);
+    if (end == list || first < 0) {
+      return -1;
+    }
+    last = first;
+    if (*end == '-') {
+      list = end + 1;
+      last = strtol(list, &end, 10);
+      if (end == list || last < first) {
+        return -1;
+      }
+    }
+    if (last >= CPU_SETSIZE) {
+      return -1;
+    }
+    for (; first <= last; ++first) {
+      CPU_SET(first, set);
+    }
+    list = *end == ',' ? end + 1 : end;
+    if (*end && *end != ',' && *end != '\n') {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Reads the allowed CPUs of every NUMA node, in node order.
+// Returns: the number of nodes, at least 1.
+static int affinity_nodes(cpu_set_t* nodes, int max_nodes) {
+  char path[64];
+  char line[AFFINITY_LINE_LENGTH];
+  cpu_set_t allowed;
+  FILE* file;
+  int node, count = 0;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+    CPU_ZERO(&allowed);
+    CPU_SET(0, &allowed);
+  }
+
+  for (node = 0; count < max_nodes; ++node) {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if (!(file = fopen(path, "r"))) {
+      break;
+    }
+    if (fgets(line, sizeof(line), file) && !affinity_parse_list(line, nodes + count)) {
+      CPU_AND(nodes + count, nodes + count, &allowed);
+      count += CPU_COUNT(nodes + count) > 0;
+    }
+    fclose(file);
+  }
+
+  if (!count) {
+    nodes[0] = allowed;
+    count = 1;
+  }
+  return count;
+}
+
+int affinity_map(const char* map, int total_threads, int* cpus) {
+  cpu_set_t nodes[64];
+  int next[64];
+  int node_count, node, cpu, i, count = 0;
+  int scatter = !strcmp(map, "scatter");
+
+  if (scatter || !strcmp(map, "compact")) {
+    node_count = affinity_nodes(nodes, sizeof(nodes) / sizeof(nodes[0]));
+    memset(next, 0, sizeof(next));
+
+    // Take the next CPU of node 0, 1, ... in turn for scatter, or run
+    // through each node before moving on for compact.
+    for (i = 0, node = 0; count < total_threads; node = (node + 1) % node_count) {
+      for (cpu = next[node]; cpu < CPU_SETSIZE && !CPU_ISSET(cpu, nodes + node); ++cpu) {
+      }
+      if (cpu == CPU_SETSIZE) {
+        // The node is exhausted; start over once all of them are.
+        if (++i == node_count) {
+          memset(next, 0, sizeof(next));
+          node = node_count - 1;
+          i = 0;
+        }
+        continue;
+      }
+      i = 0;
+      cpus[count++] = cpu;
+      next[node] = cpu + 1;
+      if (!scatter) {
+        node = (node + node_count - 1) % node_count;
+      }
+    }
+    return 0;
+  }
+
+  if (affinity_parse_list(map, nodes) || !CPU_COUNT(nodes)) {
+    return -1;
+  }
+  for (cpu = 0; count < total_threads; cpu = (cpu + 1) % CPU_SETSIZE) {
+    if (CPU_ISSET(cpu, nodes)) {
+      cpus[count++] = cpu;
+    }
+  }
+  return 0;
+}
+
+int affinity_pin(int cpu) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ? -1 : 0;
+}
+
+struct _AffinityMask {
+  cpu_set_t set;  // Saved CPUs.
+};
+
+AffinityMask* affinity_save(void) {
+  AffinityMask* mask = (AffinityMask*)malloc(sizeof(AffinityMask));
+
+  if (mask && pthread_getaffinity_np(pthread_self(), sizeof(mask->set), &mask->set)) {
+    free(mask);
+    return NULL;
+  }
+  return mask;
+}
+
+void affinity_restore(AffinityMask* mask) {
+  if (mask) {
+    pthread_setaffinity_np(pthread_self(), sizeof(mask->set), &mask->set);
+    free(mask);
+  }
+}
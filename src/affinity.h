@@ -0,0 +1,32 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+// Thread placement.
+//
+// An affinity map assigns a CPU to every thread of a team. It is either an
+// explicit CPU list such as "0-7,16-23", where thread i gets the i-th CPU of
+// the list (cycling if the list is shorter), or one of
+//   compact  fill the CPUs of NUMA node 0 first, then node 1, ...
+//   scatter  deal the threads out across the NUMA nodes in turn
+// Only CPUs the process is allowed to run on are used by the named maps. NUMA
+// nodes are read from /sys/devices/system/node; without them all CPUs form a
+// single node.
+
+// Fills cpus[0 .. total_threads - 1] from the map.
+// Returns: 0 on success, -1 if the map is malformed or names no CPU.
+int affinity_map(const char* map, int total_threads, int* cpus);
+
+// Restricts the calling thread to one CPU.
+// Returns: 0 on success, -1 if the CPU is not available.
+int affinity_pin(int cpu);
+
+// CPU mask of a thread, saved to undo affinity_pin.
+typedef struct _AffinityMask AffinityMask;
+
+// Returns: the CPU mask of the calling thread, or NULL if it cannot be read.
+AffinityMask* affinity_save(void);
+
+// Restores a mask saved by the calling thread and frees it.
+void affinity_restore(AffinityMask* mask);
+
+#endif  // AFFINITY_H
@@ -5,10 +5,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "array_op.h"
+#include "cholesky_batch.h"
+
 // Fills the matrix with test values using a symmetric packed storage scheme.
 // The RHS is calculated as A * vector_answer to allow result verification.
 int fill_matrix(int n, double* matrix, double* vector_answer, double* rhs) {
-  int i, j, k, t;
+  int i, j;
+  size_t k;
+  // The column walk below visits every earlier row once per row.
+  size_t* offsets = packed_row_offsets(n);
+
+  if (!offsets) {
+    return -1;
+  }
 
   for (i = 0; i < n; ++i) {
     rhs[i] = 0;
@@ -16,11 +26,10 @@ int fill_matrix(int n, double* matrix, double* vector_answer, double* rhs) {
 
   for (i = 0; i < n; ++i) {
     // Index into packed upper triangular storage.
-    k = n * i - (i * (i - 1)) / 2;
+    k = offsets[i];
 
     for (j = 0; j < i; j++) {
-      t = n * j - (j * (j - 1)) / 2;
-      rhs[i] += matrix[t + i - j] * vector_answer[j];
+      rhs[i] += matrix[offsets[j] + i - j] * vector_answer[j];
     }
 
     for (j = i; j < n; j++) {
@@ -29,9 +38,102 @@ int fill_matrix(int n, double* matrix, double* vector_answer, double* rhs) {
     }
   }
 
+  free(offsets);
+  return 0;
+}
+
+// Same values as fill_matrix, generated for one tile at a time.
+void fill_matrix_tile(int n, int row, int column, int rows, int columns, double* tile) {
+  int i, j;
+
+  for (i = 0; i < rows; ++i) {
+    for (j = 0; j < columns; ++j) {
+      tile[i * columns + j] = column + j >= row + i ? abs(n - column - j) : 0;
+    }
+  }
+}
+
+// Fills a skyline with a diagonally dominant banded test matrix, whose
+// columns reach between w / 2 and w rows above the diagonal, so that the
+// envelope is ragged.
+int fill_skyline(int n, int w, Skyline* skyline, double* vector_answer, double* rhs) {
+  int i, j, top;
+  int* first = (int*)calloc(n, sizeof(int));
+  double* column;
+
+  if (!first) {
+    return -1;
+  }
+  for (j = 0; j < n; ++j) {
+    top = j - w + j % (w / 2 + 1);
+    first[j] = (top > 0 ? top : 0);
+  }
+  if (skyline_init(skyline, n, first)) {
+    free(first);
+    return -1;
+  }
+  free(first);
+
+  // Every row has at most 2 * w off-diagonal elements of at most 1 / 2.
+  for (j = 0; j < n; ++j) {
+    column = skyline->values + skyline->offsets[j] - skyline->first[j];
+    for (i = skyline->first[j]; i < j; ++i) {
+      column[i] = 1.0 / (j - i + 1);
+    }
+    column[j] = w + 1;
+  }
+
+  skyline_vector_multiply(skyline, vector_answer, rhs);
   return 0;
 }
 
+// Row i of the matrices gets abs(n - j) from the diagonal on, as in
+// fill_matrix, and the diagonal of matrix b another b % 8.
+void fill_batch(int n, int count, double* matrices, double* vector_answer, double* rhs) {
+  int b, i, j;
+  double aij;
+
+  for (b = 0; b < count; ++b) {
+    for (i = 0; i < n; ++i) {
+      rhs[cholesky_batch_vector_index(n, b, i)] = 0;
+    }
+    for (i = 0; i < n; ++i) {
+      for (j = i; j < n; ++j) {
+        aij = abs(n - j) + (i == j ? b % 8 : 0);
+        matrices[cholesky_batch_matrix_index(n, b, i, j)] = aij;
+        rhs[cholesky_batch_vector_index(n, b, i)] += aij * vector_answer[j];
+        if (i != j) {
+          rhs[cholesky_batch_vector_index(n, b, j)] += aij * vector_answer[i];
+        }
+      }
+    }
+  }
+}
+
+// The vectors are smooth in i, with a different frequency for every column.
+void fill_update(int n, int rank, int sign, double* vectors, double* matrix,
+                 double* vector_answer, double* rhs) {
+  int i, j, k;
+  size_t p = 0;
+  double sum;
+
+  for (i = 0; i < n; ++i) {
+    for (k = 0; k < rank; ++k) {
+      vectors[(size_t)i * rank + k] = cos((double)i * (k + 1) / n);
+    }
+  }
+  for (i = 0; i < n; ++i) {
+    for (j = i; j < n; ++j, ++p) {
+      sum = 0;
+      for (k = 0; k < rank; ++k) {
+        sum += vectors[(size_t)i * rank + k] * vectors[(size_t)j * rank + k];
+      }
+      matrix[p] += sign * sum;
+    }
+  }
+  packed_matrix_vector_multiply(n, matrix, vector_answer, rhs);
+}
+
 // Legacy routine for filling a standard 2D matrix.
 int stupid_fill_matrix(int n, double* matrix) {
   int i, j;
@@ -46,7 +148,8 @@ int stupid_fill_matrix(int n, double* matrix) {
 // Reads a symmetric matrix from a file and prepares the system for solving.
 int read_matrix(int matrix_size, double** p_a, double* vector_answer, double* rhs,
                 char* input_file_name) {
-  int i, j, k;
+  int i, j;
+  size_t k;
   FILE* input_file;
   double* matrix = *p_a;
   double tmp;
@@ -71,7 +174,7 @@ int read_matrix(int matrix_size, double** p_a, double* vector_answer, double* rh
       rhs[i] += tmp * vector_answer[j];
     }
 
-    k = i * matrix_size - (i * (i - 1)) / 2;
+    k = packed_row_offset(matrix_size, i);
     for (j = i; j < matrix_size; j++) {
       if (fscanf(input_file, "%lf", matrix + k + j - i) != 1) {
         printf("Cannot read matrix from file\n");
@@ -112,15 +215,76 @@ int stupid_read_matrix(int matrix_size, double** p_a, char* input_file_name) {
   return 0;
 }
 
+// The first pass finds the envelope, the second stores the upper triangle
+// inside it. The right-hand side comes from the stored upper triangle.
+int read_skyline(int matrix_size, Skyline* skyline, double* vector_answer, double* rhs,
+                 const char* input_file_name) {
+  int i, j;
+  int* first;
+  double tmp;
+  FILE* input_file = fopen(input_file_name, "r");
+
+  if (input_file == NULL) {
+    printf("Error: cannot open input file\n");
+    return -1;
+  }
+  if (!(first = (int*)malloc(matrix_size * sizeof(int)))) {
+    fclose(input_file);
+    return -3;
+  }
+  for (j = 0; j < matrix_size; ++j) {
+    first[j] = j;
+  }
+
+  for (i = 0; i < matrix_size; ++i) {
+    for (j = 0; j < matrix_size; ++j) {
+      if (fscanf(input_file, "%lf", &tmp) != 1) {
+        printf("Cannot read matrix from file\n");
+        free(first);
+        fclose(input_file);
+        return -2;
+      }
+      if (j > i && tmp != 0 && i < first[j]) {
+        first[j] = i;
+      }
+    }
+  }
+
+  if (skyline_init(skyline, matrix_size, first)) {
+    free(first);
+    fclose(input_file);
+    return -3;
+  }
+  free(first);
+
+  rewind(input_file);
+  for (i = 0; i < matrix_size; ++i) {
+    for (j = 0; j < matrix_size; ++j) {
+      if (fscanf(input_file, "%lf", &tmp) != 1) {
+        printf("Cannot read matrix from file\n");
+        fclose(input_file);
+        return -2;
+      }
+      if (j >= i && i >= skyline->first[j]) {
+        skyline->values[skyline->offsets[j] + i - skyline->first[j]] = tmp;
+      }
+    }
+  }
+
+  fclose(input_file);
+  skyline_vector_multiply(skyline, vector_answer, rhs);
+  return 0;
+}
+
 // Prints the symmetric matrix using hex-float format for precision debugging.
 void printf_matrix(int n, double* matrix) {
   int i, j;
   for (i = 0; i < n; i++) {
     for (j = 0; j < n; j++) {
       if (j >= i) {
-        printf("%A ", matrix[n * i - (i * (i - 1)) / 2 + j - i]);
+        printf("%A ", matrix[packed_row_offset(n, i) + j - i]);
       } else {
-        printf("%A ", matrix[n * j - (j * (j - 1)) / 2 + i - j]);
+        printf("%A ", matrix[packed_row_offset(n, j) + i - j]);
       }
     }
     printf("\n");
@@ -1,10 +1,32 @@
 #ifndef ARRAY_IO_H
 #define ARRAY_IO_H
 
+#include "skyline.h"
+
 // Fills the matrix with test values and generates the corresponding RHS.
 // The matrix is stored in a packed upper triangular format.
 int fill_matrix(int n, double* matrix, double* vector_answer, double* rhs);
 
+// Fills the rows x columns tile at element (row, column), row <= column, of
+// the fill_matrix test matrix, row-major with a stride of columns. Elements
+// below the diagonal of a diagonal tile are zero.
+void fill_matrix_tile(int n, int row, int column, int rows, int columns, double* tile);
+
+// Fills the skyline with a banded test matrix whose columns reach at most w
+// rows above the diagonal, and generates the corresponding RHS.
+// Returns: 0 on success, -1 if there is not enough memory.
+int fill_skyline(int n, int w, Skyline* skyline, double* vector_answer, double* rhs);
+
+// Fills count interleaved test matrices of size n (see cholesky_batch.h),
+// the fill_matrix matrix plus b % 8 on the diagonal of matrix b, and their
+// interleaved right-hand sides for the answer vector_answer.
+void fill_batch(int n, int count, double* matrices, double* vector_answer, double* rhs);
+
+// Fills an N x K row-major block of test vectors V, adds sign * V * V^T to
+// the packed matrix and regenerates the RHS for vector_answer.
+void fill_update(int n, int rank, int sign, double* vectors, double* matrix,
+                 double* vector_answer, double* rhs);
+
 // Legacy/simple matrix filling routine.
 int stupid_fill_matrix(int n, double* matrix);
 
@@ -12,6 +34,13 @@ int stupid_fill_matrix(int n, double* matrix);
 int read_matrix(int matrix_size, double** p_a, double* vector_answer, double* rhs,
                 char* input_file_name);
 
+// Reads a full matrix like read_matrix into a skyline, whose envelope is the
+// first nonzero of every column above the diagonal, and generates the RHS.
+// Returns: 0 on success, -1 if the file cannot be opened, -2 if it has too
+//          few or malformed numbers, -3 if there is not enough memory.
+int read_skyline(int matrix_size, Skyline* skyline, double* vector_answer, double* rhs,
+                 const char* input_file_name);
+
 // Legacy/simple matrix reading routine.
 int stupid_read_matrix(int matrix_size, double** p_a, char* input_file_name);
 
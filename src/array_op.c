@@ -1,20 +1,50 @@
 #include "array_op.h"
 
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "array_op_simd.h"
+
 const double EPS = 1e-16;
 
+// Variant of main_blocks_diagonal_multiply() picked for this CPU on first
+// use, or last forced with kernel_select_isa().
+static void (*diagonal_multiply_kernel)(int, int, int, double*, double*, double*,
+                                        double*) = main_blocks_diagonal_multiply_scalar;
+static KernelIsa diagonal_multiply_isa = KERNEL_ISA_SCALAR;
+static pthread_once_t kernel_dispatch_once = PTHREAD_ONCE_INIT;
+
+size_t packed_row_offset(int n, int i) {
+  return ((size_t)i * (((size_t)n << 1) - i + 1)) >> 1;
+}
+
+size_t* packed_row_offsets(int n) {
+  size_t* offsets = (size_t*)malloc((n + 1) * sizeof(size_t));
+  int i;
+
+  if (!offsets) {
+    return NULL;
+  }
+  // Row i + 1 starts n - i elements after row i.
+  offsets[0] = 0;
+  for (i = 0; i < n; ++i) {
+    offsets[i + 1] = offsets[i] + n - i;
+  }
+  return offsets;
+}
+
 // Copies an off-diagonal block from packed symmetric storage to a square block.
 inline void cpy_matrix_block_to_block(double* a, int row, int column, int matrix_size, int n, int m,
                                       double* b) {
-  int i, j, k;
+  int i, j;
+  size_t k;
   memset(b, 0, n * m * sizeof(double));
 
   // Map 2D block coordinates to packed 1D index.
-  k = ((row * ((matrix_size << 1) - row + 1)) >> 1) + column - row;
+  k = packed_row_offset(matrix_size, row) + column - row;
 
   for (i = row; i < row + n; i++) {
     // Manually unrolled loop for performance.
@@ -38,8 +68,8 @@ inline void cpy_matrix_block_to_block(double* a, int row, int column, int matrix
 // Copies a square block back to an off-diagonal position in packed storage.
 inline void cpy_block_to_matrix_block(double* a, int row, int column, int matrix_size, int n, int m,
                                       double* b) {
-  int i, j, k;
-  k = ((row * ((matrix_size << 1) - row + 1)) >> 1) + column - row;
+  int i, j;
+  size_t k = packed_row_offset(matrix_size, row) + column - row;
 
   for (i = row; i < row + n; i++) {
     for (j = 0; j < m - 7; j += 8) {
@@ -59,9 +89,9 @@ inline void cpy_block_to_matrix_block(double* a, int row, int column, int matrix
   }
 }
 
-// High-performance block multiplication: C = C - A^T * D * B.
-// This is the core computational kernel of the block Cholesky method.
-inline void main_blocks_diagonal_multiply(int n, int m, int l, double* a, double* b, double* d,
+// Portable block multiplication: C = C - A^T * D * B.
+// Used when the CPU has no supported vector extension.
+void main_blocks_diagonal_multiply_scalar(int n, int m, int l, double* a, double* b, double* d,
                                           double* c) {
   int i, j, k;
   double *pa, *pb, *pc, pd, ta;
@@ -93,6 +123,83 @@ inline void main_blocks_diagonal_multiply(int n, int m, int l, double* a, double
   }
 }
 
+static int kernel_isa_supported(KernelIsa isa) {
+  if (isa == KERNEL_ISA_SCALAR) {
+    return 1;
+  }
+#ifdef CHOLESKY_X86_KERNELS
+  __builtin_cpu_init();
+  if (isa == KERNEL_ISA_AVX2) {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  }
+  if (isa == KERNEL_ISA_AVX512) {
+    return __builtin_cpu_supports("avx512f");
+  }
+#endif
+  return 0;
+}
+
+static void kernel_set_isa(KernelIsa isa) {
+  diagonal_multiply_isa = isa;
+  diagonal_multiply_kernel = main_blocks_diagonal_multiply_scalar;
+#ifdef CHOLESKY_X86_KERNELS
+  if (isa == KERNEL_ISA_AVX2) {
+    diagonal_multiply_kernel = main_blocks_diagonal_multiply_avx2;
+  } else if (isa == KERNEL_ISA_AVX512) {
+    diagonal_multiply_kernel = main_blocks_diagonal_multiply_avx512;
+  }
+#endif
+}
+
+// Picks the widest supported variant unless CHOLESKY_KERNEL asks otherwise.
+static void kernel_dispatch_init(void) {
+  const char* name = getenv("CHOLESKY_KERNEL");
+  int isa;
+
+  for (isa = KERNEL_ISA_AVX512; isa > KERNEL_ISA_SCALAR; --isa) {
+    if (name && strcmp(name, kernel_isa_name((KernelIsa)isa))) {
+      continue;
+    }
+    if (kernel_isa_supported((KernelIsa)isa)) {
+      break;
+    }
+  }
+  kernel_set_isa((KernelIsa)isa);
+}
+
+KernelIsa kernel_isa(void) {
+  pthread_once(&kernel_dispatch_once, kernel_dispatch_init);
+  return diagonal_multiply_isa;
+}
+
+const char* kernel_isa_name(KernelIsa isa) {
+  switch (isa) {
+    case KERNEL_ISA_AVX2:
+      return "avx2";
+    case KERNEL_ISA_AVX512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+int kernel_select_isa(KernelIsa isa) {
+  pthread_once(&kernel_dispatch_once, kernel_dispatch_init);
+  if (!kernel_isa_supported(isa)) {
+    return -1;
+  }
+  kernel_set_isa(isa);
+  return 0;
+}
+
+// High-performance block multiplication: C = C - A^T * D * B.
+// This is the core computational kernel of the block Cholesky method.
+void main_blocks_diagonal_multiply(int n, int m, int l, double* a, double* b, double* d,
+                                   double* c) {
+  pthread_once(&kernel_dispatch_once, kernel_dispatch_init);
+  diagonal_multiply_kernel(n, m, l, a, b, d, c);
+}
+
 // Block multiplication: C = A * B.
 inline void main_blocks_multiply(int n, int m, int l, double* a, double* b, double* c) {
   int i, j, k;
@@ -125,11 +232,40 @@ inline void main_blocks_multiply(int n, int m, int l, double* a, double* b, doub
   }
 }
 
+// Block multiplication: C = C - A * B.
+void main_blocks_multiply_subtract(int n, int m, int l, double* a, double* b, double* c) {
+  int i, j, k;
+  double *pb, *pc, ta;
+
+  pc = c;
+  for (i = 0; i < n; ++i) {
+    pb = b;
+    for (k = 0; k < m; ++k) {
+      ta = a[i * m + k];
+      for (j = 0; j < l - 7; j += 8) {
+        pc[j] -= pb[j] * ta;
+        pc[j + 1] -= pb[j + 1] * ta;
+        pc[j + 2] -= pb[j + 2] * ta;
+        pc[j + 3] -= pb[j + 3] * ta;
+        pc[j + 4] -= pb[j + 4] * ta;
+        pc[j + 5] -= pb[j + 5] * ta;
+        pc[j + 6] -= pb[j + 6] * ta;
+        pc[j + 7] -= pb[j + 7] * ta;
+      }
+      for (; j < l; ++j) {
+        pc[j] -= pb[j] * ta;
+      }
+      pb += l;
+    }
+    pc += l;
+  }
+}
+
 // Copies a diagonal block from packed storage to a square block.
 void cpy_diagonal_block_to_block(double* a, int t, int matrix_size, int m, double* b) {
-  int i, j, k;
+  int i, j;
+  size_t k = packed_row_offset(matrix_size, t);
   memset(b, 0, m * m * sizeof(double));
-  k = ((t * ((matrix_size << 1) - t + 1)) >> 1);
 
   for (i = t; i < t + m; i++) {
     for (j = 0; j < m - (i - t); j++) {
@@ -141,8 +277,8 @@ void cpy_diagonal_block_to_block(double* a, int t, int matrix_size, int m, doubl
 
 // Copies a square block back to a diagonal position in packed storage.
 void cpy_block_to_diagonal_block(double* a, int t, int matrix_size, int m, double* b) {
-  int i, j, k;
-  k = ((t * ((matrix_size << 1) - t + 1)) >> 1);
+  int i, j;
+  size_t k = packed_row_offset(matrix_size, t);
 
   for (i = t; i < t + m; i++) {
     for (j = 0; j < m - (i - t); j++) {
@@ -216,7 +352,8 @@ int cholesky_for_block(int n, double* a, double* d) {
       return -1;
     }
 
-    dt = 1.0 / pai[i];
+    // R_ii * D_i * R_ij = A_ij - ..., so the row is divided by R_ii * D_i.
+    dt = 1.0 / (pai[i] * d[i]);
     for (j = i + 1; j < n - 8; j += 8) {
       pai[j] *= dt;
       pai[j + 1] *= dt;
@@ -235,109 +372,182 @@ int cholesky_for_block(int n, double* a, double* d) {
   return 0;
 }
 
-// Inverts upper triangular scaled system for RHS vector.
-int inverse_upper_triangle_block_and_diagonal_rhs(int n, double* a, double* d, double* rhs) {
-  int i, j;
-  for (i = 0; i < n; ++i) {
-    rhs[i] *= d[i];
+// Rows [row, row + rows) of a block take the updates of all rows above them.
+void cholesky_block_panel_update(int n, int row, int rows, int c0, int c1, double* a, double* d) {
+  int i, j, k, j0;
+  double *pai, *pak, dt;
+
+  pai = a + row * n;
+  for (i = row; i < row + rows; ++i) {
+    j0 = (c0 > i ? c0 : i);
+    pak = a;
+    for (k = 0; k < row; ++k) {
+      dt = pak[i] * d[k];
+      for (j = j0; j < c1; ++j) {
+        pai[j] -= dt * pak[j];
+      }
+      pak += n;
+    }
+    pai += n;
   }
-  for (i = n - 1; i >= 0; --i) {
-    if (fabs(a[i * n + i]) < EPS) {
-      return -1;
+}
+
+// Non-blocked Cholesky restricted to a panel of rows and a range of columns.
+int cholesky_block_panel(int n, int row, int rows, int c0, int c1, double* a, double* d) {
+  int i, j, k, j0;
+  double *pai, *pak, dt;
+
+  pai = a + row * n;
+  for (i = row; i < row + rows; ++i) {
+    j0 = (c0 > i ? c0 : i);
+    pak = a + row * n;
+    for (k = row; k < i; ++k) {
+      dt = pak[i] * d[k];
+      for (j = j0; j < c1; ++j) {
+        pai[j] -= dt * pak[j];
+      }
+      pak += n;
     }
-    rhs[i] *= 1.0 / a[i * n + i];
-    for (j = 0; j < i; ++j) {
-      rhs[j] -= rhs[i] * a[j * n + i];
+
+    // The pivot is only computed by the call that covers the diagonal.
+    if (i >= c0 && i < c1) {
+      d[i] = 1.0;
+      if (pai[i] < 0.0) {
+        d[i] = -1.0;
+        pai[i] = -pai[i];
+      }
+      pai[i] = sqrt(pai[i]);
+      if (fabs(pai[i]) < EPS) {
+        return -1;
+      }
+      ++j0;
+    }
+
+    dt = 1.0 / (pai[i] * d[i]);
+    for (j = j0; j < c1; ++j) {
+      pai[j] *= dt;
     }
+    pai += n;
   }
   return 0;
 }
 
-// Inverts lower triangular system for RHS vector.
-int inverse_lower_triangle_block_rhs(int n, double* a, double* rhs) {
-  int i, j;
+// Solves R^T * D * X = B in place for a block of right-hand sides (TRSM).
+// Row i of X is final once the rows above it have been subtracted. It is
+// stored with its sign D_i already applied, and since D_i^2 = 1 the rows
+// below subtract it scaled by R_ik * D_i, so no second pass is needed.
+int lower_triangle_block_diagonal_solve(int n, int l, double* a, double* d, double* x) {
+  int i, j, k;
+  double *pxi, *pxk, dt;
+
+  pxi = x;
   for (i = 0; i < n; ++i) {
     if (fabs(a[i * n + i]) < EPS) {
       return -1;
     }
-    rhs[i] *= 1.0 / a[i * n + i];
-    for (j = i + 1; j < n; ++j) {
-      rhs[j] -= rhs[i] * a[i * n + j];
+    dt = d[i] / a[i * n + i];
+    for (j = 0; j < l; ++j) {
+      pxi[j] *= dt;
+    }
+
+    pxk = pxi + l;
+    for (k = i + 1; k < n; ++k) {
+      dt = a[i * n + k] * d[i];
+      for (j = 0; j < l - 7; j += 8) {
+        pxk[j] -= pxi[j] * dt;
+        pxk[j + 1] -= pxi[j + 1] * dt;
+        pxk[j + 2] -= pxi[j + 2] * dt;
+        pxk[j + 3] -= pxi[j + 3] * dt;
+        pxk[j + 4] -= pxi[j + 4] * dt;
+        pxk[j + 5] -= pxi[j + 5] * dt;
+        pxk[j + 6] -= pxi[j + 6] * dt;
+        pxk[j + 7] -= pxi[j + 7] * dt;
+      }
+      for (; j < l; ++j) {
+        pxk[j] -= pxi[j] * dt;
+      }
+      pxk += l;
     }
+    pxi += l;
   }
   return 0;
 }
 
-// Standard matrix-vector multiplication for a block.
-void matrix_block_vector_multiply(int n, int m, double* a, double* b, double* c) {
-  int i, j;
-  double* pai = a;
-  for (i = 0; i < n; i++) {
-    for (j = 0; j < m; j++) {
-      c[i] -= pai[j] * b[j];
+// Solves R * X = B in place for a block of right-hand sides.
+int upper_triangle_block_solve(int n, int l, double* a, double* x) {
+  int i, j, k;
+  double *pxi, *pxk, dt;
+
+  pxi = x + (n - 1) * l;
+  for (i = n - 1; i >= 0; --i) {
+    if (fabs(a[i * n + i]) < EPS) {
+      return -1;
+    }
+    dt = 1.0 / a[i * n + i];
+    for (j = 0; j < l; ++j) {
+      pxi[j] *= dt;
     }
-    pai += m;
-  }
-}
 
-// Standard transposed matrix-vector multiplication for a block.
-void matrix_block_transposed_vector_multiply(int n, int m, double* a, double* b, double* c) {
-  int i, j;
-  for (i = 0; i < m; i++) {
-    for (j = 0; j < n; j++) {
-      c[i] -= a[j * m + i] * b[j];
+    pxk = x;
+    for (k = 0; k < i; ++k) {
+      dt = a[k * n + i];
+      for (j = 0; j < l; ++j) {
+        pxk[j] -= pxi[j] * dt;
+      }
+      pxk += l;
     }
+    pxi -= l;
   }
+  return 0;
 }
 
-// Solves the forward substitution step for the whole system.
-int solve_lower_triangle_matrix_system(int matrix_size, double* matrix, double* rhs,
-                                       double* workspace, int block_size) {
-  int i, j, pii_n, pij_n, pij_m;
-  double* ma = workspace;
-
-  for (i = 0; i < matrix_size; i += block_size) {
-    pii_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-    cpy_diagonal_block_to_block(matrix, i, matrix_size, pii_n, ma);
-    if (inverse_lower_triangle_block_rhs(pii_n, ma, rhs + i)) {
-      return -1;
-    }
+// Symmetric packed matrix-vector product. Every stored row is used twice, as
+// a row and as the mirrored column, so the matrix is read contiguously.
+void packed_matrix_vector_multiply(int n, double* matrix, double* x, double* y) {
+  int i, j;
+  double *pa, sum, xi;
 
-    for (j = i + block_size; j < matrix_size; j += block_size) {
-      pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-      pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
-      cpy_matrix_block_to_block(matrix, i, j, matrix_size, pij_n, pij_m, ma);
-      matrix_block_transposed_vector_multiply(pij_n, pij_m, ma, rhs + i, rhs + j);
+  memset(y, 0, n * sizeof(double));
+  pa = matrix;
+  for (i = 0; i < n; ++i) {
+    xi = x[i];
+    sum = pa[0] * xi;
+    for (j = 1; j < n - i; ++j) {
+      sum += pa[j] * x[i + j];
+      y[i + j] += pa[j] * xi;
     }
+    y[i] += sum;
+    pa += n - i;
   }
-  return 0;
 }
 
-// Solves the backward substitution step for the whole system.
-int solve_upper_triangle_matrix_diagonal_system(int matrix_size, double* matrix, double* diagonal,
-                                                double* rhs, double* workspace, int block_size) {
-  int i, j, pii_n, pij_n, pij_m;
-  int residue;
-  double* ma = workspace;
+// Block version of packed_matrix_vector_multiply() for several vectors.
+void packed_matrix_block_multiply(int n, int l, double* matrix, double* x, double* y) {
+  int i, j, c;
+  double *pa, *xi, *xj, *yi, *yj, aij;
 
-  residue = matrix_size - (matrix_size % block_size);
-  if (residue == matrix_size) {
-    residue -= block_size;
+  if (l == 1) {
+    packed_matrix_vector_multiply(n, matrix, x, y);
+    return;
   }
 
-  for (i = residue; i >= 0; i -= block_size) {
-    for (j = residue; j > i; j -= block_size) {
-      pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-      pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
-      cpy_matrix_block_to_block(matrix, i, j, matrix_size, pij_n, pij_m, ma);
-      matrix_block_vector_multiply(pij_n, pij_m, ma, rhs + j, rhs + i);
+  memset(y, 0, n * l * sizeof(double));
+  pa = matrix;
+  for (i = 0; i < n; ++i) {
+    xi = x + i * l;
+    yi = y + i * l;
+    for (c = 0; c < l; ++c) {
+      yi[c] += pa[0] * xi[c];
     }
-
-    pii_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-    cpy_diagonal_block_to_block(matrix, i, matrix_size, pii_n, ma);
-    if (inverse_upper_triangle_block_and_diagonal_rhs(pii_n, ma, diagonal + i, rhs + i)) {
-      return -1;
+    for (j = 1; j < n - i; ++j) {
+      aij = pa[j];
+      xj = xi + j * l;
+      yj = yi + j * l;
+      for (c = 0; c < l; ++c) {
+        yi[c] += aij * xj[c];
+        yj[c] += aij * xi[c];
+      }
     }
+    pa += n - i;
   }
-  return 0;
 }
@@ -1,6 +1,8 @@
 #ifndef ARRAY_OP_H
 #define ARRAY_OP_H
 
+#include <stddef.h>
+
 // Inverts an upper triangular matrix block considering a diagonal scaling.
 //
 // n: Size of the block (n x n).
@@ -18,24 +20,69 @@ int inverse_upper_triangle_block_and_diagonal(int n, double* a, double* d, doubl
 // Returns: 0 on success, -1 if decomposition cannot be applied.
 int cholesky_for_block(int n, double* a, double* d);
 
-// Inverts an upper triangular block and applies it to a right-hand side vector.
-int inverse_upper_triangle_block_and_diagonal_rhs(int n, double* a, double* d, double* rhs);
+// Applies the updates of rows [0, row) to rows [row, row + rows) of a block
+// that is being factored, for columns [c0, c1) on or right of the diagonal.
+// Together with cholesky_block_panel it splits cholesky_for_block into
+// panels whose columns several threads can process at once.
+//
+// n: Size of the block.
+// row, rows: Panel of rows to update.
+// c0, c1: Range of columns to update.
+// a: The matrix block, rows above the panel already factored.
+// d: Diagonal scaling elements of the rows above the panel.
+void cholesky_block_panel_update(int n, int row, int rows, int c0, int c1, double* a, double* d);
 
-// Inverts a lower triangular block and applies it to a right-hand side vector.
-int inverse_lower_triangle_block_rhs(int n, double* a, double* rhs);
+// Factors rows [row, row + rows) of a block for columns [c0, c1), after
+// cholesky_block_panel_update. The call whose range covers the diagonal
+// part of the panel computes its pivots and d; calls for columns right of it
+// solve against that factored part and must come after it.
+//
+// Returns: 0 on success, -1 if decomposition cannot be applied.
+int cholesky_block_panel(int n, int row, int rows, int c0, int c1, double* a, double* d);
 
-// Multiplies a matrix block by a vector.
-void matrix_block_vector_multiply(int n, int m, double* a, double* b, double* c);
+// Solves R^T * D * X = B in place for an upper triangular block R. Also the
+// panel step of the decomposition, applied to the tiles right of a factored
+// diagonal tile.
+//
+// n: Size of the block R.
+// l: Number of right-hand sides, X is n x l.
+// Returns: 0 on success, -1 if the block is singular.
+int lower_triangle_block_diagonal_solve(int n, int l, double* a, double* d, double* x);
 
-// Multiplies a transposed matrix block by a vector.
-void matrix_block_transposed_vector_multiply(int n, int m, double* a, double* b, double* c);
+// Solves R * X = B in place for an upper triangular block R.
+//
+// n: Size of the block R.
+// l: Number of right-hand sides, X is n x l.
+// Returns: 0 on success, -1 if the block is singular.
+int upper_triangle_block_solve(int n, int l, double* a, double* x);
 
 // Performs C = C - A^T * D * B multiplication for matrix blocks.
+// Dispatches to the fastest variant for the CPU (see array_op_simd.h).
 void main_blocks_diagonal_multiply(int n, int m, int l, double* a, double* b, double* d, double* c);
 
 // Performs C = A * B multiplication for matrix blocks.
 void main_blocks_multiply(int n, int m, int l, double* a, double* b, double* c);
 
+// Performs C = C - A * B multiplication for matrix blocks.
+void main_blocks_multiply_subtract(int n, int m, int l, double* a, double* b, double* c);
+
+// Computes y = A * x for a symmetric matrix in packed upper triangular format.
+void packed_matrix_vector_multiply(int n, double* matrix, double* x, double* y);
+
+// Computes Y = A * X for a symmetric matrix in packed upper triangular format
+// and an n x l row-major block X.
+void packed_matrix_block_multiply(int n, int l, double* matrix, double* x, double* y);
+
+// Index of the diagonal element of row i in packed upper triangular storage
+// of an n x n matrix. Packed indices are size_t throughout, since the packed
+// triangle outgrows int at n = 65536.
+size_t packed_row_offset(int n, int i);
+
+// Table of packed_row_offset() for rows 0..n, for code that walks a column
+// of the packed matrix and would otherwise recompute it for every element.
+// Returns: a table to free(), or NULL if there is not enough memory.
+size_t* packed_row_offsets(int n);
+
 // Copies a diagonal block from the packed matrix to a square buffer.
 void cpy_diagonal_block_to_block(double* a, int t, int matrix_size, int m, double* b);
 
@@ -50,12 +97,4 @@ void cpy_block_to_matrix_block(double* a, int row, int column, int matrix_size,
 void cpy_matrix_block_to_block(double* a, int row, int column, int matrix_size, int n, int m,
                                double* b);
 
-// Solves the R^T * y = b system using forward substitution.
-int solve_lower_triangle_matrix_system(int matrix_size, double* matrix, double* rhs,
-                                       double* workspace, int block_size);
-
-// Solves the D * R * x = y system using backward substitution.
-int solve_upper_triangle_matrix_diagonal_system(int matrix_size, double* matrix, double* diagonal,
-                                                double* rhs, double* workspace, int block_size);
-
 #endif  // ARRAY_OP_H
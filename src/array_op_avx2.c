@@ -0,0 +1,196 @@
+#include <immintrin.h>
+
+#include "array_op_simd.h"
+
+// Micro-tile of C kept in registers: 6 rows x 8 columns, i.e. 12 ymm
+// accumulators, two B vectors and one broadcast out of 16 registers.
+#define AVX2_MR 6
+#define AVX2_NR 8
+// Depth of a packed A panel; 6 x 256 doubles stay resident in L1.
+#define AVX2_KC 256
+
+// Packs mr columns of A (rows of A^T) for kc consecutive k, scaled by d[k].
+// Missing columns of the last panel are padded with zeros.
+static void pack_a_panel(int kc, int mr, int m, double* a, double* d, double* ap) {
+  int k, r;
+  double dk;
+
+  for (k = 0; k < kc; ++k) {
+    dk = d[k];
+    for (r = 0; r < mr; ++r) {
+      ap[r] = a[r] * dk;
+    }
+    for (; r < AVX2_MR; ++r) {
+      ap[r] = 0.0;
+    }
+    ap += AVX2_MR;
+    a += m;
+  }
+}
+
+// C[0:mr, 0:8] -= Ap^T * B[0:kc, 0:8] for a full-width micro-tile.
+static inline void micro_kernel(int kc, int mr, double* ap, double* b, int l, double* c) {
+  int k, r;
+  __m256d acc0[AVX2_MR], acc1[AVX2_MR];
+  __m256d b0, b1, ta;
+
+#pragma GCC unroll 6
+  for (r = 0; r < AVX2_MR; ++r) {
+    acc0[r] = _mm256_setzero_pd();
+    acc1[r] = _mm256_setzero_pd();
+  }
+
+  for (k = 0; k < kc; ++k) {
+    b0 = _mm256_loadu_pd(b);
+    b1 = _mm256_loadu_pd(b + 4);
+#pragma GCC unroll 6
+    for (r = 0; r < AVX2_MR; ++r) {
+      ta = _mm256_broadcast_sd(ap + r);
+      acc0[r] = _mm256_fmadd_pd(ta, b0, acc0[r]);
+      acc1[r] = _mm256_fmadd_pd(ta, b1, acc1[r]);
+    }
+    ap += AVX2_MR;
+    b += l;
+  }
+
+#pragma GCC unroll 6
+  for (r = 0; r < AVX2_MR; ++r) {
+    if (r < mr) {
+      _mm256_storeu_pd(c, _mm256_sub_pd(_mm256_loadu_pd(c), acc0[r]));
+      _mm256_storeu_pd(c + 4, _mm256_sub_pd(_mm256_loadu_pd(c + 4), acc1[r]));
+      c += l;
+    }
+  }
+}
+
+// Same as micro_kernel() for the last nr < 8 columns, using masked accesses.
+static void micro_kernel_edge(int kc, int mr, int nr, double* ap, double* b, int l, double* c) {
+  int k, r;
+  __m256d acc0[AVX2_MR], acc1[AVX2_MR];
+  __m256d b0, b1, ta;
+  __m256i lanes = _mm256_set_epi64x(3, 2, 1, 0);
+  __m256i mask0 = _mm256_cmpgt_epi64(_mm256_set1_epi64x(nr), lanes);
+  __m256i mask1 = _mm256_cmpgt_epi64(_mm256_set1_epi64x(nr - 4), lanes);
+
+  for (r = 0; r < AVX2_MR; ++r) {
+    acc0[r] = _mm256_setzero_pd();
+    acc1[r] = _mm256_setzero_pd();
+  }
+
+  for (k = 0; k < kc; ++k) {
+    b0 = _mm256_maskload_pd(b, mask0);
+    b1 = _mm256_maskload_pd(b + 4, mask1);
+    for (r = 0; r < AVX2_MR; ++r) {
+      ta = _mm256_broadcast_sd(ap + r);
+      acc0[r] = _mm256_fmadd_pd(ta, b0, acc0[r]);
+      acc1[r] = _mm256_fmadd_pd(ta, b1, acc1[r]);
+    }
+    ap += AVX2_MR;
+    b += l;
+  }
+
+  for (r = 0; r < mr; ++r) {
+    _mm256_maskstore_pd(c, mask0, _mm256_sub_pd(_mm256_maskload_pd(c, mask0), acc0[r]));
+    _mm256_maskstore_pd(c + 4, mask1, _mm256_sub_pd(_mm256_maskload_pd(c + 4, mask1), acc1[r]));
+    c += l;
+  }
+}
+
+// C = C - A^T * D * B using packed A panels and a register-blocked
+// micro-kernel. B and C are accessed in place.
+void main_blocks_diagonal_multiply_avx2(int n, int m, int l, double* a, double* b, double* d,
+                                        double* c) {
+  int i, j, k, kc, mr;
+  double ap[AVX2_MR * AVX2_KC] __attribute__((aligned(32)));
+
+  for (k = 0; k < n; k += AVX2_KC) {
+    kc = (k + AVX2_KC < n ? AVX2_KC : n - k);
+    for (i = 0; i < m; i += AVX2_MR) {
+      mr = (i + AVX2_MR < m ? AVX2_MR : m - i);
+      pack_a_panel(kc, mr, m, a + k * m + i, d + k, ap);
+
+      for (j = 0; j + AVX2_NR <= l; j += AVX2_NR) {
+        micro_kernel(kc, mr, ap, b + k * l + j, l, c + i * l + j);
+      }
+      if (j < l) {
+        micro_kernel_edge(kc, mr, l - j, ap, b + k * l + j, l, c + i * l + j);
+      }
+    }
+  }
+}
+
+// Single precision: the same 6-row micro-tile is 16 floats wide.
+#define AVX2_NR_FLOAT 16
+
+static void pack_a_panel_float(int kc, int mr, int m, float* a, float* d, float* ap) {
+  int k, r;
+  float dk;
+
+  for (k = 0; k < kc; ++k) {
+    dk = d[k];
+    for (r = 0; r < mr; ++r) {
+      ap[r] = a[r] * dk;
+    }
+    for (; r < AVX2_MR; ++r) {
+      ap[r] = 0.0f;
+    }
+    ap += AVX2_MR;
+    a += m;
+  }
+}
+
+// C[0:mr, 0:nr] -= Ap^T * B[0:kc, 0:nr], with the columns selected by masks.
+static inline void micro_kernel_float(int kc, int mr, float* ap, float* b, int l, float* c,
+                                      __m256i mask0, __m256i mask1) {
+  int k, r;
+  __m256 acc0[AVX2_MR], acc1[AVX2_MR];
+  __m256 b0, b1, ta;
+
+#pragma GCC unroll 6
+  for (r = 0; r < AVX2_MR; ++r) {
+    acc0[r] = _mm256_setzero_ps();
+    acc1[r] = _mm256_setzero_ps();
+  }
+
+  for (k = 0; k < kc; ++k) {
+    b0 = _mm256_maskload_ps(b, mask0);
+    b1 = _mm256_maskload_ps(b + 8, mask1);
+#pragma GCC unroll 6
+    for (r = 0; r < AVX2_MR; ++r) {
+      ta = _mm256_broadcast_ss(ap + r);
+      acc0[r] = _mm256_fmadd_ps(ta, b0, acc0[r]);
+      acc1[r] = _mm256_fmadd_ps(ta, b1, acc1[r]);
+    }
+    ap += AVX2_MR;
+    b += l;
+  }
+
+  for (r = 0; r < mr; ++r) {
+    _mm256_maskstore_ps(c, mask0, _mm256_sub_ps(_mm256_maskload_ps(c, mask0), acc0[r]));
+    _mm256_maskstore_ps(c + 8, mask1, _mm256_sub_ps(_mm256_maskload_ps(c + 8, mask1), acc1[r]));
+    c += l;
+  }
+}
+
+void main_blocks_diagonal_multiply_float_avx2(int n, int m, int l, float* a, float* b, float* d,
+                                              float* c) {
+  int i, j, k, kc, mr, nr;
+  float ap[AVX2_MR * AVX2_KC] __attribute__((aligned(32)));
+  __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+  __m256i mask0, mask1;
+
+  for (k = 0; k < n; k += AVX2_KC) {
+    kc = (k + AVX2_KC < n ? AVX2_KC : n - k);
+    for (i = 0; i < m; i += AVX2_MR) {
+      mr = (i + AVX2_MR < m ? AVX2_MR : m - i);
+      pack_a_panel_float(kc, mr, m, a + k * m + i, d + k, ap);
+
+      for (j = 0; j < l; j += AVX2_NR_FLOAT) {
+        nr = (j + AVX2_NR_FLOAT < l ? AVX2_NR_FLOAT : l - j);
+        mask0 = _mm256_cmpgt_epi32(_mm256_set1_epi32(nr), lanes);
+        mask1 = _mm256_cmpgt_epi32(_mm256_set1_epi32(nr - 8), lanes);
+        micro_kernel_float(kc, mr, ap, b + k * l + j, l, c + i * l + j, mask0, mask1);
+      }
+    }
+  }
+}
@@ -0,0 +1,172 @@
+#include <immintrin.h>
+
+#include "array_op_simd.h"
+
+// Micro-tile of C kept in registers: 14 rows x 16 columns, i.e. 28 zmm
+// accumulators, two B vectors and one broadcast out of 32 registers.
+#define AVX512_MR 14
+#define AVX512_NR 16
+// Depth of a packed A panel. The 14 x 128 doubles of the panel (14 KB) and
+// the 128 x 16 doubles of one B strip streamed against it (16 KB) fit
+// together into a 32 KB L1 data cache.
+#define AVX512_KC 128
+
+// Packs mr columns of A (rows of A^T) for kc consecutive k, scaled by d[k].
+// Missing columns of the last panel are padded with zeros.
+static void pack_a_panel(int kc, int mr, int m, double* a, double* d, double* ap) {
+  int k, r;
+  double dk;
+
+  for (k = 0; k < kc; ++k) {
+    dk = d[k];
+    for (r = 0; r < mr; ++r) {
+      ap[r] = a[r] * dk;
+    }
+    for (; r < AVX512_MR; ++r) {
+      ap[r] = 0.0;
+    }
+    ap += AVX512_MR;
+    a += m;
+  }
+}
+
+// C[0:mr, 0:nr] -= Ap^T * B[0:kc, 0:nr], with the columns selected by masks.
+static inline void micro_kernel(int kc, int mr, double* ap, double* b, int l, double* c,
+                                __mmask8 mask0, __mmask8 mask1) {
+  int k, r;
+  __m512d acc0[AVX512_MR], acc1[AVX512_MR];
+  __m512d b0, b1, ta;
+
+#pragma GCC unroll 14
+  for (r = 0; r < AVX512_MR; ++r) {
+    acc0[r] = _mm512_setzero_pd();
+    acc1[r] = _mm512_setzero_pd();
+  }
+
+  for (k = 0; k < kc; ++k) {
+    b0 = _mm512_maskz_loadu_pd(mask0, b);
+    b1 = _mm512_maskz_loadu_pd(mask1, b + 8);
+#pragma GCC unroll 14
+    for (r = 0; r < AVX512_MR; ++r) {
+      ta = _mm512_set1_pd(ap[r]);
+      acc0[r] = _mm512_fmadd_pd(ta, b0, acc0[r]);
+      acc1[r] = _mm512_fmadd_pd(ta, b1, acc1[r]);
+    }
+    ap += AVX512_MR;
+    b += l;
+  }
+
+#pragma GCC unroll 14
+  for (r = 0; r < AVX512_MR; ++r) {
+    if (r < mr) {
+      _mm512_mask_storeu_pd(c, mask0,
+                            _mm512_sub_pd(_mm512_maskz_loadu_pd(mask0, c), acc0[r]));
+      _mm512_mask_storeu_pd(c + 8, mask1,
+                            _mm512_sub_pd(_mm512_maskz_loadu_pd(mask1, c + 8), acc1[r]));
+      c += l;
+    }
+  }
+}
+
+// C = C - A^T * D * B using packed A panels and a register-blocked
+// micro-kernel. B and C are accessed in place.
+void main_blocks_diagonal_multiply_avx512(int n, int m, int l, double* a, double* b, double* d,
+                                          double* c) {
+  int i, j, k, kc, mr, nr;
+  double ap[AVX512_MR * AVX512_KC] __attribute__((aligned(64)));
+  __mmask8 mask0, mask1;
+
+  for (k = 0; k < n; k += AVX512_KC) {
+    kc = (k + AVX512_KC < n ? AVX512_KC : n - k);
+    for (i = 0; i < m; i += AVX512_MR) {
+      mr = (i + AVX512_MR < m ? AVX512_MR : m - i);
+      pack_a_panel(kc, mr, m, a + k * m + i, d + k, ap);
+
+      for (j = 0; j < l; j += AVX512_NR) {
+        nr = (j + AVX512_NR < l ? AVX512_NR : l - j);
+        mask0 = (nr >= 8 ? 0xFF : (1u << nr) - 1);
+        mask1 = (nr >= 16 ? 0xFF : (nr > 8 ? (1u << (nr - 8)) - 1 : 0));
+        micro_kernel(kc, mr, ap, b + k * l + j, l, c + i * l + j, mask0, mask1);
+      }
+    }
+  }
+}
+
+// Single precision: the same 14-row micro-tile is 32 floats wide.
+#define AVX512_NR_FLOAT 32
+
+static void pack_a_panel_float(int kc, int mr, int m, float* a, float* d, float* ap) {
+  int k, r;
+  float dk;
+
+  for (k = 0; k < kc; ++k) {
+    dk = d[k];
+    for (r = 0; r < mr; ++r) {
+      ap[r] = a[r] * dk;
+    }
+    for (; r < AVX512_MR; ++r) {
+      ap[r] = 0.0f;
+    }
+    ap += AVX512_MR;
+    a += m;
+  }
+}
+
+// C[0:mr, 0:nr] -= Ap^T * B[0:kc, 0:nr], with the columns selected by masks.
+static inline void micro_kernel_float(int kc, int mr, float* ap, float* b, int l, float* c,
+                                      __mmask16 mask0, __mmask16 mask1) {
+  int k, r;
+  __m512 acc0[AVX512_MR], acc1[AVX512_MR];
+  __m512 b0, b1, ta;
+
+#pragma GCC unroll 14
+  for (r = 0; r < AVX512_MR; ++r) {
+    acc0[r] = _mm512_setzero_ps();
+    acc1[r] = _mm512_setzero_ps();
+  }
+
+  for (k = 0; k < kc; ++k) {
+    b0 = _mm512_maskz_loadu_ps(mask0, b);
+    b1 = _mm512_maskz_loadu_ps(mask1, b + 16);
+#pragma GCC unroll 14
+    for (r = 0; r < AVX512_MR; ++r) {
+      ta = _mm512_set1_ps(ap[r]);
+      acc0[r] = _mm512_fmadd_ps(ta, b0, acc0[r]);
+      acc1[r] = _mm512_fmadd_ps(ta, b1, acc1[r]);
+    }
+    ap += AVX512_MR;
+    b += l;
+  }
+
+#pragma GCC unroll 14
+  for (r = 0; r < AVX512_MR; ++r) {
+    if (r < mr) {
+      _mm512_mask_storeu_ps(c, mask0, _mm512_sub_ps(_mm512_maskz_loadu_ps(mask0, c), acc0[r]));
+      _mm512_mask_storeu_ps(c + 16, mask1,
+                            _mm512_sub_ps(_mm512_maskz_loadu_ps(mask1, c + 16), acc1[r]));
+      c += l;
+    }
+  }
+}
+
+void main_blocks_diagonal_multiply_float_avx512(int n, int m, int l, float* a, float* b, float* d,
+                                                float* c) {
+  int i, j, k, kc, mr, nr;
+  float ap[AVX512_MR * AVX512_KC] __attribute__((aligned(64)));
+  __mmask16 mask0, mask1;
+
+  for (k = 0; k < n; k += AVX512_KC) {
+    kc = (k + AVX512_KC < n ? AVX512_KC : n - k);
+    for (i = 0; i < m; i += AVX512_MR) {
+      mr = (i + AVX512_MR < m ? AVX512_MR : m - i);
+      pack_a_panel_float(kc, mr, m, a + k * m + i, d + k, ap);
+
+      for (j = 0; j < l; j += AVX512_NR_FLOAT) {
+        nr = (j + AVX512_NR_FLOAT < l ? AVX512_NR_FLOAT : l - j);
+        mask0 = (nr >= 16 ? 0xFFFF : (1u << nr) - 1);
+        mask1 = (nr >= 32 ? 0xFFFF : (nr > 16 ? (1u << (nr - 16)) - 1 : 0));
+        micro_kernel_float(kc, mr, ap, b + k * l + j, l, c + i * l + j, mask0, mask1);
+      }
+    }
+  }
+}
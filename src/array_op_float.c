@@ -0,0 +1,172 @@
+#include "array_op_float.h"
+
+#include <math.h>
+
+#include "array_op_simd.h"
+
+// Smallest pivot accepted in single precision.
+const float EPS_FLOAT = 1e-7f;
+
+// Portable block multiplication in single precision: C = C - A^T * D * B.
+void main_blocks_diagonal_multiply_float_scalar(int n, int m, int l, float* a, float* b, float* d,
+                                                float* c) {
+  int i, j, k;
+  float *pa, *pb, *pc, pd, ta;
+
+  pa = a;
+  pb = b;
+  for (k = 0; k < n; ++k) {
+    pd = d[k];
+    pc = c;
+    for (i = 0; i < m; ++i) {
+      ta = pa[i] * pd;
+      for (j = 0; j < l - 7; j += 8) {
+        pc[j] -= pb[j] * ta;
+        pc[j + 1] -= pb[j + 1] * ta;
+        pc[j + 2] -= pb[j + 2] * ta;
+        pc[j + 3] -= pb[j + 3] * ta;
+        pc[j + 4] -= pb[j + 4] * ta;
+        pc[j + 5] -= pb[j + 5] * ta;
+        pc[j + 6] -= pb[j + 6] * ta;
+        pc[j + 7] -= pb[j + 7] * ta;
+      }
+      for (; j < l; ++j) {
+        pc[j] -= pb[j] * ta;
+      }
+      pc += l;
+    }
+    pa += m;
+    pb += l;
+  }
+}
+
+// The double precision dispatch decides the instruction set, so that
+// CHOLESKY_KERNEL and kernel_select_isa() apply to both precisions.
+void main_blocks_diagonal_multiply_float(int n, int m, int l, float* a, float* b, float* d,
+                                         float* c) {
+  switch (kernel_isa()) {
+#ifdef CHOLESKY_X86_KERNELS
+    case KERNEL_ISA_AVX2:
+      main_blocks_diagonal_multiply_float_avx2(n, m, l, a, b, d, c);
+      return;
+    case KERNEL_ISA_AVX512:
+      main_blocks_diagonal_multiply_float_avx512(n, m, l, a, b, d, c);
+      return;
+#endif
+    default:
+      main_blocks_diagonal_multiply_float_scalar(n, m, l, a, b, d, c);
+  }
+}
+
+// Block multiplication: C = C - A * B.
+void main_blocks_multiply_subtract_float(int n, int m, int l, float* a, float* b, float* c) {
+  int i, j, k;
+  float *pb, *pc, ta;
+
+  pc = c;
+  for (i = 0; i < n; ++i) {
+    pb = b;
+    for (k = 0; k < m; ++k) {
+      ta = a[i * m + k];
+      for (j = 0; j < l; ++j) {
+        pc[j] -= pb[j] * ta;
+      }
+      pb += l;
+    }
+    pc += l;
+  }
+}
+
+// Non-blocked Cholesky for a single block.
+int cholesky_for_block_float(int n, float* a, float* d) {
+  int i, j, k;
+  float *pai, *pak, dt;
+
+  for (i = 0; i < n; ++i) {
+    d[i] = 1.0f;
+  }
+
+  pai = a;
+  for (i = 0; i < n; ++i) {
+    pak = a;
+    for (k = 0; k < i; ++k) {
+      for (j = i; j < n; ++j) {
+        pai[j] -= pak[i] * d[k] * pak[j];
+      }
+      pak += n;
+    }
+
+    if (pai[i] < 0.0f) {
+      d[i] = -1.0f;
+      pai[i] = -pai[i];
+    }
+    pai[i] = sqrtf(pai[i]);
+
+    if (fabsf(pai[i]) < EPS_FLOAT) {
+      return -1;
+    }
+
+    dt = 1.0f / (pai[i] * d[i]);
+    for (j = i + 1; j < n; ++j) {
+      pai[j] *= dt;
+    }
+    pai += n;
+  }
+  return 0;
+}
+
+// Same single pass as lower_triangle_block_diagonal_solve().
+int lower_triangle_block_diagonal_solve_float(int n, int l, float* a, float* d, float* x) {
+  int i, j, k;
+  float *pxi, *pxk, dt;
+
+  pxi = x;
+  for (i = 0; i < n; ++i) {
+    if (fabsf(a[i * n + i]) < EPS_FLOAT) {
+      return -1;
+    }
+    dt = d[i] / a[i * n + i];
+    for (j = 0; j < l; ++j) {
+      pxi[j] *= dt;
+    }
+
+    pxk = pxi + l;
+    for (k = i + 1; k < n; ++k) {
+      dt = a[i * n + k] * d[i];
+      for (j = 0; j < l; ++j) {
+        pxk[j] -= pxi[j] * dt;
+      }
+      pxk += l;
+    }
+    pxi += l;
+  }
+  return 0;
+}
+
+// Solves R * X = B in place for a block of right-hand sides.
+int upper_triangle_block_solve_float(int n, int l, float* a, float* x) {
+  int i, j, k;
+  float *pxi, *pxk, dt;
+
+  pxi = x + (n - 1) * l;
+  for (i = n - 1; i >= 0; --i) {
+    if (fabsf(a[i * n + i]) < EPS_FLOAT) {
+      return -1;
+    }
+    dt = 1.0f / a[i * n + i];
+    for (j = 0; j < l; ++j) {
+      pxi[j] *= dt;
+    }
+
+    pxk = x;
+    for (k = 0; k < i; ++k) {
+      dt = a[k * n + i];
+      for (j = 0; j < l; ++j) {
+        pxk[j] -= pxi[j] * dt;
+      }
+      pxk += l;
+    }
+    pxi -= l;
+  }
+  return 0;
+}
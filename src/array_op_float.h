@@ -0,0 +1,28 @@
+#ifndef ARRAY_OP_FLOAT_H
+#define ARRAY_OP_FLOAT_H
+
+// Single precision variants of the block kernels in array_op.h, used by the
+// mixed precision factorization (see cholesky_mixed.h). Arguments and block
+// layouts are the same as for the double precision kernels.
+
+// Applies Cholesky decomposition to a single matrix block.
+// Returns: 0 on success, -1 if decomposition cannot be applied.
+int cholesky_for_block_float(int n, float* a, float* d);
+
+// Performs C = C - A^T * D * B multiplication for matrix blocks.
+// Dispatches to the instruction set picked for main_blocks_diagonal_multiply.
+void main_blocks_diagonal_multiply_float(int n, int m, int l, float* a, float* b, float* d,
+                                         float* c);
+
+// Performs C = C - A * B multiplication for matrix blocks.
+void main_blocks_multiply_subtract_float(int n, int m, int l, float* a, float* b, float* c);
+
+// Solves R^T * D * X = B in place for an upper triangular block R.
+// Returns: 0 on success, -1 if the block is singular.
+int lower_triangle_block_diagonal_solve_float(int n, int l, float* a, float* d, float* x);
+
+// Solves R * X = B in place for an upper triangular block R.
+// Returns: 0 on success, -1 if the block is singular.
+int upper_triangle_block_solve_float(int n, int l, float* a, float* x);
+
+#endif  // ARRAY_OP_FLOAT_H
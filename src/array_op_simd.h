@@ -0,0 +1,54 @@
+#ifndef ARRAY_OP_SIMD_H
+#define ARRAY_OP_SIMD_H
+
+// Instruction set variants of the block kernels.
+//
+// main_blocks_diagonal_multiply() dispatches at runtime to the widest variant
+// supported by the CPU. The choice can be pinned with the CHOLESKY_KERNEL
+// environment variable ("scalar", "avx2" or "avx512").
+
+typedef enum {
+  KERNEL_ISA_SCALAR = 0,
+  KERNEL_ISA_AVX2 = 1,
+  KERNEL_ISA_AVX512 = 2,
+} KernelIsa;
+
+// Returns the instruction set currently used by the dispatched kernels.
+KernelIsa kernel_isa(void);
+
+// Returns a printable name of the instruction set.
+const char* kernel_isa_name(KernelIsa isa);
+
+// Forces the dispatched kernels to use the given instruction set. Must not
+// be called while any kernel is running, since the kernels read the
+// selection without synchronization.
+// Returns: 0 on success, -1 if the CPU or the build does not support it.
+int kernel_select_isa(KernelIsa isa);
+
+// Portable C = C - A^T * D * B kernel, see main_blocks_diagonal_multiply().
+void main_blocks_diagonal_multiply_scalar(int n, int m, int l, double* a, double* b, double* d,
+                                          double* c);
+
+// Portable single precision kernel, see main_blocks_diagonal_multiply_float().
+void main_blocks_diagonal_multiply_float_scalar(int n, int m, int l, float* a, float* b, float* d,
+                                                float* c);
+
+#ifdef CHOLESKY_X86_KERNELS
+// Register-blocked 6x8 AVX2/FMA micro-kernel variant.
+void main_blocks_diagonal_multiply_avx2(int n, int m, int l, double* a, double* b, double* d,
+                                        double* c);
+
+// Register-blocked 14x16 AVX-512 micro-kernel variant.
+void main_blocks_diagonal_multiply_avx512(int n, int m, int l, double* a, double* b, double* d,
+                                          double* c);
+
+// Single precision 6x16 AVX2/FMA variant.
+void main_blocks_diagonal_multiply_float_avx2(int n, int m, int l, float* a, float* b, float* d,
+                                              float* c);
+
+// Single precision 14x32 AVX-512 variant.
+void main_blocks_diagonal_multiply_float_avx512(int n, int m, int l, float* a, float* b, float* d,
+                                                float* c);
+#endif
+
+#endif  // ARRAY_OP_SIMD_H
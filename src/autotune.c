@@ -0,0 +1,286 @@
+#include "autotune.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_io.h"
+#include "array_op.h"
+#include "cholesky_recursive.h"
+#include "timer.h"
+
+// Candidate block sizes, all multiples of 8.
+static const int AUTOTUNE_BLOCK_SIZES[] = {16, 24, 32, 48, 64, 96, 128, 192, 256};
+
+// Largest matrix the factorizations are timed on.
+const int AUTOTUNE_MAX_SIZE = 3000;
+
+// Block sizes whose kernel reaches this fraction of the fastest one are timed
+// in full factorizations. Larger tiles always win the kernel benchmark, but
+// they leave fewer tiles to share between threads.
+const double AUTOTUNE_KERNEL_CUTOFF = 0.75;
+
+// Minimum duration of one kernel measurement in nanoseconds.
+const double AUTOTUNE_KERNEL_TIME = 2e7;
+
+// Longest line of the profile file.
+#define AUTOTUNE_LINE_LENGTH 512
+
+// Reads the CPU model name, without tabs, or "unknown".
+static void autotune_cpu_model(char* model, int size) {
+  char line[AUTOTUNE_LINE_LENGTH];
+  char *p, *q;
+  FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+
+  snprintf(model, size, "unknown");
+  if (!cpuinfo) {
+    return;
+  }
+  while (fgets(line, sizeof(line), cpuinfo)) {
+    if (strncmp(line, "model name", 10) || !(p = strchr(line, ':'))) {
+      continue;
+    }
+    for (++p; *p == ' '; ++p) {
+    }
+    for (q = p; *q; ++q) {
+      if (*q == '\t' || *q == '\n') {
+        *q = *q == '\t' ? ' ' : 0;
+      }
+    }
+    snprintf(model, size, "%s", p);
+    break;
+  }
+  fclose(cpuinfo);
+}
+
+// The power-of-two range [n_min, n_max] that contains matrix_size.
+static void autotune_size_range(int matrix_size, int* n_min, int* n_max) {
+  *n_min = 1;
+  while (*n_min <= matrix_size / 2) {
+    *n_min *= 2;
+  }
+  *n_max = 2 * *n_min - 1;
+}
+
+// Parses a profile line.
+// Returns: 0 if the line belongs to the CPU model, -1 otherwise.
+static int autotune_parse_line(const char* line, const char* model, int* engine, int* n_min,
+                               int* n_max, TuneProfile* profile) {
+  const char* tab = strchr(line, '\t');
+
+  if (!tab || (size_t)(tab - line) != strlen(model) || strncmp(line, model, tab - line)) {
+    return -1;
+  }
+  return sscanf(tab + 1, "%d\t%d\t%d\t%d\t%d\t%lf", engine, n_min, n_max, &profile->block_size,
+                &profile->total_threads, &profile->gflops) == 6
+             ? 0
+             : -1;
+}
+
+void autotune_profile_path(char* buffer, int size) {
+  const char* path = getenv("CHOLESKY_PROFILE");
+  const char* home = getenv("HOME");
+
+  if (path && *path) {
+    snprintf(buffer, size, "%s", path);
+  } else if (home && *home) {
+    snprintf(buffer, size, "%s/.cholesky_profile", home);
+  } else {
+    snprintf(buffer, size, ".cholesky_profile");
+  }
+}
+
+int autotune_lookup(const char* path, int matrix_size, CholeskyEngine engine,
+                    TuneProfile* profile) {
+  char model[AUTOTUNE_LINE_LENGTH];
+  char line[AUTOTUNE_LINE_LENGTH];
+  int line_engine, n_min, n_max;
+  FILE* file = fopen(path, "r");
+
+  if (!file) {
+    return -1;
+  }
+  autotune_cpu_model(model, sizeof(model));
+
+  while (fgets(line, sizeof(line), file)) {
+    if (!autotune_parse_line(line, model, &line_engine, &n_min, &n_max, profile) &&
+        line_engine == (int)engine && n_min <= matrix_size && matrix_size <= n_max &&
+        profile->block_size > 0 && profile->total_threads > 0) {
+      fclose(file);
+      return 0;
+    }
+  }
+  fclose(file);
+  return -1;
+}
+
+int autotune_store(const char* path, int matrix_size, CholeskyEngine engine,
+                   const TuneProfile* profile) {
+  char model[AUTOTUNE_LINE_LENGTH];
+  char line[AUTOTUNE_LINE_LENGTH];
+  char temporary[AUTOTUNE_LINE_LENGTH + 8];
+  int line_engine, n_min, n_max, range_min, range_max;
+  TuneProfile old;
+  FILE *input, *output;
+
+  autotune_cpu_model(model, sizeof(model));
+  autotune_size_range(matrix_size, &range_min, &range_max);
+
+  // Rewrite the profile through a temporary file, so that concurrent readers
+  // never see it half written.
+  snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+  if (!(output = fopen(temporary, "w"))) {
+    printf("Cannot write tuning profile %s\n", path);
+    return -1;
+  }
+  if ((input = fopen(path, "r"))) {
+    while (fgets(line, sizeof(line), input)) {
+      if (!autotune_parse_line(line, model, &line_engine, &n_min, &n_max, &old) &&
+          line_engine == (int)engine && n_min == range_min && n_max == range_max) {
+        continue;
+      }
+      fputs(line, output);
+    }
+    fclose(input);
+  }
+  fprintf(output, "%s\t%d\t%d\t%d\t%d\t%d\t%.2f\n", model, engine, range_min, range_max,
+          profile->block_size, profile->total_threads, profile->gflops);
+
+  if (fclose(output) || rename(temporary, path)) {
+    printf("Cannot write tuning profile %s\n", path);
+    remove(temporary);
+    return -1;
+  }
+  return 0;
+}
+
+// Rate of main_blocks_diagonal_multiply on m x m blocks in GFLOP/s.
+static double autotune_kernel(int m) {
+  double *a, *b, *c, *d;
+  double start, elapsed;
+  long repeats = 0;
+  int i;
+
+  if (!(a = (double*)malloc((3 * m * m + m) * sizeof(double)))) {
+    return 0;
+  }
+  b = a + m * m;
+  c = b + m * m;
+  d = c + m * m;
+  for (i = 0; i < m * m; ++i) {
+    a[i] = 1.0 / (i + 1);
+    b[i] = 1.0 / (i + 2);
+    c[i] = 0;
+  }
+  for (i = 0; i < m; ++i) {
+    d[i] = i % 3 ? 1 : -1;
+  }
+
+  start = get_time_monotonic();
+  do {
+    main_blocks_diagonal_multiply(m, m, m, a, b, d, c);
+    ++repeats;
+    elapsed = get_time_monotonic() - start;
+  } while (elapsed < AUTOTUNE_KERNEL_TIME);
+
+  free(a);
+  return 2.0 * m * m * m * repeats / elapsed;
+}
+
+// Rate of the whole factorization in GFLOP/s, best of two runs, or 0 if it
+// cannot be applied.
+static double autotune_factorization(int matrix_size, int block_size, int total_threads,
+                                     const CholeskyOptions* options, double* packed) {
+  CholeskyOptions quiet = *options;
+  cholesky_factor_t* factor;
+  double start, elapsed, best = 0;
+  int run;
+
+  quiet.quiet = 1;
+  quiet.trace = 0;
+  if (!(factor = cholesky_factor_create(matrix_size, block_size, total_threads, &quiet))) {
+    return 0;
+  }
+  for (run = 0; run < 2; ++run) {
+    start = get_time_monotonic();
+    if (cholesky_factor_factor(factor, packed)) {
+      best = 0;
+      break;
+    }
+    elapsed = get_time_monotonic() - start;
+    if (!best || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  cholesky_factor_destroy(factor);
+
+  return best ? (double)matrix_size * matrix_size * matrix_size / 3.0 / best : 0;
+}
+
+int autotune_run(int matrix_size, int max_threads, const CholeskyOptions* options,
+                 TuneProfile* profile) {
+  int candidates[sizeof(AUTOTUNE_BLOCK_SIZES) / sizeof(AUTOTUNE_BLOCK_SIZES[0])];
+  double rates[sizeof(AUTOTUNE_BLOCK_SIZES) / sizeof(AUTOTUNE_BLOCK_SIZES[0])];
+  int count = 0, i, threads;
+  int bench_size = matrix_size < AUTOTUNE_MAX_SIZE ? matrix_size : AUTOTUNE_MAX_SIZE;
+  double best = 0, rate;
+  double *packed, *vector_answer, *rhs;
+
+  memset(profile, 0, sizeof(TuneProfile));
+
+  if (options->engine == CHOLESKY_ENGINE_RECURSIVE) {
+    // The recursive engine has a fixed tile size; only the threads are tuned.
+    candidates[count++] = cholesky_recursive_leaf_size(bench_size);
+  } else {
+    for (i = 0; i < (int)(sizeof(AUTOTUNE_BLOCK_SIZES) / sizeof(AUTOTUNE_BLOCK_SIZES[0])) &&
+                AUTOTUNE_BLOCK_SIZES[i] <= bench_size;
+         ++i) {
+      rates[i] = autotune_kernel(AUTOTUNE_BLOCK_SIZES[i]);
+      printf("Kernel m=%d: %.2f GFLOP/s\n", AUTOTUNE_BLOCK_SIZES[i], rates[i]);
+      if (rates[i] > best) {
+        best = rates[i];
+      }
+    }
+    while (--i >= 0) {
+      if (rates[i] >= AUTOTUNE_KERNEL_CUTOFF * best) {
+        candidates[count++] = AUTOTUNE_BLOCK_SIZES[i];
+      }
+    }
+    if (!count) {
+      candidates[count++] = bench_size;
+    }
+    best = 0;
+  }
+
+  if (!(packed = (double*)malloc(((bench_size * (bench_size + 1)) / 2 + 2 * bench_size) *
+                                 sizeof(double)))) {
+    printf("Not enough memory\n");
+    return -1;
+  }
+  vector_answer = packed + (bench_size * (bench_size + 1)) / 2;
+  rhs = vector_answer + bench_size;
+  fill_vector_answer(bench_size, vector_answer);
+  fill_matrix(bench_size, packed, vector_answer, rhs);
+
+  for (i = 0; i < count; ++i) {
+    // Powers of two up to max_threads, and max_threads itself.
+    for (threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+      rate = autotune_factorization(bench_size, candidates[i], threads, options, packed);
+      printf("Factorization n=%d m=%d threads=%d: %.2f GFLOP/s\n", bench_size, candidates[i],
+             threads, rate);
+      if (rate > best) {
+        best = rate;
+        profile->block_size = candidates[i];
+        profile->total_threads = threads;
+        profile->gflops = rate;
+        profile->matrix_size = bench_size;
+      }
+      if (threads == max_threads) {
+        break;
+      }
+    }
+  }
+
+  free(packed);
+  return best > 0 ? 0 : -1;
+}
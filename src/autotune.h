@@ -0,0 +1,50 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "cholesky_factor.h"
+
+// Block size and thread count tuning.
+//
+// The tuner measures main_blocks_diagonal_multiply for a set of candidate
+// block sizes, keeps the ones within reach of the fastest, and then times
+// complete factorizations for every remaining block size and a ladder of
+// thread counts. The factorizations are timed on matrices of at most 3000
+// rows, so the winner only describes the size it was timed on. It is stored
+// in a profile file keyed by CPU model, engine and the matrix size range
+// (powers of two) of that size, from which later runs read it when the block
+// size or thread count is not given.
+//
+// Profile lines are tab-separated:
+//   cpu_model  engine  n_min  n_max  block_size  threads  gflops
+
+// Best known configuration for a matrix size.
+typedef struct _TuneProfile {
+  int block_size;     // Tile size M.
+  int total_threads;  // Thread count.
+  double gflops;      // Factorization rate it reached during tuning.
+  int matrix_size;    // Matrix size the factorizations were timed on.
+} TuneProfile;
+
+// Writes the profile path to buffer: $CHOLESKY_PROFILE if set, otherwise
+// $HOME/.cholesky_profile, otherwise .cholesky_profile.
+void autotune_profile_path(char* buffer, int size);
+
+// Looks up the configuration for the current CPU, the engine and the size
+// range of matrix_size.
+// Returns: 0 if found, -1 otherwise.
+int autotune_lookup(const char* path, int matrix_size, CholeskyEngine engine,
+                    TuneProfile* profile);
+
+// Benchmarks the candidates for a matrix of the given size, capped at 3000
+// rows, with up to max_threads threads and prints the measurements.
+// Returns: 0 on success, -1 if no candidate could be run.
+int autotune_run(int matrix_size, int max_threads, const CholeskyOptions* options,
+                 TuneProfile* profile);
+
+// Stores the configuration, replacing an earlier one for the same CPU,
+// engine and size range.
+// Returns: 0 on success, -1 if the file cannot be written.
+int autotune_store(const char* path, int matrix_size, CholeskyEngine engine,
+                   const TuneProfile* profile);
+
+#endif  // AUTOTUNE_H
@@ -0,0 +1,329 @@
+#include "cholesky_batch.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "array_op_simd.h"
+#include "thread_pool.h"
+
+// Pivots below this magnitude make a system fail, as in cholesky_for_block.
+const double BATCH_EPS = 1e-16;
+
+// Batches of fewer groups run on the calling thread alone, since waking the
+// pool costs more than they take.
+const int BATCH_MIN_PARALLEL_GROUPS = 16;
+
+typedef enum {
+  BATCH_FACTOR = 0,
+  BATCH_SOLVE = 1,
+} BatchOperation;
+
+// Per-thread arguments of a batch job.
+typedef struct _BatchArgs {
+  cholesky_batch_t* batch;  // Handle of the job.
+  int thread_id;            // Unique ID for the current thread.
+  int failed;               // Systems of the thread that cannot be factored.
+} BatchArgs;
+
+struct _CholeskyBatch {
+  int total_threads;         // Number of threads in the pool.
+  BatchOperation operation;  // Operation of the running job.
+  int matrix_size;           // Size of every system (n x n).
+  int count;                 // Number of systems.
+  int groups;                // Number of groups of BATCH_LANES systems.
+  double* matrices;          // Interleaved matrices or factors.
+  double* diagonal;          // Interleaved diagonal scaling elements.
+  double* rhs;               // Interleaved right-hand sides.
+  int* status;               // Status of every system, or NULL.
+  BatchArgs* args;           // Per-thread arguments.
+  ThreadPool pool;           // Worker threads.
+};
+
+// One element of every system of a group. Plain loops over the lanes are
+// not vectorized, since the compiler cannot rule out that two rows overlap.
+typedef double batch_vector __attribute__((vector_size(8 * BATCH_LANES), aligned(8), may_alias));
+
+// Factors the systems of one group, row by row as cholesky_for_block does.
+// Row i of R also goes to column i of the strict lower triangle, so that
+// every element of R is the dot product of two contiguous rows of R^T: the
+// columns of R are n vectors apart, which maps them all to the same cache
+// set for the common sizes.
+// failed: Output, non-zero for every lane that cannot be factored.
+static inline __attribute__((always_inline)) void batch_factor_group(int n, double* matrices,
+                                                                     double* diagonal,
+                                                                     int* failed) {
+  batch_vector* a = (batch_vector*)matrices;
+  batch_vector* d = (batch_vector*)diagonal;
+  batch_vector *ai, *w0, *w1, *w2, *w3, s, c0, c1, c2, c3, pivot, sign = {0};
+  int i, j, k, l;
+
+  for (l = 0; l < BATCH_LANES; ++l) {
+    failed[l] = 0;
+  }
+  for (i = 0; i < n; ++i) {
+    ai = a + i * n;
+    for (j = i; j + 3 < n; j += 4) {
+      w0 = a + j * n;
+      w1 = w0 + n;
+      w2 = w1 + n;
+      w3 = w2 + n;
+      c0 = ai[j];
+      c1 = ai[j + 1];
+      c2 = ai[j + 2];
+      c3 = ai[j + 3];
+      for (k = 0; k < i; ++k) {
+        s = ai[k] * d[k];
+        c0 -= s * w0[k];
+        c1 -= s * w1[k];
+        c2 -= s * w2[k];
+        c3 -= s * w3[k];
+      }
+      ai[j] = c0;
+      ai[j + 1] = c1;
+      ai[j + 2] = c2;
+      ai[j + 3] = c3;
+    }
+    for (; j < n; ++j) {
+      w0 = a + j * n;
+      c0 = ai[j];
+      for (k = 0; k < i; ++k) {
+        c0 -= ai[k] * d[k] * w0[k];
+      }
+      ai[j] = c0;
+    }
+
+    pivot = ai[i];
+    for (l = 0; l < BATCH_LANES; ++l) {
+      sign[l] = pivot[l] < 0.0 ? -1.0 : 1.0;
+      pivot[l] = sqrt(fabs(pivot[l]));
+      failed[l] |= pivot[l] < BATCH_EPS;
+    }
+    ai[i] = pivot;
+    d[i] = sign;
+    s = 1.0 / (pivot * sign);
+    for (j = i + 1; j < n; ++j) {
+      ai[j] *= s;
+      a[j * n + i] = ai[j];
+    }
+  }
+}
+
+// Solves R^T * Z = B with the rows of R^T in the lower triangle, and then
+// R * X = D * Z, in place for one group.
+static inline __attribute__((always_inline)) void batch_solve_group(int n, double* factors,
+                                                                    double* diagonal,
+                                                                    double* rhs) {
+  batch_vector* a = (batch_vector*)factors;
+  batch_vector* d = (batch_vector*)diagonal;
+  batch_vector* x = (batch_vector*)rhs;
+  batch_vector sum;
+  int i, j, k;
+
+  for (i = 0; i < n; ++i) {
+    sum = x[i];
+    for (k = 0; k < i; ++k) {
+      sum -= a[i * n + k] * x[k];
+    }
+    x[i] = sum / a[i * n + i];
+  }
+
+  for (i = n - 1; i >= 0; --i) {
+    sum = x[i] * d[i];
+    for (j = i + 1; j < n; ++j) {
+      sum -= a[i * n + j] * x[j];
+    }
+    x[i] = sum / a[i * n + i];
+  }
+}
+
+// Runs the operation on groups [first, last).
+// Returns: the number of systems that cannot be factored.
+static inline __attribute__((always_inline)) int batch_groups(cholesky_batch_t* batch, int n,
+                                                              int first, int last) {
+  int failed[BATCH_LANES];
+  double* a;
+  int g, l, b, result = 0;
+
+  for (g = first; g < last; ++g) {
+    a = batch->matrices + (size_t)g * n * n * BATCH_LANES;
+    if (batch->operation == BATCH_SOLVE) {
+      batch_solve_group(n, a, batch->diagonal + (size_t)g * n * BATCH_LANES,
+                        batch->rhs + (size_t)g * n * BATCH_LANES);
+      continue;
+    }
+    batch_factor_group(n, a, batch->diagonal + (size_t)g * n * BATCH_LANES, failed);
+    // Padding lanes of the last group are not reported.
+    for (l = 0; l < BATCH_LANES && (b = g * BATCH_LANES + l) < batch->count; ++l) {
+      result += failed[l];
+      if (batch->status) {
+        batch->status[b] = failed[l] ? -1 : 0;
+      }
+    }
+  }
+  return result;
+}
+
+// Dispatches to a copy of the kernels with a constant size.
+static inline __attribute__((always_inline)) int batch_sizes(cholesky_batch_t* batch, int first,
+                                                             int last) {
+  switch (batch->matrix_size) {
+    case 8:
+      return batch_groups(batch, 8, first, last);
+    case 16:
+      return batch_groups(batch, 16, first, last);
+    case 24:
+      return batch_groups(batch, 24, first, last);
+    case 32:
+      return batch_groups(batch, 32, first, last);
+    case 48:
+      return batch_groups(batch, 48, first, last);
+    case 64:
+      return batch_groups(batch, 64, first, last);
+    default:
+      return batch_groups(batch, batch->matrix_size, first, last);
+  }
+}
+
+static int batch_run_scalar(cholesky_batch_t* batch, int first, int last) {
+  return batch_sizes(batch, first, last);
+}
+
+#ifdef CHOLESKY_X86_KERNELS
+__attribute__((target("avx2,fma"))) static int batch_run_avx2(cholesky_batch_t* batch, int first,
+                                                              int last) {
+  return batch_sizes(batch, first, last);
+}
+
+__attribute__((target("avx512f,fma"))) static int batch_run_avx512(cholesky_batch_t* batch,
+                                                                   int first, int last) {
+  return batch_sizes(batch, first, last);
+}
+#endif
+
+// Runs the operation on groups [first, last) with the instruction set of the
+// block kernels.
+static int batch_run(cholesky_batch_t* batch, int first, int last) {
+#ifdef CHOLESKY_X86_KERNELS
+  KernelIsa isa = kernel_isa();
+
+  if (isa == KERNEL_ISA_AVX512) {
+    return batch_run_avx512(batch, first, last);
+  }
+  if (isa == KERNEL_ISA_AVX2) {
+    return batch_run_avx2(batch, first, last);
+  }
+#endif
+  return batch_run_scalar(batch, first, last);
+}
+
+// Entry point for each worker thread: an equal share of the groups.
+static void* cholesky_batch_threaded(void* ptr) {
+  BatchArgs* pa = (BatchArgs*)ptr;
+  cholesky_batch_t* batch = pa->batch;
+  int first = (int)((long)batch->groups * pa->thread_id / batch->total_threads);
+  int last = (int)((long)batch->groups * (pa->thread_id + 1) / batch->total_threads);
+
+  pa->failed = batch_run(batch, first, last);
+  return NULL;
+}
+
+// Runs the operation prepared in the handle on all groups.
+// Returns: the number of systems that cannot be factored.
+static int batch_execute(cholesky_batch_t* batch) {
+  int i, failed = 0;
+
+  if (batch->groups < BATCH_MIN_PARALLEL_GROUPS || batch->total_threads == 1) {
+    return batch_run(batch, 0, batch->groups);
+  }
+  thread_pool_run(&batch->pool, cholesky_batch_threaded, batch->args, sizeof(BatchArgs));
+  for (i = 0; i < batch->total_threads; ++i) {
+    failed += batch->args[i].failed;
+  }
+  return failed;
+}
+
+cholesky_batch_t* cholesky_batch_create(int total_threads) {
+  cholesky_batch_t* batch;
+  int i;
+
+  if (total_threads <= 0) {
+    return NULL;
+  }
+  if (!(batch = (cholesky_batch_t*)calloc(1, sizeof(cholesky_batch_t)))) {
+    return NULL;
+  }
+  batch->total_threads = total_threads;
+  if (!(batch->args = (BatchArgs*)calloc(total_threads, sizeof(BatchArgs)))) {
+    cholesky_batch_destroy(batch);
+    return NULL;
+  }
+  if (thread_pool_init(&batch->pool, total_threads, 0)) {
+    // The pool cleans up after itself on failure.
+    batch->pool.total_threads = 0;
+    cholesky_batch_destroy(batch);
+    return NULL;
+  }
+  for (i = 0; i < total_threads; ++i) {
+    batch->args[i].batch = batch;
+    batch->args[i].thread_id = i;
+  }
+  return batch;
+}
+
+size_t cholesky_batch_matrix_length(int n, int count) {
+  return cholesky_batch_vector_length(n, count) * n;
+}
+
+size_t cholesky_batch_vector_length(int n, int count) {
+  return (size_t)(count + BATCH_LANES - 1) / BATCH_LANES * n * BATCH_LANES;
+}
+
+size_t cholesky_batch_matrix_index(int n, int b, int i, int j) {
+  return (((size_t)(b / BATCH_LANES) * n + i) * n + j) * BATCH_LANES + b % BATCH_LANES;
+}
+
+size_t cholesky_batch_vector_index(int n, int b, int i) {
+  return ((size_t)(b / BATCH_LANES) * n + i) * BATCH_LANES + b % BATCH_LANES;
+}
+
+int cholesky_batch_factor(cholesky_batch_t* batch, int n, int count, double* matrices,
+                          double* diagonal, int* status) {
+  if (n <= 0 || count < 0) {
+    return -1;
+  }
+  batch->operation = BATCH_FACTOR;
+  batch->matrix_size = n;
+  batch->count = count;
+  batch->groups = (count + BATCH_LANES - 1) / BATCH_LANES;
+  batch->matrices = matrices;
+  batch->diagonal = diagonal;
+  batch->status = status;
+  return batch_execute(batch);
+}
+
+int cholesky_batch_solve(cholesky_batch_t* batch, int n, int count, double* factors,
+                         double* diagonal, double* rhs) {
+  if (n <= 0 || count < 0) {
+    return -1;
+  }
+  batch->operation = BATCH_SOLVE;
+  batch->matrix_size = n;
+  batch->count = count;
+  batch->groups = (count + BATCH_LANES - 1) / BATCH_LANES;
+  batch->matrices = factors;
+  batch->diagonal = diagonal;
+  batch->rhs = rhs;
+  batch_execute(batch);
+  return 0;
+}
+
+void cholesky_batch_destroy(cholesky_batch_t* batch) {
+  if (!batch) {
+    return;
+  }
+  if (batch->pool.total_threads) {
+    thread_pool_destroy(&batch->pool);
+  }
+  free(batch->args);
+  free(batch);
+}
@@ -0,0 +1,68 @@
+#ifndef CHOLESKY_BATCH_H
+#define CHOLESKY_BATCH_H
+
+#include <stddef.h>
+
+// Factorization A = R^T * D * R and solve of many small independent systems
+// of the same size.
+//
+// The systems are interleaved in groups of BATCH_LANES: element (i, j) of
+// matrix b is stored at
+//   ((b / BATCH_LANES) * n * n + i * n + j) * BATCH_LANES + b % BATCH_LANES,
+// and element i of a vector at ((b / BATCH_LANES) * n + i) * BATCH_LANES +
+// b % BATCH_LANES. Every step of the kernels is then one vector operation over
+// the systems of a group, whatever n is. Only the upper triangle of the
+// matrices is read; the factorization leaves R there and R^T in the strict
+// lower triangle. The last group is padded to BATCH_LANES systems; the
+// padding is factored along with it and its results are ignored.
+//
+// The groups are split among the threads of the pool, and the kernels are
+// compiled for the common sizes 8, 16, 24, 32, 48 and 64 with the size as a
+// constant, and for the instruction set of the block kernels (see
+// array_op_simd.h). A call costs no allocation and no thread start.
+//
+//   cholesky_batch_t* batch = cholesky_batch_create(threads);
+//   cholesky_batch_factor(batch, n, count, matrices, diagonal, status);
+//   cholesky_batch_solve(batch, n, count, matrices, diagonal, rhs);
+//   cholesky_batch_destroy(batch);
+
+// Systems per group, one AVX-512 vector of doubles.
+#define BATCH_LANES 8
+
+typedef struct _CholeskyBatch cholesky_batch_t;
+
+// Starts the threads.
+// Returns: NULL if the parameters are invalid or the threads cannot start.
+cholesky_batch_t* cholesky_batch_create(int total_threads);
+
+// Number of doubles of count interleaved n x n matrices, including padding.
+size_t cholesky_batch_matrix_length(int n, int count);
+
+// Number of doubles of count interleaved vectors of size n, including padding.
+size_t cholesky_batch_vector_length(int n, int count);
+
+// Position of element (i, j) of matrix b in the interleaved matrices.
+size_t cholesky_batch_matrix_index(int n, int b, int i, int j);
+
+// Position of element i of vector b in the interleaved vectors.
+size_t cholesky_batch_vector_index(int n, int b, int i);
+
+// Factors count matrices in place, see above.
+// diagonal: Output, interleaved diagonal scaling elements.
+// status: Output, 0 or -1 for every system that cannot be factored; may be
+//         NULL.
+// Returns: the number of systems that cannot be factored, -1 if the
+//          parameters are invalid.
+int cholesky_batch_factor(cholesky_batch_t* batch, int n, int count, double* matrices,
+                          double* diagonal, int* status);
+
+// Solves A * x = b in place for interleaved right-hand sides with the factors
+// of cholesky_batch_factor.
+// Returns: 0 on success, -1 if the parameters are invalid.
+int cholesky_batch_solve(cholesky_batch_t* batch, int n, int count, double* factors,
+                         double* diagonal, double* rhs);
+
+// Stops the threads and releases the handle.
+void cholesky_batch_destroy(cholesky_batch_t* batch);
+
+#endif  // CHOLESKY_BATCH_H
@@ -0,0 +1,388 @@
+#include "cholesky_dag.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_op.h"
+#include "tile_matrix.h"
+
+// Progress of a tile is packed into one atomic word so that every event can
+// decide with a single compare-and-swap whether it made a task ready:
+//   bits  0..23  block rows above the tile that are final (panels),
+//   bits 24..47  updates already applied to the tile; row + 1 once final,
+//   bit  48      a task of the tile is queued or running,
+//   bit  49      the diagonal block of the tile's row is factored.
+#define STATE_PANEL ((uint64_t)1)
+#define STATE_UPDATE ((uint64_t)1 << 24)
+#define STATE_COUNTER_MASK ((uint64_t)0xFFFFFF)
+#define STATE_BUSY ((uint64_t)1 << 48)
+#define STATE_DIAGONAL_READY ((uint64_t)1 << 49)
+
+// Idle iterations before a thread starts yielding the CPU.
+const int DAG_IDLE_SPINS = 64;
+
+// Initial capacity of every deque, a power of two. A deque grows when a
+// thread releases more tasks at once, e.g. all tiles below a finished row.
+const long DAG_QUEUE_CAPACITY = 64;
+
+static int state_panels(uint64_t state) {
+  return (int)(state & STATE_COUNTER_MASK);
+}
+
+static int state_updates(uint64_t state) {
+  return (int)((state >> 24) & STATE_COUNTER_MASK);
+}
+
+// Returns: a ring of the given capacity, NULL if there is not enough memory.
+static TaskRing* ring_alloc(long capacity) {
+  TaskRing* ring = (TaskRing*)malloc(sizeof(TaskRing) + capacity * sizeof(atomic_int));
+
+  if (ring) {
+    ring->mask = capacity - 1;
+    ring->prev = NULL;
+  }
+  return ring;
+}
+
+// Frees the rings replaced by the current one of a deque.
+static void ring_release_previous(TaskRing* ring) {
+  TaskRing* prev;
+
+  for (ring = ring->prev; ring; ring = prev) {
+    prev = ring->prev;
+    free(ring);
+  }
+}
+
+// Replaces a full ring with one of twice the size that holds the same tasks.
+// Returns: the new ring, NULL if there is not enough memory.
+static TaskRing* deque_grow(TaskDeque* q, TaskRing* ring, long t, long b) {
+  TaskRing* grown = ring_alloc(2 * (ring->mask + 1));
+
+  if (!grown) {
+    return NULL;
+  }
+  for (; t < b; ++t) {
+    atomic_store_explicit(&grown->tasks[t & grown->mask],
+                          atomic_load_explicit(&ring->tasks[t & ring->mask], memory_order_relaxed),
+                          memory_order_relaxed);
+  }
+  grown->prev = ring;
+  atomic_store_explicit(&q->ring, grown, memory_order_release);
+  return grown;
+}
+
+// Pushes a task; only the owning thread may call it.
+// Returns: 0 on success, -1 if the deque is full and cannot grow.
+static int deque_push(TaskDeque* q, int task) {
+  long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&q->top, memory_order_acquire);
+  TaskRing* ring = atomic_load_explicit(&q->ring, memory_order_relaxed);
+
+  if (b - t > ring->mask && !(ring = deque_grow(q, ring, t, b))) {
+    return -1;
+  }
+  atomic_store_explicit(&ring->tasks[b & ring->mask], task, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+  return 0;
+}
+
+// Pops the most recently pushed task; only the owning thread may call it.
+// Returns: The task, or -1 if the deque is empty.
+static int deque_pop(TaskDeque* q) {
+  long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+  TaskRing* ring = atomic_load_explicit(&q->ring, memory_order_relaxed);
+  long t;
+  int task = -1;
+
+  atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  t = atomic_load_explicit(&q->top, memory_order_relaxed);
+
+  if (t <= b) {
+    task = atomic_load_explicit(&ring->tasks[b & ring->mask], memory_order_relaxed);
+    if (t == b) {
+      // Last task: race against thieves for it.
+      if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst,
+                                                   memory_order_relaxed)) {
+        task = -1;
+      }
+      atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+  } else {
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+  }
+  return task;
+}
+
+// Steals the oldest task; may be called by any thread.
+// Returns: The task, or -1 if the deque is empty or the steal lost a race.
+static int deque_steal(TaskDeque* q) {
+  long t = atomic_load_explicit(&q->top, memory_order_acquire);
+  long b;
+  TaskRing* ring;
+  int task;
+
+  atomic_thread_fence(memory_order_seq_cst);
+  b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+  if (t >= b) {
+    return -1;
+  }
+
+  // An older ring still holds task t, since only the owner writes rings.
+  ring = atomic_load_explicit(&q->ring, memory_order_acquire);
+  task = atomic_load_explicit(&ring->tasks[t & ring->mask], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return -1;
+  }
+  return task;
+}
+
+// Index of tile (bi, bj) in block-row order, as used by tile_block().
+static int tile_index(CholeskyDag* dag, int bi, int bj) {
+  return ((bi * ((dag->tiles_per_row << 1) - bi + 1)) >> 1) + bj - bi;
+}
+
+// Returns non-zero if an idle tile in the given state has a task to run.
+static int tile_has_task(CholeskyDag* dag, int t, uint64_t state) {
+  int row = dag->tile_row[t];
+  int updates = state_updates(state);
+
+  if (updates < row) {
+    return state_panels(state) > updates;
+  }
+  if (updates == row) {
+    return dag->tile_row[t] == dag->tile_column[t] || (state & STATE_DIAGONAL_READY);
+  }
+  return 0;
+}
+
+// Applies an event to a tile and queues its next task if the event made it
+// ready. Diagonal factorizations, panel scalings and the last update before
+// them form the critical path and go to the high priority deque.
+static void tile_event(CholeskyDag* dag, int thread_id, int t, uint64_t add, uint64_t clear) {
+  uint64_t state = atomic_load(&dag->state[t]);
+  uint64_t next;
+  int queue, claimed;
+
+  do {
+    next = (state + add) & ~clear;
+    claimed = !(next & STATE_BUSY) && tile_has_task(dag, t, next);
+    if (claimed) {
+      next |= STATE_BUSY;
+    }
+  } while (!atomic_compare_exchange_weak(&dag->state[t], &state, next));
+
+  if (claimed) {
+    queue = (state_updates(next) + 1 >= dag->tile_row[t] ? 0 : 1);
+    if (deque_push(&dag->queues[2 * thread_id + queue], t)) {
+      printf("Not enough memory for the task queues\n");
+      atomic_store(&dag->error, 1);
+    }
+  }
+}
+
+// Marks one more tile of a block row as final. The last one releases the
+// updates of every tile below the row.
+static void row_finished(CholeskyDag* dag, int thread_id, int row) {
+  int t;
+
+  if (atomic_fetch_sub(&dag->row_pending[row], 1) != 1) {
+    return;
+  }
+  for (t = tile_index(dag, row, row) + dag->tiles_per_row - row; t < dag->tile_total; ++t) {
+    tile_event(dag, thread_id, t, STATE_PANEL, 0);
+  }
+}
+
+// Executes the next task of tile t.
+static void run_task(CholeskyDag* dag, int thread_id, int t) {
+  int matrix_size = dag->matrix_size;
+  int block_size = dag->block_size;
+  int row = dag->tile_row[t];
+  int column = dag->tile_column[t];
+  int k = state_updates(atomic_load(&dag->state[t]));
+  int i = row * block_size;
+  int j = column * block_size;
+  int pk_n, pij_n, pij_m, c;
+  double* block = tile_block(dag->matrix, i, j, matrix_size, block_size);
+
+  pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+  pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+  trace_begin(dag->trace, thread_id);
+
+  if (k < row) {
+    // GEMM/SYRK: apply the update from block row k.
+    k *= block_size;
+    pk_n = (k + block_size < matrix_size ? block_size : matrix_size - k);
+    main_blocks_diagonal_multiply(pk_n, pij_n, pij_m,
+                                  tile_block(dag->matrix, k, i, matrix_size, block_size),
+                                  tile_block(dag->matrix, k, j, matrix_size, block_size),
+                                  dag->diagonal + k, block);
+    trace_end(dag->trace, thread_id, TRACE_UPDATE, k / block_size, 2.0 * pk_n * pij_n * pij_m);
+    tile_event(dag, thread_id, t, STATE_UPDATE, STATE_BUSY);
+  } else if (row == column) {
+    // POTRF: factor the diagonal block.
+    if (cholesky_for_block(pij_n, block, dag->diagonal + i)) {
+      printf("Cholesky method with this block size cannot be applied\n");
+      atomic_store(&dag->error, 1);
+      return;
+    }
+    trace_end(dag->trace, thread_id, TRACE_FACTOR, row, 1.0 / 3.0 * pij_n * pij_n * pij_n);
+    tile_event(dag, thread_id, t, STATE_UPDATE, STATE_BUSY);
+    for (c = row + 1; c < dag->tiles_per_row; ++c) {
+      tile_event(dag, thread_id, t + c - row, STATE_DIAGONAL_READY, 0);
+    }
+    row_finished(dag, thread_id, row);
+  } else {
+    // TRSM: solve the block against the factored diagonal block.
+    lower_triangle_block_diagonal_solve(pij_n, pij_m,
+                                        tile_block(dag->matrix, i, i, matrix_size, block_size),
+                                        dag->diagonal + i, block);
+    trace_end(dag->trace, thread_id, TRACE_SCALE, row, 1.0 * pij_n * pij_n * pij_m);
+    tile_event(dag, thread_id, t, STATE_UPDATE, STATE_BUSY);
+    row_finished(dag, thread_id, row);
+  }
+
+  atomic_fetch_sub(&dag->tasks_left, 1);
+}
+
+// Takes a task from the thread's own deques, stealing when they are empty.
+// Critical path tasks are preferred over updates, also when stealing.
+static int take_task(CholeskyDag* dag, int thread_id) {
+  int queue, v, t;
+
+  for (queue = 0; queue < 2; ++queue) {
+    if ((t = deque_pop(&dag->queues[2 * thread_id + queue])) >= 0) {
+      return t;
+    }
+    for (v = 1; v < dag->total_threads; ++v) {
+      t = deque_steal(&dag->queues[2 * ((thread_id + v) % dag->total_threads) + queue]);
+      if (t >= 0) {
+        return t;
+      }
+    }
+  }
+  return -1;
+}
+
+int cholesky_dag_init(CholeskyDag* dag, int matrix_size, int block_size, int total_threads) {
+  int bi, bj, t, q;
+
+  memset(dag, 0, sizeof(CholeskyDag));
+  dag->matrix_size = matrix_size;
+  dag->block_size = block_size;
+  dag->tiles_per_row = tile_count(matrix_size, block_size);
+  dag->tile_total = (dag->tiles_per_row * (dag->tiles_per_row + 1)) / 2;
+  dag->total_threads = total_threads;
+
+  dag->tile_row = (int*)malloc(dag->tile_total * sizeof(int));
+  dag->tile_column = (int*)malloc(dag->tile_total * sizeof(int));
+  dag->state = (_Atomic uint64_t*)malloc(dag->tile_total * sizeof(uint64_t));
+  dag->row_pending = (atomic_int*)malloc(dag->tiles_per_row * sizeof(atomic_int));
+  dag->queues = (TaskDeque*)calloc(2 * total_threads, sizeof(TaskDeque));
+  if (!dag->tile_row || !dag->tile_column || !dag->state || !dag->row_pending || !dag->queues) {
+    cholesky_dag_destroy(dag);
+    return -1;
+  }
+
+  for (q = 0; q < 2 * total_threads; ++q) {
+    atomic_init(&dag->queues[q].ring, ring_alloc(DAG_QUEUE_CAPACITY));
+    if (!atomic_load(&dag->queues[q].ring)) {
+      cholesky_dag_destroy(dag);
+      return -1;
+    }
+  }
+
+  t = 0;
+  for (bi = 0; bi < dag->tiles_per_row; ++bi) {
+    for (bj = bi; bj < dag->tiles_per_row; ++bj) {
+      dag->tile_row[t] = bi;
+      dag->tile_column[t] = bj;
+      ++t;
+    }
+  }
+  return 0;
+}
+
+void cholesky_dag_reset(CholeskyDag* dag, double* matrix, double* diagonal, Trace* trace) {
+  int bi, t, q;
+  long tasks = 0;
+
+  dag->matrix = matrix;
+  dag->diagonal = diagonal;
+  dag->trace = trace;
+
+  for (t = 0; t < dag->tile_total; ++t) {
+    atomic_init(&dag->state[t], 0);
+    // Every tile receives one update per block row above it and is then
+    // finalized by a POTRF or TRSM task.
+    tasks += dag->tile_row[t] + 1;
+  }
+  for (bi = 0; bi < dag->tiles_per_row; ++bi) {
+    atomic_init(&dag->row_pending[bi], dag->tiles_per_row - bi);
+  }
+  for (q = 0; q < 2 * dag->total_threads; ++q) {
+    atomic_init(&dag->queues[q].top, 0);
+    atomic_init(&dag->queues[q].bottom, 0);
+    ring_release_previous(atomic_load(&dag->queues[q].ring));
+    atomic_load(&dag->queues[q].ring)->prev = NULL;
+  }
+  atomic_init(&dag->tasks_left, tasks);
+  atomic_init(&dag->error, 0);
+
+  // The first diagonal block has no dependencies.
+  atomic_init(&dag->state[0], STATE_BUSY);
+  deque_push(&dag->queues[0], 0);
+}
+
+void cholesky_dag_destroy(CholeskyDag* dag) {
+  TaskRing* ring;
+  int q;
+
+  if (dag->queues) {
+    for (q = 0; q < 2 * dag->total_threads; ++q) {
+      if ((ring = atomic_load(&dag->queues[q].ring))) {
+        ring_release_previous(ring);
+        free(ring);
+      }
+    }
+  }
+  free(dag->queues);
+  free(dag->row_pending);
+  free((void*)dag->state);
+  free(dag->tile_column);
+  free(dag->tile_row);
+  memset(dag, 0, sizeof(CholeskyDag));
+}
+
+int cholesky_dag(CholeskyDag* dag, int thread_id) {
+  int t, idle = 0;
+
+  while (atomic_load(&dag->tasks_left) > 0 && !atomic_load(&dag->error)) {
+    if ((t = take_task(dag, thread_id)) < 0) {
+      // A stretch without ready tasks is recorded as one wait.
+      if (!idle) {
+        trace_begin(dag->trace, thread_id);
+      }
+      if (++idle > DAG_IDLE_SPINS) {
+        sched_yield();
+      }
+      continue;
+    }
+    if (idle) {
+      trace_end(dag->trace, thread_id, TRACE_WAIT, -1, 0);
+    }
+    idle = 0;
+    run_task(dag, thread_id, t);
+  }
+  if (idle) {
+    trace_end(dag->trace, thread_id, TRACE_WAIT, -1, 0);
+  }
+
+  return atomic_load(&dag->error) ? -1 : 0;
+}
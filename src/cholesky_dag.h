@@ -0,0 +1,71 @@
+#ifndef CHOLESKY_DAG_H
+#define CHOLESKY_DAG_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+// Dependency-driven tile Cholesky decomposition.
+//
+// Instead of two barriers per block step, every tile of the tile-major matrix
+// advances through its own sequence of tasks: one update (GEMM/SYRK) per
+// earlier block row, then either the diagonal factorization (POTRF) or the
+// triangular solve against the factored diagonal block (TRSM). A task is queued as soon as
+// its inputs are final, so the next panel is factored while the trailing
+// updates of the previous one are still running (lookahead). Ready tasks live
+// in per-thread lock-free deques; idle threads steal from the others.
+
+// Ring buffer of a deque. A full ring is replaced by one of twice the size;
+// thieves may still read the old one, so it is kept until the next reset.
+typedef struct _TaskRing {
+  long mask;               // Capacity - 1, capacity is a power of two.
+  struct _TaskRing* prev;  // Ring this one replaced, or NULL.
+  atomic_int tasks[];      // Tile indices.
+} TaskRing;
+
+// Single-owner, multi-thief work-stealing deque of tile indices (Chase-Lev).
+typedef struct _TaskDeque {
+  atomic_long top;          // Next index to steal from.
+  char pad[56];             // Keeps thieves and the owner on separate cache lines.
+  atomic_long bottom;       // Next index to push to.
+  _Atomic(TaskRing*) ring;  // Current ring buffer.
+} TaskDeque;
+
+// Shared state of one decomposition, used by all worker threads.
+typedef struct _CholeskyDag {
+  int matrix_size;          // Total size of the matrix (N x N).
+  int block_size;           // Size of the tiles (M x M).
+  int tiles_per_row;        // Number of tiles along one dimension.
+  int tile_total;           // Number of tiles in the upper block triangle.
+  int total_threads;        // Number of worker threads.
+  double* matrix;           // Tile-major matrix, factored in place.
+  double* diagonal;         // Diagonal scaling elements.
+  int* tile_row;            // Block row of every tile.
+  int* tile_column;         // Block column of every tile.
+  _Atomic uint64_t* state;  // Per-tile progress, see cholesky_dag.c.
+  atomic_int* row_pending;  // Tiles of each block row not yet final.
+  atomic_long tasks_left;   // Tasks not yet executed.
+  atomic_int error;         // Non-zero once a diagonal block failed.
+  TaskDeque* queues;        // Two deques per thread: critical path, updates.
+  Trace* trace;             // Timeline of the tasks and idle times, or NULL.
+} CholeskyDag;
+
+// Allocates the scheduler state for a matrix of the given size.
+// Returns: 0 on success, -1 if there is not enough memory.
+int cholesky_dag_init(CholeskyDag* dag, int matrix_size, int block_size, int total_threads);
+
+// Prepares a new decomposition of the tile-major matrix. Must be called by a
+// single thread before the workers enter cholesky_dag().
+// trace: Timeline to record the tasks in, or NULL.
+void cholesky_dag_reset(CholeskyDag* dag, double* matrix, double* diagonal, Trace* trace);
+
+// Releases the scheduler state.
+void cholesky_dag_destroy(CholeskyDag* dag);
+
+// Worker loop: executes and steals tasks until the decomposition is done.
+// Every thread of the team calls it with its own thread_id.
+// Returns: 0 on success, -1 if the method cannot be applied.
+int cholesky_dag(CholeskyDag* dag, int thread_id);
+
+#endif  // CHOLESKY_DAG_H
@@ -0,0 +1,591 @@
+#include "cholesky_factor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "affinity.h"
+#include "cholesky_mixed.h"
+#include "cholesky_recursive.h"
+#include "solve_threaded.h"
+#include "thread_pool.h"
+#include "tile_matrix.h"
+#include "timer.h"
+#include "update_threaded.h"
+
+// Per-thread arguments of the conversion of the input to the tile layout.
+typedef struct _CholeskyLoadArgs {
+  cholesky_factor_t* factor;  // Handle being loaded.
+  int thread_id;              // Unique ID for the current thread.
+} CholeskyLoadArgs;
+
+struct _CholeskyFactor {
+  int matrix_size;                // Total size of the matrix (N x N).
+  int block_size;                 // Size of the tiles (M x M).
+  int total_threads;              // Number of threads in the pool.
+  CholeskyOptions options;        // Options the handle was created with.
+  Distribution distribution;      // Tile mapping for the barrier engine.
+  CholeskyDag dag;                // Scheduler state for the dag engine.
+  double* tiles;                  // Tile-major factor.
+  double* diagonal;               // Diagonal scaling elements.
+  float* tiles_float;             // Single precision factor for mixed_precision.
+  float* diagonal_float;          // Diagonal scaling elements of tiles_float.
+  double* source;                 // Input matrix of the current factorization.
+  int source_tiles;               // Non-zero if source is already tile-major.
+  const Skyline* skyline;         // Skyline input of the current factorization, or NULL.
+  TileProfile* profile;           // Tile layout of skyline matrices, NULL if dense.
+  double* packed;                 // Input matrix the mixed precision solves refine against.
+  CholeskyLoadArgs* load_args;    // Per-thread arguments of the input conversion.
+  CholeskyArgs* cholesky_args;    // Per-thread arguments of the decomposition.
+  MixedArgs* mixed_args;          // Per-thread arguments of the mixed precision decomposition.
+  SolveArgs* solve_args;          // Per-thread arguments of the solve.
+  UpdateArgs* update_args;        // Per-thread arguments of the low-rank update.
+  double* update_work;            // Vectors, weights and maps of the low-rank update.
+  size_t update_length;           // Doubles allocated in update_work.
+  ThreadPool pool;                // Persistent worker threads.
+  int error;                      // Error flag of the last decomposition.
+  int solve_error;                // Error flag of the last solve.
+  int iterations;                 // Refinement steps of the last mixed precision solve.
+  int factored;                   // Non-zero once tiles hold a valid factor.
+  int* cpus;                      // CPU of every thread, or NULL if they are not pinned.
+  AffinityMask* caller_mask;      // CPU mask of the calling thread before pinning.
+  Trace trace;                    // Timeline of the last factorization with options.trace.
+  CholeskyCheckpoint checkpoint;  // Checkpoint state of the barrier engine.
+  MatrixFile mapped;              // Factor mapped by cholesky_factor_map, if any.
+};
+
+void cholesky_options_default(CholeskyOptions* options) {
+  options->engine = CHOLESKY_ENGINE_DAG;
+  options->distribution = DISTRIBUTION_COLUMN;
+  options->grid_rows = 0;
+  options->keep_hot = 0;
+  options->quiet = 0;
+  options->mixed_precision = 0;
+  options->affinity = NULL;
+  options->trace = 0;
+  options->skyline = NULL;
+  options->checkpoint = NULL;
+  options->checkpoint_interval = 600;
+}
+
+// Pins a thread of the pool and zeroes the tiles it owns, which places their
+// pages on its NUMA node.
+static void* cholesky_factor_place(void* ptr) {
+  CholeskyLoadArgs* pa = (CholeskyLoadArgs*)ptr;
+  cholesky_factor_t* factor = pa->factor;
+  int nb = tile_count(factor->matrix_size, factor->block_size);
+  size_t tile_size = (size_t)factor->block_size * factor->block_size *
+                     (factor->options.mixed_precision ? sizeof(float) : sizeof(double));
+  char* tile = factor->options.mixed_precision ? (char*)factor->tiles_float
+                                               : (char*)factor->tiles;
+  int bi, bj, last;
+
+  if (factor->cpus && affinity_pin(factor->cpus[pa->thread_id])) {
+    printf("Cannot pin thread %d to CPU %d\n", pa->thread_id, factor->cpus[pa->thread_id]);
+  }
+
+  for (bi = 0; bi < nb; ++bi) {
+    last = factor->profile ? factor->profile->last_block[bi] : nb - 1;
+    for (bj = bi; bj <= last; ++bj, tile += tile_size) {
+      if (tile_owner(&factor->distribution, bi, bj) == pa->thread_id) {
+        memset(tile, 0, tile_size);
+      }
+    }
+  }
+  return 0;
+}
+
+cholesky_factor_t* cholesky_factor_create(int matrix_size, int block_size, int total_threads,
+                                          const CholeskyOptions* options) {
+  cholesky_factor_t* factor;
+  int i, mixed;
+  Trace* trace;
+
+  if (matrix_size <= 0 || block_size <= 0 || total_threads <= 0 || block_size > matrix_size) {
+    return NULL;
+  }
+  if (!(factor = (cholesky_factor_t*)calloc(1, sizeof(cholesky_factor_t)))) {
+    return NULL;
+  }
+
+  factor->matrix_size = matrix_size;
+  factor->block_size = block_size;
+  factor->total_threads = total_threads;
+  if (options) {
+    factor->options = *options;
+  } else {
+    cholesky_options_default(&factor->options);
+  }
+  mixed = factor->options.mixed_precision;
+
+  // Checkpoints are taken between the block steps of the barrier engine, on
+  // the dense tile layout.
+  if (factor->options.checkpoint &&
+      (mixed || factor->options.engine != CHOLESKY_ENGINE_BARRIER || factor->options.skyline)) {
+    free(factor);
+    return NULL;
+  }
+  factor->checkpoint.file_name = factor->options.checkpoint;
+  factor->checkpoint.interval = factor->options.checkpoint_interval;
+
+  // Skyline storage is only known to the barrier engine. The handle keeps the
+  // profile, not the skyline it was derived from.
+  if (factor->options.skyline) {
+    if (mixed || factor->options.engine != CHOLESKY_ENGINE_BARRIER ||
+        factor->options.skyline->matrix_size != matrix_size ||
+        !(factor->profile = (TileProfile*)malloc(sizeof(TileProfile))) ||
+        tile_profile_init(factor->profile, factor->options.skyline, block_size)) {
+      free(factor->profile);
+      free(factor);
+      return NULL;
+    }
+    factor->options.skyline = NULL;
+  }
+
+  // The recursive engine stores the matrix in its own small tiles and needs
+  // an owner for every tile.
+  if (!mixed && factor->options.engine == CHOLESKY_ENGINE_RECURSIVE) {
+    block_size = factor->block_size = cholesky_recursive_leaf_size(matrix_size);
+    if (factor->options.distribution == DISTRIBUTION_COLUMN) {
+      factor->options.distribution = DISTRIBUTION_2D_CYCLIC;
+    }
+  }
+
+  if (distribution_init(&factor->distribution, factor->options.distribution,
+                        factor->options.grid_rows, total_threads, matrix_size, block_size)) {
+    cholesky_factor_destroy(factor);
+    return NULL;
+  }
+
+  // Only the factor of the selected precision is allocated.
+  factor->diagonal = (double*)calloc(matrix_size, sizeof(double));
+  factor->load_args = (CholeskyLoadArgs*)malloc(total_threads * sizeof(CholeskyLoadArgs));
+  if (mixed) {
+    factor->tiles_float = (float*)tile_matrix_reserve(tile_matrix_length(matrix_size, block_size) *
+                                                      sizeof(float));
+    factor->diagonal_float = (float*)calloc(matrix_size, sizeof(float));
+    factor->mixed_args = (MixedArgs*)malloc(total_threads * sizeof(MixedArgs));
+  } else {
+    factor->tiles = (double*)tile_matrix_reserve(
+        (factor->profile ? tile_profile_length(factor->profile)
+                         : tile_matrix_length(matrix_size, block_size)) *
+        sizeof(double));
+    factor->cholesky_args = (CholeskyArgs*)malloc(total_threads * sizeof(CholeskyArgs));
+    factor->solve_args = (SolveArgs*)malloc(total_threads * sizeof(SolveArgs));
+    factor->update_args = (UpdateArgs*)malloc(total_threads * sizeof(UpdateArgs));
+  }
+  if (!factor->diagonal || !factor->load_args ||
+      (mixed ? !factor->tiles_float || !factor->diagonal_float || !factor->mixed_args
+             : !factor->tiles || !factor->cholesky_args || !factor->solve_args ||
+                   !factor->update_args) ||
+      (!mixed && factor->options.engine == CHOLESKY_ENGINE_DAG &&
+       cholesky_dag_init(&factor->dag, matrix_size, block_size, total_threads))) {
+    cholesky_factor_destroy(factor);
+    return NULL;
+  }
+
+  if (factor->options.affinity) {
+    if (!(factor->cpus = (int*)malloc(total_threads * sizeof(int))) ||
+        affinity_map(factor->options.affinity, total_threads, factor->cpus)) {
+      printf("Wrong affinity map %s\n", factor->options.affinity);
+      cholesky_factor_destroy(factor);
+      return NULL;
+    }
+    factor->caller_mask = affinity_save();
+  }
+
+  if (factor->options.trace &&
+      trace_init(&factor->trace, total_threads, factor->options.trace > 1)) {
+    cholesky_factor_destroy(factor);
+    return NULL;
+  }
+
+  if (thread_pool_init(&factor->pool, total_threads, factor->options.keep_hot)) {
+    // The pool cleans up after itself on failure.
+    factor->pool.total_threads = 0;
+    cholesky_factor_destroy(factor);
+    return NULL;
+  }
+
+  trace = factor->options.trace ? &factor->trace : NULL;
+  for (i = 0; i < total_threads; ++i) {
+    factor->load_args[i].factor = factor;
+    factor->load_args[i].thread_id = i;
+
+    if (mixed) {
+      factor->mixed_args[i].matrix_size = matrix_size;
+      factor->mixed_args[i].matrix = factor->tiles_float;
+      factor->mixed_args[i].diagonal = factor->diagonal_float;
+      factor->mixed_args[i].block_size = block_size;
+      factor->mixed_args[i].thread_id = i;
+      factor->mixed_args[i].barrier = &factor->pool.barrier;
+      factor->mixed_args[i].error = &factor->error;
+      factor->mixed_args[i].distribution = &factor->distribution;
+      factor->mixed_args[i].quiet = factor->options.quiet;
+      factor->mixed_args[i].trace = trace;
+      factor->mixed_args[i].cpu_time = 0;
+      continue;
+    }
+
+    factor->cholesky_args[i].matrix_size = matrix_size;
+    factor->cholesky_args[i].matrix = factor->tiles;
+    factor->cholesky_args[i].diagonal = factor->diagonal;
+    factor->cholesky_args[i].block_size = block_size;
+    factor->cholesky_args[i].thread_id = i;
+    factor->cholesky_args[i].total_threads = total_threads;
+    factor->cholesky_args[i].barrier = &factor->pool.barrier;
+    factor->cholesky_args[i].error = &factor->error;
+    factor->cholesky_args[i].engine = factor->options.engine;
+    factor->cholesky_args[i].dag = &factor->dag;
+    factor->cholesky_args[i].distribution = &factor->distribution;
+    factor->cholesky_args[i].profile = factor->profile;
+    factor->cholesky_args[i].checkpoint = &factor->checkpoint;
+    factor->cholesky_args[i].quiet = factor->options.quiet;
+    factor->cholesky_args[i].trace = trace;
+    factor->cholesky_args[i].cpu_time = 0;
+
+    factor->solve_args[i].matrix_size = matrix_size;
+    factor->solve_args[i].matrix = factor->tiles;
+    factor->solve_args[i].diagonal = factor->diagonal;
+    factor->solve_args[i].profile = factor->profile;
+    factor->solve_args[i].rhs = NULL;
+    factor->solve_args[i].rhs_count = 0;
+    factor->solve_args[i].block_size = block_size;
+    factor->solve_args[i].thread_id = i;
+    factor->solve_args[i].total_threads = total_threads;
+    factor->solve_args[i].barrier = &factor->pool.barrier;
+    factor->solve_args[i].error = &factor->solve_error;
+
+    factor->update_args[i].matrix_size = matrix_size;
+    factor->update_args[i].matrix = factor->tiles;
+    factor->update_args[i].diagonal = factor->diagonal;
+    factor->update_args[i].vectors = NULL;
+    factor->update_args[i].rank = 0;
+    factor->update_args[i].weights = NULL;
+    factor->update_args[i].coefficients = NULL;
+    factor->update_args[i].block_size = block_size;
+    factor->update_args[i].thread_id = i;
+    factor->update_args[i].total_threads = total_threads;
+    factor->update_args[i].barrier = &factor->pool.barrier;
+    factor->update_args[i].error = &factor->solve_error;
+  }
+
+  thread_pool_run(&factor->pool, cholesky_factor_place, factor->load_args,
+                  sizeof(CholeskyLoadArgs));
+  return factor;
+}
+
+// Copies a share of the input into the tile layout of the handle.
+static void* cholesky_factor_load(void* ptr) {
+  CholeskyLoadArgs* pa = (CholeskyLoadArgs*)ptr;
+  cholesky_factor_t* factor = pa->factor;
+  size_t length, begin, end;
+
+  if (factor->skyline) {
+    skyline_to_tile_rows(factor->skyline, factor->profile, factor->tiles, pa->thread_id,
+                         factor->total_threads);
+  } else if (factor->options.mixed_precision) {
+    packed_to_tile_rows_float(factor->matrix_size, factor->block_size, factor->source,
+                              factor->tiles_float, pa->thread_id, factor->total_threads);
+  } else if (factor->source_tiles) {
+    length = tile_matrix_length(factor->matrix_size, factor->block_size);
+    begin = length * pa->thread_id / factor->total_threads;
+    end = length * (pa->thread_id + 1) / factor->total_threads;
+    memcpy(factor->tiles + begin, factor->source + begin, (end - begin) * sizeof(double));
+  } else {
+    packed_to_tile_rows(factor->matrix_size, factor->block_size, factor->source, factor->tiles,
+                        pa->thread_id, factor->total_threads);
+  }
+  return 0;
+}
+
+// Releases a factor mapped by cholesky_factor_map and points the solves back
+// to the factor of the handle.
+static void cholesky_factor_unmap(cholesky_factor_t* factor) {
+  int i;
+
+  if (!factor->mapped.mapping) {
+    return;
+  }
+  matrix_file_unmap(&factor->mapped);
+  for (i = 0; i < factor->total_threads; ++i) {
+    factor->solve_args[i].matrix = factor->tiles;
+    factor->solve_args[i].diagonal = factor->diagonal;
+  }
+}
+
+// Loads the input with all threads of the pool, then factors it.
+static int cholesky_factor_run(cholesky_factor_t* factor, double* source, int source_tiles) {
+  Trace* trace = factor->options.trace ? &factor->trace : NULL;
+  int i;
+
+  cholesky_factor_unmap(factor);
+  factor->factored = 0;
+  factor->error = 0;
+  factor->source = source;
+  factor->source_tiles = source_tiles;
+
+  thread_pool_run(&factor->pool, cholesky_factor_load, factor->load_args,
+                  sizeof(CholeskyLoadArgs));
+  factor->source = NULL;
+  factor->skyline = NULL;
+
+  // The trace covers the decomposition only, not the conversion of the input.
+  trace_reset(trace);
+  if (factor->options.mixed_precision) {
+    thread_pool_run(&factor->pool, cholesky_mixed_threaded, factor->mixed_args,
+                    sizeof(MixedArgs));
+    trace_finish(trace);
+    if (factor->error) {
+      return -1;
+    }
+    for (i = 0; i < factor->matrix_size; ++i) {
+      factor->diagonal[i] = factor->diagonal_float[i];
+    }
+    factor->packed = source;
+    factor->factored = 1;
+    return 0;
+  }
+
+  if (factor->options.engine == CHOLESKY_ENGINE_DAG) {
+    cholesky_dag_reset(&factor->dag, factor->tiles, factor->diagonal, trace);
+  }
+  factor->checkpoint.last = get_time_monotonic();
+
+  thread_pool_run(&factor->pool, cholesky_threaded, factor->cholesky_args, sizeof(CholeskyArgs));
+  trace_finish(trace);
+  if (factor->error) {
+    return -1;
+  }
+
+  // The last checkpoint is of no use once the factorization is complete.
+  if (factor->options.checkpoint) {
+    remove(factor->options.checkpoint);
+  }
+  factor->factored = 1;
+  return 0;
+}
+
+int cholesky_factor_factor(cholesky_factor_t* factor, double* matrix) {
+  if (factor->profile) {
+    return -1;
+  }
+  return cholesky_factor_run(factor, matrix, 0);
+}
+
+int cholesky_factor_factor_tiles(cholesky_factor_t* factor, double* tiles) {
+  if (factor->options.mixed_precision || factor->profile) {
+    return -1;
+  }
+  return cholesky_factor_run(factor, tiles, 1);
+}
+
+int cholesky_factor_factor_skyline(cholesky_factor_t* factor, const Skyline* skyline) {
+  if (!factor->profile || skyline->matrix_size != factor->matrix_size) {
+    return -1;
+  }
+  factor->skyline = skyline;
+  return cholesky_factor_run(factor, NULL, 0);
+}
+
+int cholesky_factor_resume(cholesky_factor_t* factor, const char* file_name) {
+  MatrixFile file;
+  int n = factor->matrix_size;
+  int result;
+
+  if (factor->options.mixed_precision || factor->profile ||
+      factor->options.engine != CHOLESKY_ENGINE_BARRIER || matrix_file_map(&file, file_name, 1)) {
+    return -1;
+  }
+  if (file.header.content != MATRIX_CONTENT_CHECKPOINT || file.header.matrix_size != (uint64_t)n ||
+      file.header.block_size != (uint32_t)factor->block_size ||
+      file.header.schedule != (uint32_t)cholesky_schedule(&factor->distribution) ||
+      file.header.step >= (uint64_t)n || file.header.step % factor->block_size) {
+    printf("Checkpoint %s does not fit the solver\n", file_name);
+    matrix_file_unmap(&file);
+    return -1;
+  }
+
+  // The tiles are loaded like a tile-major input; D of the finished steps
+  // comes along.
+  memcpy(factor->diagonal, file.data + tile_matrix_length(n, factor->block_size),
+         n * sizeof(double));
+  factor->checkpoint.first_step = (int)file.header.step;
+  result = cholesky_factor_run(factor, file.data, 1);
+  factor->checkpoint.first_step = 0;
+  matrix_file_unmap(&file);
+  return result;
+}
+
+int cholesky_factor_save(cholesky_factor_t* factor, const char* file_name) {
+  if (!factor->factored || factor->options.mixed_precision || factor->profile) {
+    return -1;
+  }
+  return matrix_file_write_factor(file_name, MATRIX_CONTENT_FACTOR, factor->matrix_size,
+                                  factor->block_size, 0, 0, cholesky_factor_tiles(factor),
+                                  cholesky_factor_diagonal(factor));
+}
+
+int cholesky_factor_map(cholesky_factor_t* factor, const char* file_name) {
+  MatrixFile file;
+  int i;
+
+  if (factor->options.mixed_precision || factor->profile || matrix_file_map(&file, file_name, 1)) {
+    return -1;
+  }
+  if (file.header.content != MATRIX_CONTENT_FACTOR ||
+      file.header.matrix_size != (uint64_t)factor->matrix_size ||
+      file.header.block_size != (uint32_t)factor->block_size) {
+    printf("Factor %s does not fit the solver\n", file_name);
+    matrix_file_unmap(&file);
+    return -1;
+  }
+
+  cholesky_factor_unmap(factor);
+  factor->mapped = file;
+  for (i = 0; i < factor->total_threads; ++i) {
+    factor->solve_args[i].matrix = file.data;
+    factor->solve_args[i].diagonal =
+        file.data + tile_matrix_length(factor->matrix_size, factor->block_size);
+  }
+  factor->factored = 1;
+  return 0;
+}
+
+int cholesky_factor_solve(cholesky_factor_t* factor, double* rhs, int rhs_count) {
+  int i;
+
+  if (!factor->factored || rhs_count <= 0) {
+    return -1;
+  }
+
+  if (factor->options.mixed_precision) {
+    return cholesky_mixed_refine(factor->matrix_size, factor->packed, factor->tiles_float,
+                                 factor->diagonal_float, factor->block_size, rhs, rhs_count,
+                                 &factor->iterations)
+               ? -1
+               : 0;
+  }
+
+  factor->solve_error = 0;
+  for (i = 0; i < factor->total_threads; ++i) {
+    factor->solve_args[i].rhs = rhs;
+    factor->solve_args[i].rhs_count = rhs_count;
+  }
+
+  thread_pool_run(&factor->pool, solve_threaded, factor->solve_args, sizeof(SolveArgs));
+  return factor->solve_error ? -1 : 0;
+}
+
+int cholesky_factor_update(cholesky_factor_t* factor, const double* vectors, int rank, int sign) {
+  int n = factor->matrix_size;
+  size_t length = (size_t)(n + 1 + 6 * factor->block_size) * rank;
+  double *work, *weights;
+  int i, k;
+
+  if (!factor->factored || factor->options.mixed_precision || factor->profile ||
+      factor->mapped.mapping || rank <= 0 || (sign != 1 && sign != -1)) {
+    return -1;
+  }
+
+  // The workspace grows to the largest rank seen and is kept.
+  if (length > factor->update_length) {
+    if (!(work = (double*)realloc(factor->update_work, length * sizeof(double)))) {
+      return -1;
+    }
+    factor->update_work = work;
+    factor->update_length = length;
+  }
+
+  // The vectors are transposed, so that the block row kernels stream them.
+  work = factor->update_work;
+  weights = work + (size_t)n * rank;
+  for (i = 0; i < n; ++i) {
+    for (k = 0; k < rank; ++k) {
+      work[(size_t)k * n + i] = vectors[(size_t)i * rank + k];
+    }
+  }
+  for (k = 0; k < rank; ++k) {
+    weights[k] = sign;
+  }
+
+  factor->solve_error = 0;
+  for (i = 0; i < factor->total_threads; ++i) {
+    factor->update_args[i].vectors = work;
+    factor->update_args[i].rank = rank;
+    factor->update_args[i].weights = weights;
+    factor->update_args[i].coefficients = weights + rank;
+  }
+
+  thread_pool_run(&factor->pool, update_threaded, factor->update_args, sizeof(UpdateArgs));
+  if (factor->solve_error) {
+    factor->factored = 0;
+    return -1;
+  }
+  return 0;
+}
+
+int cholesky_factor_block_size(cholesky_factor_t* factor) {
+  return factor->block_size;
+}
+
+double* cholesky_factor_tiles(cholesky_factor_t* factor) {
+  return factor->mapped.mapping ? factor->solve_args[0].matrix : factor->tiles;
+}
+
+const TileProfile* cholesky_factor_profile(cholesky_factor_t* factor) {
+  return factor->profile;
+}
+
+float* cholesky_factor_tiles_float(cholesky_factor_t* factor) {
+  return factor->tiles_float;
+}
+
+int cholesky_factor_iterations(cholesky_factor_t* factor) {
+  return factor->iterations;
+}
+
+double* cholesky_factor_diagonal(cholesky_factor_t* factor) {
+  return factor->mapped.mapping ? factor->solve_args[0].diagonal : factor->diagonal;
+}
+
+double cholesky_factor_cpu_time(cholesky_factor_t* factor, int thread_id) {
+  if (thread_id < 0 || thread_id >= factor->total_threads) {
+    return 0;
+  }
+  return factor->options.mixed_precision ? factor->mixed_args[thread_id].cpu_time
+                                         : factor->cholesky_args[thread_id].cpu_time;
+}
+
+Trace* cholesky_factor_trace(cholesky_factor_t* factor) {
+  return factor->options.trace ? &factor->trace : NULL;
+}
+
+void cholesky_factor_destroy(cholesky_factor_t* factor) {
+  if (!factor) {
+    return;
+  }
+  if (factor->pool.total_threads) {
+    thread_pool_destroy(&factor->pool);
+  }
+  affinity_restore(factor->caller_mask);
+  free(factor->cpus);
+  trace_destroy(&factor->trace);
+  matrix_file_unmap(&factor->mapped);
+  cholesky_dag_destroy(&factor->dag);
+  if (factor->profile) {
+    tile_profile_destroy(factor->profile);
+    free(factor->profile);
+  }
+  free(factor->tiles);
+  free(factor->diagonal);
+  free(factor->tiles_float);
+  free(factor->diagonal_float);
+  free(factor->mixed_args);
+  free(factor->load_args);
+  free(factor->cholesky_args);
+  free(factor->solve_args);
+  free(factor->update_args);
+  free(factor->update_work);
+  free(factor);
+}
@@ -0,0 +1,156 @@
+#ifndef CHOLESKY_FACTOR_H
+#define CHOLESKY_FACTOR_H
+
+#include "cholesky_threaded.h"
+#include "distribution.h"
+#include "matrix_file.h"
+#include "skyline.h"
+#include "trace.h"
+
+// Library interface: factor once, solve many.
+//
+// A handle owns the tile-major factor and a persistent thread pool for one
+// matrix size, so repeated factorizations and solves skip thread creation,
+// barrier setup and allocation. The pool synchronizes with spinning
+// barriers, and with keep_hot its workers also stay awake between calls.
+//
+//   cholesky_factor_t* factor = cholesky_factor_create(n, m, threads, NULL);
+//   cholesky_factor_factor(factor, packed_matrix);
+//   cholesky_factor_solve(factor, rhs, rhs_count);
+//   cholesky_factor_destroy(factor);
+
+typedef struct _CholeskyFactor cholesky_factor_t;
+
+// Tunables of a handle; start from cholesky_options_default().
+typedef struct _CholeskyOptions {
+  CholeskyEngine engine;          // Scheduling strategy of the decomposition.
+  DistributionKind distribution;  // Tile mapping of CHOLESKY_ENGINE_BARRIER.
+  int grid_rows;                  // Thread grid rows for DISTRIBUTION_2D_CYCLIC, 0 for auto.
+  int keep_hot;                   // Non-zero to keep idle pool workers spinning between calls.
+  int quiet;                      // Non-zero to suppress the per-thread CPU time report.
+  int mixed_precision;            // Non-zero to factor in single precision and refine solves.
+  const char* affinity;           // CPU map of the threads (see affinity.h), NULL for none.
+  int trace;                      // 0 off, 1 timestamps, 2 also hardware counters (trace.h).
+  const Skyline* skyline;         // Envelope of the skyline matrices to factor, or NULL.
+  const char* checkpoint;         // Checkpoint file of CHOLESKY_ENGINE_BARRIER, or NULL.
+  double checkpoint_interval;     // Seconds between checkpoints, 600 by default.
+} CholeskyOptions;
+
+// Fills the options with the defaults.
+void cholesky_options_default(CholeskyOptions* options);
+
+// Creates a handle for matrices of the given size and starts its threads.
+//
+// The factor is not touched until every thread has zeroed the tiles it owns
+// in the distribution, so that first-touch places each tile on the NUMA node
+// of its owner. With an affinity map the threads are pinned before that,
+// including the calling thread, which gets its old mask back on destroy.
+//
+// With a skyline option the handle only stores the tiles of its profile (see
+// skyline.h), which needs CHOLESKY_ENGINE_BARRIER without mixed_precision,
+// and factors skylines with this envelope only. Only the first rows of the
+// skyline are read, during the call.
+//
+// With a checkpoint option every factorization writes checkpoints to that
+// file at block step boundaries, at least checkpoint_interval seconds apart
+// (see cholesky_threaded.h), and removes it once it completes. This needs
+// CHOLESKY_ENGINE_BARRIER without mixed_precision or a skyline option.
+// options: NULL for the defaults.
+// Returns: NULL if the parameters are invalid or there is not enough memory.
+cholesky_factor_t* cholesky_factor_create(int matrix_size, int block_size, int total_threads,
+                                          const CholeskyOptions* options);
+
+// Factors a symmetric matrix given in packed upper triangular format as
+// R^T * D * R. The packed matrix is not modified; all threads of the pool
+// convert it to the tile layout.
+//
+// With mixed_precision the factor is kept in single precision (see
+// cholesky_mixed.h), which ignores the engine option, and the matrix has to
+// stay valid until the last solve, which computes its residuals against it.
+// Returns: 0 on success, -1 if the method cannot be applied.
+int cholesky_factor_factor(cholesky_factor_t* factor, double* matrix);
+
+// Same as cholesky_factor_factor for a matrix that is already in the
+// tile-major format of tile_matrix.h with cholesky_factor_block_size. Not
+// available with mixed_precision.
+int cholesky_factor_factor_tiles(cholesky_factor_t* factor, double* tiles);
+
+// Same as cholesky_factor_factor for a skyline matrix with the envelope of
+// the skyline option, which the handle needs; the packed and tile inputs
+// are not available then.
+int cholesky_factor_factor_skyline(cholesky_factor_t* factor, const Skyline* skyline);
+
+// Continues the factorization saved in a checkpoint file, which must come
+// from a handle of the same size, block size and schedule, with the same
+// matrix; the number of threads may differ. Checkpoints go to the file of the
+// checkpoint option, if any, as in cholesky_factor_factor.
+// Returns: 0 on success, -1 if the checkpoint does not fit the handle or the
+//          method cannot be applied.
+int cholesky_factor_resume(cholesky_factor_t* factor, const char* file_name);
+
+// Writes the last successful factorization as a MATRIX_CONTENT_FACTOR file
+// (see matrix_file.h). Not available with mixed_precision or a skyline
+// option.
+// Returns: 0 on success, -1 if there is no factor or it cannot be written.
+int cholesky_factor_save(cholesky_factor_t* factor, const char* file_name);
+
+// Maps a factor written by cholesky_factor_save by a handle of the same size
+// and block size, and solves with it in place, without copying it after the
+// checksum is verified. The mapping is read-only, so
+// cholesky_factor_update is not available until the next factorization,
+// which releases it. Not available with mixed_precision or a skyline option.
+// Returns: 0 on success, -1 if the file cannot be mapped or does not fit the
+//          handle.
+int cholesky_factor_map(cholesky_factor_t* factor, const char* file_name);
+
+// Solves A * X = B in place for an N x K row-major block of right-hand sides
+// with the last successful factorization.
+// Returns: 0 on success, -1 if there is no factor, it is singular, or the
+//          iterative refinement of a mixed precision factor does not converge.
+int cholesky_factor_solve(cholesky_factor_t* factor, double* rhs, int rhs_count);
+
+// Modifies the last successful factorization in place into the factor of
+// A + sign * V * V^T for an N x K row-major block of vectors V, with sign +1
+// for an update and -1 for a downdate, in O(K * N^2) on the threads of the
+// pool (see update_threaded.h). A row and column change of A is a rank-two
+// modification: an update and a downdate. Not available with mixed_precision
+// or a skyline option, since the vectors may reach above the envelope, or on
+// a factor mapped by cholesky_factor_map.
+// Returns: 0 on success, -1 if there is no factor, the parameters are invalid,
+//          there is not enough memory, or the modified matrix is singular;
+//          the factor is lost then.
+int cholesky_factor_update(cholesky_factor_t* factor, const double* vectors, int rank, int sign);
+
+// Block size of the tile layout, which differs from the requested one for
+// CHOLESKY_ENGINE_RECURSIVE.
+int cholesky_factor_block_size(cholesky_factor_t* factor);
+
+// Tile-major factor R, see tile_matrix.h; NULL with mixed_precision. With a
+// skyline option it is in the layout of cholesky_factor_profile, and after
+// cholesky_factor_map it is the mapped one.
+double* cholesky_factor_tiles(cholesky_factor_t* factor);
+
+// Tile layout of the factor with a skyline option, NULL otherwise.
+const TileProfile* cholesky_factor_profile(cholesky_factor_t* factor);
+
+// Single precision tile-major factor R with mixed_precision, NULL otherwise.
+float* cholesky_factor_tiles_float(cholesky_factor_t* factor);
+
+// Refinement steps the last solve needed after its first correction; 0
+// without mixed_precision.
+int cholesky_factor_iterations(cholesky_factor_t* factor);
+
+// Diagonal scaling elements D, the mapped ones after cholesky_factor_map.
+double* cholesky_factor_diagonal(cholesky_factor_t* factor);
+
+// CPU time in seconds that a thread of the pool spent in the last
+// decomposition, 0 before the first one.
+double cholesky_factor_cpu_time(cholesky_factor_t* factor, int thread_id);
+
+// Timeline of the last factorization with the trace option, NULL otherwise.
+Trace* cholesky_factor_trace(cholesky_factor_t* factor);
+
+// Stops the threads and releases the handle.
+void cholesky_factor_destroy(cholesky_factor_t* factor);
+
+#endif  // CHOLESKY_FACTOR_H
@@ -0,0 +1,263 @@
+#include "cholesky_mixed.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_op.h"
+#include "array_op_float.h"
+#include "tile_matrix.h"
+#include "timer.h"
+
+// Upper bound on the refinement steps; a well-conditioned system needs two
+// or three.
+const int REFINEMENT_MAX_ITERATIONS = 30;
+
+// Entry point for each worker thread.
+void* cholesky_mixed_threaded(void* ptr) {
+  double timer = get_time_pthread();
+  MixedArgs* pa = (MixedArgs*)ptr;
+
+  thread_barrier_wait(pa->barrier);
+
+  cholesky_mixed(pa->matrix_size, pa->matrix, pa->diagonal, pa->block_size, pa->thread_id,
+                 pa->barrier, pa->error, pa->distribution, pa->trace);
+
+  pa->cpu_time = (get_time_pthread() - timer) / (1000.0 * 1000.0 * 1000.0);
+  if (!pa->quiet) {
+    printf("Thread %d CPU time: %.2lf\n", pa->thread_id, pa->cpu_time);
+  }
+
+  thread_barrier_wait(pa->barrier);
+
+  return 0;
+}
+
+// Same schedule as the right-looking double precision engine in
+// cholesky_threaded.c.
+int cholesky_mixed(int matrix_size, float* matrix, float* diagonal, int block_size, int thread_id,
+                   ThreadBarrier* barrier, int* error, const Distribution* distribution,
+                   Trace* trace) {
+  int i, j, r, c;
+  int pij_n, pij_m, pr_m, pc_m;
+
+  float* md;
+
+  for (i = 0; i < matrix_size; i += block_size) {
+    pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+
+    // Stage 2: The owner of the diagonal block decomposes it.
+    md = tile_block_float(matrix, i, i, matrix_size, block_size);
+    if (thread_id == tile_owner(distribution, i / block_size, i / block_size)) {
+      trace_begin(trace, thread_id);
+      if (cholesky_for_block_float(pij_n, md, diagonal + i)) {
+        printf("Cholesky method with this block size cannot be applied\n");
+        *error = 1;
+      }
+      trace_end(trace, thread_id, TRACE_FACTOR, i / block_size, 1.0 / 3.0 * pij_n * pij_n * pij_n);
+    }
+
+    trace_barrier_wait(trace, thread_id, barrier, i / block_size);
+    if (*error) {
+      return -1;
+    }
+
+    // Stage 3: Owners solve the off-diagonal blocks of the current row
+    // against the factored diagonal block.
+    for (j = i + block_size; j < matrix_size; j += block_size) {
+      if (thread_id == tile_owner(distribution, i / block_size, j / block_size)) {
+        pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+        trace_begin(trace, thread_id);
+        lower_triangle_block_diagonal_solve_float(
+            pij_n, pij_m, md, diagonal + i,
+            tile_block_float(matrix, i, j, matrix_size, block_size));
+        trace_end(trace, thread_id, TRACE_SCALE, i / block_size, 1.0 * pij_n * pij_n * pij_m);
+      }
+    }
+
+    trace_barrier_wait(trace, thread_id, barrier, i / block_size);
+
+    // Stage 1: Owners apply the current row to the trailing triangle.
+    for (r = i + block_size; r < matrix_size; r += block_size) {
+      pr_m = (r + block_size < matrix_size ? block_size : matrix_size - r);
+      for (c = r; c < matrix_size; c += block_size) {
+        if (thread_id != tile_owner(distribution, r / block_size, c / block_size)) {
+          continue;
+        }
+        pc_m = (c + block_size < matrix_size ? block_size : matrix_size - c);
+        trace_begin(trace, thread_id);
+        main_blocks_diagonal_multiply_float(
+            pij_n, pr_m, pc_m, tile_block_float(matrix, i, r, matrix_size, block_size),
+            tile_block_float(matrix, i, c, matrix_size, block_size), diagonal + i,
+            tile_block_float(matrix, r, c, matrix_size, block_size));
+        trace_end(trace, thread_id, TRACE_UPDATE, i / block_size, 2.0 * pij_n * pr_m * pc_m);
+      }
+    }
+  }
+
+  return 0;
+}
+
+// Single-threaded version of solve_system(); the corrections cost O(N^2 K)
+// against the O(N^3) factorization.
+int solve_system_float(int matrix_size, float* matrix, float* diagonal, float* rhs, int rhs_count,
+                       int block_size) {
+  int i, j, residue;
+  int pi_n, pj_n;
+  float* xi;
+
+  for (i = 0; i < matrix_size; i += block_size) {
+    pi_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    xi = rhs + i * rhs_count;
+
+    if (lower_triangle_block_diagonal_solve_float(
+            pi_n, rhs_count, tile_block_float(matrix, i, i, matrix_size, block_size),
+            diagonal + i, xi)) {
+      return -1;
+    }
+    for (j = i + block_size; j < matrix_size; j += block_size) {
+      pj_n = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      main_blocks_diagonal_multiply_float(pi_n, pj_n, rhs_count,
+                                          tile_block_float(matrix, i, j, matrix_size, block_size),
+                                          xi, diagonal + i, rhs + j * rhs_count);
+    }
+  }
+
+  residue = matrix_size - (matrix_size % block_size);
+  if (residue == matrix_size) {
+    residue -= block_size;
+  }
+
+  for (i = residue; i >= 0; i -= block_size) {
+    pi_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    xi = rhs + i * rhs_count;
+
+    if (upper_triangle_block_solve_float(
+            pi_n, rhs_count, tile_block_float(matrix, i, i, matrix_size, block_size), xi)) {
+      return -1;
+    }
+    for (j = 0; j < i; j += block_size) {
+      pj_n = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      main_blocks_multiply_subtract_float(pj_n, pi_n, rhs_count,
+                                          tile_block_float(matrix, j, i, matrix_size, block_size),
+                                          xi, rhs + j * rhs_count);
+    }
+  }
+
+  return 0;
+}
+
+// Infinity norm of a symmetric matrix in packed upper triangular format.
+static double packed_matrix_norm(int n, double* matrix) {
+  int i, j;
+  double *pa, norm = 0;
+  double* sums = (double*)calloc(n, sizeof(double));
+
+  if (!sums) {
+    return 0;
+  }
+  pa = matrix;
+  for (i = 0; i < n; ++i) {
+    sums[i] += fabs(pa[0]);
+    for (j = 1; j < n - i; ++j) {
+      sums[i] += fabs(pa[j]);
+      sums[i + j] += fabs(pa[j]);
+    }
+    pa += n - i;
+  }
+  for (i = 0; i < n; ++i) {
+    if (sums[i] > norm) {
+      norm = sums[i];
+    }
+  }
+  free(sums);
+  return norm;
+}
+
+// Stopping test of LAPACK's dsposv: every column satisfies
+// ||r||_inf <= ||x||_inf * ||A||_inf * eps * sqrt(N).
+// Returns: the largest ||r||_inf / ||x||_inf ratio, and through converged
+//          whether the test passed.
+static double refinement_residual(int n, int k, double* residual, double* x, double bound,
+                                  int* converged) {
+  int i, c;
+  double r_norm, x_norm, worst = 0;
+
+  *converged = 1;
+  for (c = 0; c < k; ++c) {
+    r_norm = 0;
+    x_norm = 0;
+    for (i = 0; i < n; ++i) {
+      r_norm = fmax(r_norm, fabs(residual[i * k + c]));
+      x_norm = fmax(x_norm, fabs(x[i * k + c]));
+    }
+    if (r_norm > x_norm * bound) {
+      *converged = 0;
+    }
+    worst = fmax(worst, x_norm > 0 ? r_norm / x_norm : r_norm);
+  }
+  return worst;
+}
+
+int cholesky_mixed_refine(int matrix_size, double* packed, float* matrix, float* diagonal,
+                          int block_size, double* rhs, int rhs_count, int* iterations) {
+  int step, converged;
+  size_t i, len = (size_t)matrix_size * rhs_count;
+  double bound = packed_matrix_norm(matrix_size, packed) * DBL_EPSILON * sqrt(matrix_size);
+  double worst, previous = 0;
+  double *b, *residual;
+  float* correction;
+  int result = -1;
+
+  *iterations = 0;
+  b = (double*)malloc(2 * len * sizeof(double));
+  correction = (float*)malloc(len * sizeof(float));
+  if (!b || !correction) {
+    free(b);
+    free(correction);
+    return -2;
+  }
+  residual = b + len;
+
+  // X starts at zero, so the first residual is B itself.
+  memcpy(b, rhs, len * sizeof(double));
+  memcpy(residual, rhs, len * sizeof(double));
+  memset(rhs, 0, len * sizeof(double));
+
+  for (step = 0; step <= REFINEMENT_MAX_ITERATIONS; ++step) {
+    for (i = 0; i < len; ++i) {
+      correction[i] = (float)residual[i];
+    }
+    if (solve_system_float(matrix_size, matrix, diagonal, correction, rhs_count, block_size)) {
+      break;
+    }
+    for (i = 0; i < len; ++i) {
+      rhs[i] += correction[i];
+    }
+
+    // R = B - A * X in double precision.
+    packed_matrix_block_multiply(matrix_size, rhs_count, packed, rhs, residual);
+    for (i = 0; i < len; ++i) {
+      residual[i] = b[i] - residual[i];
+    }
+
+    worst = refinement_residual(matrix_size, rhs_count, residual, rhs, bound, &converged);
+    *iterations = step;
+    if (converged) {
+      result = 0;
+      break;
+    }
+    // A growing residual means the matrix is too ill-conditioned for the
+    // single precision factor.
+    if (step && worst >= previous) {
+      break;
+    }
+    previous = worst;
+  }
+
+  free(b);
+  free(correction);
+  return result;
+}
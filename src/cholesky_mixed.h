@@ -0,0 +1,58 @@
+#ifndef CHOLESKY_MIXED_H
+#define CHOLESKY_MIXED_H
+
+#include "distribution.h"
+#include "thread_barrier.h"
+#include "trace.h"
+
+// Mixed precision decomposition.
+//
+// The matrix is rounded to single precision tiles and factored with the
+// single precision kernels, which halves the memory traffic and the size of
+// the factor. Solutions are then brought back to double precision accuracy by
+// iterative refinement: the residual is computed in double precision against
+// the original packed matrix, the correction is solved with the single
+// precision factor, and the two steps repeat until the residual is at the
+// level of a double precision solve.
+
+// Arguments passed to each worker thread.
+typedef struct _MixedArgs {
+  int matrix_size;                   // Total size of the matrix (N x N).
+  float* matrix;                     // Pointer to the single precision tile-major matrix.
+  float* diagonal;                   // Pointer to the diagonal scaling elements.
+  int block_size;                    // Size of the computation blocks (M x M).
+  int thread_id;                     // Unique ID for the current thread.
+  ThreadBarrier* barrier;            // Synchronization barrier.
+  int* error;                        // Shared error flag for re-entrant reporting.
+  const Distribution* distribution;  // Tile mapping.
+  int quiet;                         // Non-zero to skip the CPU time report.
+  Trace* trace;                      // Timeline to record, or NULL.
+  double cpu_time;                   // CPU seconds of the thread in the last decomposition.
+} MixedArgs;
+
+// Entry point for pthread_create.
+void* cholesky_mixed_threaded(void* ptr);
+
+// Right-looking block decomposition in single precision, with the tiles
+// updated by their owners in the distribution.
+// Returns: 0 on success, -1 if a diagonal block cannot be decomposed.
+int cholesky_mixed(int matrix_size, float* matrix, float* diagonal, int block_size, int thread_id,
+                   ThreadBarrier* barrier, int* error, const Distribution* distribution,
+                   Trace* trace);
+
+// Solves R^T * D * R * X = B in place with the single precision factor for
+// an N x K row-major block of right-hand sides.
+// Returns: 0 on success, -1 if a diagonal block is singular.
+int solve_system_float(int matrix_size, float* matrix, float* diagonal, float* rhs, int rhs_count,
+                       int block_size);
+
+// Solves A * X = B in place by iterative refinement with the single precision
+// factor of the packed matrix A.
+//
+// iterations: Number of refinement steps after the first solve.
+// Returns: 0 on success, -1 if the refinement does not converge or a block is
+//          singular, -2 if there is not enough memory.
+int cholesky_mixed_refine(int matrix_size, double* packed, float* matrix, float* diagonal,
+                          int block_size, double* rhs, int rhs_count, int* iterations);
+
+#endif  // CHOLESKY_MIXED_H
@@ -0,0 +1,543 @@
+#include "cholesky_ooc.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "array_io.h"
+#include "array_op.h"
+#include "thread_pool.h"
+#include "tile_matrix.h"
+
+// Background reader of a sequence of block rows into two alternating buffers.
+typedef struct _OocStream {
+  int fd;                  // Tile file.
+  int tile_rows;           // Number of block rows of the matrix.
+  size_t slot;             // Doubles per tile slot.
+  double* buffers[2];      // Row buffers of tile_rows slots each.
+  int first_row;           // Block row of the first read.
+  int count;               // Number of block rows to read.
+  int step;                // Block row increment between reads, 1 or -1.
+  int first_column;        // Leftmost tile column read of every block row.
+  int produced;            // Block rows read so far.
+  int consumed;            // Block rows released by the consumer so far.
+  int error;               // Set when a read fails.
+  int stop;                // Set to end the reader early.
+  pthread_t thread;        // Reader thread.
+  pthread_mutex_t lock;    // Protects the counters and flags.
+  pthread_cond_t changed;  // Signals a change of the counters or flags.
+} OocStream;
+
+// Per-thread arguments of the factorization.
+typedef struct _OocArgs {
+  cholesky_ooc_t* ooc;  // Handle being factored.
+  int thread_id;        // Unique ID for the current thread.
+} OocArgs;
+
+struct _CholeskyOoc {
+  int matrix_size;        // Total size of the matrix (N x N).
+  int block_size;         // Size of the tiles (M x M).
+  int total_threads;      // Number of threads in the pool.
+  int tile_rows;          // Number of block rows.
+  size_t slot;            // Doubles per tile slot, M * M.
+  char* file_name;        // Path of the tile file.
+  int fd;                 // Tile file, -1 until it is created.
+  size_t panel_capacity;  // Tile slots of the panel buffer.
+  double* panel;          // Block rows being factored.
+  double* diagonal;       // Diagonal scaling elements.
+  OocStream stream;       // Reader of the block rows above the panel.
+  double* row;            // Block row the stream delivered last, shared with the pool.
+  OocArgs* args;          // Per-thread arguments of the factorization.
+  ThreadPool pool;        // Worker threads.
+  int error;              // Error flag of the last factorization.
+  int factored;           // Non-zero after a successful factorization.
+};
+
+// Index of tile (bi, bj) in block-row order, see tile_block(). Computed in
+// size_t, since the element offsets of a matrix on disk exceed int.
+static size_t ooc_tile_index(int tile_rows, int bi, int bj) {
+  return (size_t)bi * tile_rows - ((size_t)bi * (bi - 1)) / 2 + (bj - bi);
+}
+
+// Width of the tiles in block row or column b.
+static int ooc_width(cholesky_ooc_t* ooc, int b) {
+  int i = b * ooc->block_size;
+  return (i + ooc->block_size < ooc->matrix_size ? ooc->block_size : ooc->matrix_size - i);
+}
+
+// Reads or writes count doubles at element offset of the file, retrying
+// short transfers.
+// Returns: 0 on success, -1 on I/O errors.
+static int ooc_transfer(int fd, double* data, size_t count, size_t offset, int write) {
+  char* p = (char*)data;
+  size_t left = count * sizeof(double);
+  off_t position = (off_t)(offset * sizeof(double));
+  ssize_t done;
+
+  while (left) {
+    done = write ? pwrite(fd, p, left, position) : pread(fd, p, left, position);
+    if (done <= 0) {
+      return -1;
+    }
+    p += done;
+    left -= done;
+    position += done;
+  }
+  return 0;
+}
+
+static void* ooc_stream_reader(void* ptr) {
+  OocStream* stream = (OocStream*)ptr;
+  int i, row, column, stop, failed;
+
+  for (i = 0; i < stream->count; ++i) {
+    // Wait until the buffer of row i - 2 has been released.
+    pthread_mutex_lock(&stream->lock);
+    while (i - stream->consumed >= 2 && !stream->stop) {
+      pthread_cond_wait(&stream->changed, &stream->lock);
+    }
+    stop = stream->stop;
+    pthread_mutex_unlock(&stream->lock);
+    if (stop) {
+      break;
+    }
+
+    row = stream->first_row + i * stream->step;
+    column = (row > stream->first_column ? row : stream->first_column);
+    failed = ooc_transfer(stream->fd, stream->buffers[i % 2],
+                          (stream->tile_rows - column) * stream->slot,
+                          ooc_tile_index(stream->tile_rows, row, column) * stream->slot, 0);
+
+    pthread_mutex_lock(&stream->lock);
+    if (failed) {
+      stream->error = 1;
+    } else {
+      stream->produced = i + 1;
+    }
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+    if (failed) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+// Starts reading count block rows from first_row on, each from tile column
+// max(row, first_column) to the end of the row.
+// Returns: 0 on success, -1 if the reader cannot be started.
+static int ooc_stream_begin(OocStream* stream, int first_row, int count, int step,
+                            int first_column) {
+  stream->first_row = first_row;
+  stream->count = count;
+  stream->step = step;
+  stream->first_column = first_column;
+  stream->produced = 0;
+  stream->consumed = 0;
+  stream->error = 0;
+  stream->stop = 0;
+  return pthread_create(&stream->thread, NULL, ooc_stream_reader, stream) ? -1 : 0;
+}
+
+// Waits for the next block row.
+// Returns: its tiles, the first one in slot 0, or NULL if the read failed.
+static double* ooc_stream_next(OocStream* stream) {
+  double* row;
+
+  pthread_mutex_lock(&stream->lock);
+  while (stream->produced <= stream->consumed && !stream->error) {
+    pthread_cond_wait(&stream->changed, &stream->lock);
+  }
+  row = stream->produced > stream->consumed ? stream->buffers[stream->consumed % 2] : NULL;
+  pthread_mutex_unlock(&stream->lock);
+  if (!row) {
+    printf("Cannot read the tile file\n");
+  }
+  return row;
+}
+
+// Hands the buffer of the current block row back to the reader.
+static void ooc_stream_release(OocStream* stream) {
+  pthread_mutex_lock(&stream->lock);
+  ++stream->consumed;
+  pthread_cond_broadcast(&stream->changed);
+  pthread_mutex_unlock(&stream->lock);
+}
+
+// Stops the reader, also before it has read every row.
+static void ooc_stream_end(OocStream* stream) {
+  pthread_mutex_lock(&stream->lock);
+  stream->stop = 1;
+  pthread_cond_broadcast(&stream->changed);
+  pthread_mutex_unlock(&stream->lock);
+  pthread_join(stream->thread, NULL);
+}
+
+// First block row after the panel that starts at block row i0: as many rows
+// as fit into the panel buffer, which always holds at least one.
+static int ooc_panel_end(cholesky_ooc_t* ooc, int i0) {
+  size_t used = 0;
+  int i1 = i0;
+
+  while (i1 < ooc->tile_rows && used + (ooc->tile_rows - i1) <= ooc->panel_capacity) {
+    used += ooc->tile_rows - i1;
+    ++i1;
+  }
+  return i1;
+}
+
+// Tile (bi, bj) of the panel that starts at block row i0.
+static double* ooc_panel_tile(cholesky_ooc_t* ooc, int i0, int bi, int bj) {
+  return ooc->panel + (ooc_tile_index(ooc->tile_rows, bi, bj) -
+                       ooc_tile_index(ooc->tile_rows, i0, i0)) *
+                          ooc->slot;
+}
+
+// Reads or writes block rows [i0, i1), one contiguous extent of the file.
+static int ooc_panel_transfer(cholesky_ooc_t* ooc, int i0, int i1, int write) {
+  size_t first = ooc_tile_index(ooc->tile_rows, i0, i0);
+  size_t count = ooc_tile_index(ooc->tile_rows, i1, i1) - first;
+
+  if (ooc_transfer(ooc->fd, ooc->panel, count * ooc->slot, first * ooc->slot, write)) {
+    printf("Cannot %s the tile file\n", write ? "write" : "read");
+    return -1;
+  }
+  return 0;
+}
+
+// Left-looking factorization of one panel after another. Thread 0 does the
+// I/O; all threads apply the updates and the solves to tiles of the panel.
+static void* cholesky_ooc_threaded(void* ptr) {
+  OocArgs* pa = (OocArgs*)ptr;
+  cholesky_ooc_t* ooc = pa->ooc;
+  ThreadBarrier* barrier = &ooc->pool.barrier;
+  int thread_id = pa->thread_id;
+  int total_threads = ooc->total_threads;
+  int tile_rows = ooc->tile_rows;
+  int m = ooc->block_size;
+  int i0, i1, k, r, c, p;
+  int pk_n, pr_n;
+  double *row, *mc, *md;
+
+  for (i0 = 0; i0 < tile_rows; i0 = i1) {
+    i1 = ooc_panel_end(ooc, i0);
+
+    if (thread_id == 0 && (ooc_panel_transfer(ooc, i0, i1, 0) ||
+                           (i0 && ooc_stream_begin(&ooc->stream, 0, i0, 1, i0)))) {
+      ooc->error = 1;
+    }
+    thread_barrier_wait(barrier);
+    if (ooc->error) {
+      return NULL;
+    }
+
+    // Stage 1: Every block row above the panel is streamed in once and
+    // applied to all tiles of the panel, which are dealt out cyclically.
+    for (k = 0; k < i0; ++k) {
+      if (thread_id == 0 && !(ooc->row = ooc_stream_next(&ooc->stream))) {
+        ooc->error = 1;
+      }
+      thread_barrier_wait(barrier);
+      if (ooc->error) {
+        break;
+      }
+
+      pk_n = ooc_width(ooc, k);
+      row = ooc->row;
+      p = 0;
+      for (r = i0; r < i1; ++r) {
+        for (c = r; c < tile_rows; ++c, ++p) {
+          if (p % total_threads == thread_id) {
+            main_blocks_diagonal_multiply(pk_n, ooc_width(ooc, r), ooc_width(ooc, c),
+                                          row + (r - i0) * ooc->slot, row + (c - i0) * ooc->slot,
+                                          ooc->diagonal + k * m, ooc_panel_tile(ooc, i0, r, c));
+          }
+        }
+      }
+
+      thread_barrier_wait(barrier);
+      if (thread_id == 0) {
+        ooc_stream_release(&ooc->stream);
+      }
+    }
+    if (thread_id == 0 && i0) {
+      ooc_stream_end(&ooc->stream);
+    }
+    if (ooc->error) {
+      return NULL;
+    }
+
+    // Stage 2: The panel is factored in memory, left-looking as in
+    // cholesky_left_looking.
+    for (r = i0; r < i1; ++r) {
+      pr_n = ooc_width(ooc, r);
+      for (c = r + thread_id; c < tile_rows; c += total_threads) {
+        mc = ooc_panel_tile(ooc, i0, r, c);
+        for (k = i0; k < r; ++k) {
+          main_blocks_diagonal_multiply(ooc_width(ooc, k), pr_n, ooc_width(ooc, c),
+                                        ooc_panel_tile(ooc, i0, k, r),
+                                        ooc_panel_tile(ooc, i0, k, c), ooc->diagonal + k * m, mc);
+        }
+      }
+      thread_barrier_wait(barrier);
+
+      md = ooc_panel_tile(ooc, i0, r, r);
+      if (thread_id == 0 && cholesky_for_block(pr_n, md, ooc->diagonal + r * m)) {
+        printf("Cholesky method with this block size cannot be applied\n");
+        ooc->error = 1;
+      }
+      thread_barrier_wait(barrier);
+      if (ooc->error) {
+        return NULL;
+      }
+
+      for (c = r + 1 + thread_id; c < tile_rows; c += total_threads) {
+        lower_triangle_block_diagonal_solve(pr_n, ooc_width(ooc, c), md, ooc->diagonal + r * m,
+                                            ooc_panel_tile(ooc, i0, r, c));
+      }
+      thread_barrier_wait(barrier);
+    }
+
+    // The finished panel goes back to the file before the next one streams it.
+    if (thread_id == 0 && ooc_panel_transfer(ooc, i0, i1, 1)) {
+      ooc->error = 1;
+    }
+    thread_barrier_wait(barrier);
+    if (ooc->error) {
+      return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+void ooc_source_tile(const OocSource* source, int matrix_size, int block_size, int row, int column,
+                     int n, int m, double* tile) {
+  int tile_rows = tile_count(matrix_size, block_size);
+  size_t slot = (size_t)block_size * block_size;
+
+  if (source->kind == OOC_SOURCE_GENERATED) {
+    fill_matrix_tile(matrix_size, row, column, n, m, tile);
+  } else if (source->kind == OOC_SOURCE_TILES) {
+    memcpy(tile,
+           source->data +
+               ooc_tile_index(tile_rows, row / block_size, column / block_size) * slot,
+           slot * sizeof(double));
+  } else if (row == column) {
+    cpy_diagonal_block_to_block(source->data, row, matrix_size, n, tile);
+  } else {
+    cpy_matrix_block_to_block(source->data, row, column, matrix_size, n, m, tile);
+  }
+}
+
+int ooc_source_multiply(const OocSource* source, int matrix_size, int block_size, double* x,
+                        double* y) {
+  int i, j, r, c, pr_n, pc_n;
+  double* tile = (double*)malloc((size_t)block_size * block_size * sizeof(double));
+  double aij;
+
+  if (!tile) {
+    return -1;
+  }
+  memset(y, 0, matrix_size * sizeof(double));
+
+  // Every tile of the upper triangle also stands for its mirror image.
+  for (r = 0; r < matrix_size; r += block_size) {
+    pr_n = (r + block_size < matrix_size ? block_size : matrix_size - r);
+    for (c = r; c < matrix_size; c += block_size) {
+      pc_n = (c + block_size < matrix_size ? block_size : matrix_size - c);
+      ooc_source_tile(source, matrix_size, block_size, r, c, pr_n, pc_n, tile);
+      for (i = 0; i < pr_n; ++i) {
+        for (j = (r == c ? i : 0); j < pc_n; ++j) {
+          aij = tile[i * pc_n + j];
+          y[r + i] += aij * x[c + j];
+          if (r + i != c + j) {
+            y[c + j] += aij * x[r + i];
+          }
+        }
+      }
+    }
+  }
+
+  free(tile);
+  return 0;
+}
+
+size_t cholesky_ooc_min_budget(int matrix_size, int block_size) {
+  return 3 * (size_t)tile_count(matrix_size, block_size) * block_size * block_size *
+         sizeof(double);
+}
+
+cholesky_ooc_t* cholesky_ooc_create(int matrix_size, int block_size, int total_threads,
+                                    const char* file_name, size_t memory_budget) {
+  cholesky_ooc_t* ooc;
+  size_t row_size;
+  int i;
+
+  if (matrix_size <= 0 || block_size <= 0 || block_size > matrix_size || total_threads <= 0 ||
+      memory_budget < cholesky_ooc_min_budget(matrix_size, block_size)) {
+    return NULL;
+  }
+  if (!(ooc = (cholesky_ooc_t*)calloc(1, sizeof(cholesky_ooc_t)))) {
+    return NULL;
+  }
+
+  ooc->matrix_size = matrix_size;
+  ooc->block_size = block_size;
+  ooc->total_threads = total_threads;
+  ooc->tile_rows = tile_count(matrix_size, block_size);
+  ooc->slot = (size_t)block_size * block_size;
+  ooc->fd = -1;
+  pthread_mutex_init(&ooc->stream.lock, NULL);
+  pthread_cond_init(&ooc->stream.changed, NULL);
+
+  // Two row buffers for the stream, the rest of the budget for the panel.
+  row_size = ooc->tile_rows * ooc->slot * sizeof(double);
+  ooc->panel_capacity = (memory_budget - 2 * row_size) / (ooc->slot * sizeof(double));
+  ooc->panel = (double*)tile_matrix_reserve(ooc->panel_capacity * ooc->slot * sizeof(double));
+  ooc->stream.buffers[0] = (double*)tile_matrix_reserve(row_size);
+  ooc->stream.buffers[1] = (double*)tile_matrix_reserve(row_size);
+  ooc->diagonal = (double*)malloc(matrix_size * sizeof(double));
+  ooc->args = (OocArgs*)malloc(total_threads * sizeof(OocArgs));
+  ooc->file_name = strdup(file_name);
+  if (!ooc->panel || !ooc->stream.buffers[0] || !ooc->stream.buffers[1] || !ooc->diagonal ||
+      !ooc->args || !ooc->file_name) {
+    cholesky_ooc_destroy(ooc);
+    return NULL;
+  }
+
+  // Never overwrite an existing file, since the handle removes it at the end.
+  if ((ooc->fd = open(file_name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) {
+    printf("Cannot create %s\n", file_name);
+    cholesky_ooc_destroy(ooc);
+    return NULL;
+  }
+  ooc->stream.fd = ooc->fd;
+  ooc->stream.tile_rows = ooc->tile_rows;
+  ooc->stream.slot = ooc->slot;
+
+  if (thread_pool_init(&ooc->pool, total_threads, 0)) {
+    // The pool cleans up after itself on failure.
+    ooc->pool.total_threads = 0;
+    cholesky_ooc_destroy(ooc);
+    return NULL;
+  }
+  for (i = 0; i < total_threads; ++i) {
+    ooc->args[i].ooc = ooc;
+    ooc->args[i].thread_id = i;
+  }
+  return ooc;
+}
+
+int cholesky_ooc_load(cholesky_ooc_t* ooc, const OocSource* source) {
+  double* row = ooc->stream.buffers[0];
+  int r, c, m = ooc->block_size;
+
+  ooc->factored = 0;
+  for (r = 0; r < ooc->tile_rows; ++r) {
+    for (c = r; c < ooc->tile_rows; ++c) {
+      ooc_source_tile(source, ooc->matrix_size, m, r * m, c * m, ooc_width(ooc, r),
+                      ooc_width(ooc, c), row + (c - r) * ooc->slot);
+    }
+    if (ooc_transfer(ooc->fd, row, (ooc->tile_rows - r) * ooc->slot,
+                     ooc_tile_index(ooc->tile_rows, r, r) * ooc->slot, 1)) {
+      printf("Cannot write %s\n", ooc->file_name);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int cholesky_ooc_factor(cholesky_ooc_t* ooc) {
+  ooc->error = 0;
+  ooc->factored = 0;
+  thread_pool_run(&ooc->pool, cholesky_ooc_threaded, ooc->args, sizeof(OocArgs));
+  if (ooc->error) {
+    return -1;
+  }
+  ooc->factored = 1;
+  return 0;
+}
+
+// Forward substitution R^T * D * W = B, then backward substitution R * X = W,
+// reading every block row of the factor once per direction.
+int cholesky_ooc_solve(cholesky_ooc_t* ooc, double* rhs, int rhs_count) {
+  int k, c, pk_n, error = 0;
+  int m = ooc->block_size;
+  double *row, *xk;
+
+  if (!ooc->factored || ooc_stream_begin(&ooc->stream, 0, ooc->tile_rows, 1, 0)) {
+    return -1;
+  }
+  for (k = 0; k < ooc->tile_rows && !error; ++k) {
+    if (!(row = ooc_stream_next(&ooc->stream))) {
+      error = 1;
+      break;
+    }
+    pk_n = ooc_width(ooc, k);
+    xk = rhs + (size_t)k * m * rhs_count;
+    if (lower_triangle_block_diagonal_solve(pk_n, rhs_count, row, ooc->diagonal + k * m, xk)) {
+      error = 1;
+    }
+    for (c = k + 1; c < ooc->tile_rows && !error; ++c) {
+      main_blocks_diagonal_multiply(pk_n, ooc_width(ooc, c), rhs_count,
+                                    row + (c - k) * ooc->slot, xk, ooc->diagonal + k * m,
+                                    rhs + (size_t)c * m * rhs_count);
+    }
+    ooc_stream_release(&ooc->stream);
+  }
+  ooc_stream_end(&ooc->stream);
+
+  if (error || ooc_stream_begin(&ooc->stream, ooc->tile_rows - 1, ooc->tile_rows, -1, 0)) {
+    return -1;
+  }
+  for (k = ooc->tile_rows - 1; k >= 0 && !error; --k) {
+    if (!(row = ooc_stream_next(&ooc->stream))) {
+      error = 1;
+      break;
+    }
+    pk_n = ooc_width(ooc, k);
+    xk = rhs + (size_t)k * m * rhs_count;
+    for (c = k + 1; c < ooc->tile_rows; ++c) {
+      main_blocks_multiply_subtract(pk_n, ooc_width(ooc, c), rhs_count,
+                                    row + (c - k) * ooc->slot,
+                                    rhs + (size_t)c * m * rhs_count, xk);
+    }
+    if (upper_triangle_block_solve(pk_n, rhs_count, row, xk)) {
+      error = 1;
+    }
+    ooc_stream_release(&ooc->stream);
+  }
+  ooc_stream_end(&ooc->stream);
+
+  return error ? -1 : 0;
+}
+
+double* cholesky_ooc_diagonal(cholesky_ooc_t* ooc) {
+  return ooc->diagonal;
+}
+
+void cholesky_ooc_destroy(cholesky_ooc_t* ooc) {
+  if (!ooc) {
+    return;
+  }
+  if (ooc->pool.total_threads) {
+    thread_pool_destroy(&ooc->pool);
+  }
+  if (ooc->fd >= 0) {
+    close(ooc->fd);
+    unlink(ooc->file_name);
+  }
+  pthread_mutex_destroy(&ooc->stream.lock);
+  pthread_cond_destroy(&ooc->stream.changed);
+  free(ooc->panel);
+  free(ooc->stream.buffers[0]);
+  free(ooc->stream.buffers[1]);
+  free(ooc->diagonal);
+  free(ooc->args);
+  free(ooc->file_name);
+  free(ooc);
+}
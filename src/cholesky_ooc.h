@@ -0,0 +1,80 @@
+#ifndef CHOLESKY_OOC_H
+#define CHOLESKY_OOC_H
+
+#include <stddef.h>
+
+// Out-of-core factorization for matrices larger than memory.
+//
+// The tiles of tile_matrix.h are kept in a file on local disk, in the same
+// block-row order, so that every block row and every run of consecutive block
+// rows is one contiguous extent of the file. The factorization takes as many
+// block rows as fit into the memory budget as a panel, streams every earlier
+// block row of the factor in once and applies it to the panel (left-looking),
+// factors the panel in memory and writes it back. A reader thread fills one
+// of two row buffers while the pool applies the other, so the disk and the
+// cores overlap. The solve streams the factor forwards and then backwards.
+//
+//   cholesky_ooc_t* ooc = cholesky_ooc_create(n, m, threads, "/scratch/a.tiles", budget);
+//   cholesky_ooc_load(ooc, &source);
+//   cholesky_ooc_factor(ooc);
+//   cholesky_ooc_solve(ooc, rhs, rhs_count);
+//   cholesky_ooc_destroy(ooc);
+
+typedef struct _CholeskyOoc cholesky_ooc_t;
+
+// Where the tiles of the input matrix come from.
+typedef enum {
+  OOC_SOURCE_GENERATED = 0,  // The test matrix of fill_matrix, computed per tile.
+  OOC_SOURCE_PACKED = 1,     // Packed upper triangle, e.g. a mapped binary file.
+  OOC_SOURCE_TILES = 2,      // Tile-major with the block size of the handle.
+} OocSourceKind;
+
+typedef struct _OocSource {
+  OocSourceKind kind;  // Layout of data.
+  double* data;        // The matrix, NULL for OOC_SOURCE_GENERATED.
+} OocSource;
+
+// Copies the n x m tile at element (row, column), row <= column, of the
+// source matrix into a tile slot in the layout of tile_matrix.h.
+void ooc_source_tile(const OocSource* source, int matrix_size, int block_size, int row, int column,
+                     int n, int m, double* tile);
+
+// Computes y = A * x for the source matrix one tile at a time, so that the
+// residual of a matrix that is never held in memory can still be checked.
+// Returns: 0 on success, -1 if there is not enough memory for a tile.
+int ooc_source_multiply(const OocSource* source, int matrix_size, int block_size, double* x,
+                        double* y);
+
+// Smallest memory budget in bytes that fits the two row buffers and a panel
+// of one block row.
+size_t cholesky_ooc_min_budget(int matrix_size, int block_size);
+
+// Creates the tile file, which must not exist yet, and starts the threads.
+// memory_budget: Bytes of tile buffers the handle may hold, at least
+//                cholesky_ooc_min_budget().
+// Returns: NULL if the parameters are invalid, the file cannot be created or
+//          there is not enough memory.
+cholesky_ooc_t* cholesky_ooc_create(int matrix_size, int block_size, int total_threads,
+                                    const char* file_name, size_t memory_budget);
+
+// Writes the source matrix to the tile file.
+// Returns: 0 on success, -1 if the file cannot be written.
+int cholesky_ooc_load(cholesky_ooc_t* ooc, const OocSource* source);
+
+// Factors the loaded matrix as R^T * D * R in place in the tile file.
+// Returns: 0 on success, -1 if the method cannot be applied or on I/O errors.
+int cholesky_ooc_factor(cholesky_ooc_t* ooc);
+
+// Solves A * X = B in place for an N x K row-major block of right-hand sides
+// with the factor in the tile file.
+// Returns: 0 on success, -1 if there is no factor, it is singular, or on I/O
+//          errors.
+int cholesky_ooc_solve(cholesky_ooc_t* ooc, double* rhs, int rhs_count);
+
+// Diagonal scaling elements D.
+double* cholesky_ooc_diagonal(cholesky_ooc_t* ooc);
+
+// Stops the threads, removes the tile file and releases the handle.
+void cholesky_ooc_destroy(cholesky_ooc_t* ooc);
+
+#endif  // CHOLESKY_OOC_H
@@ -0,0 +1,153 @@
+#include "cholesky_recursive.h"
+
+#include <stdio.h>
+
+#include "array_op.h"
+#include "tile_matrix.h"
+
+// Leaf tile size. One 48 x 48 tile (18 KB) fits into a 32 KB L1 data cache
+// and the three tiles of an update (54 KB) into L2. 48 is a multiple of the
+// AVX2 6 x 8 register block and of the 16 columns of the AVX-512 14 x 16
+// block, whose rows end in a panel of 6 that is padded with zeros.
+const int RECURSIVE_LEAF_SIZE = 48;
+
+// State of one thread, shared by the recursive calls.
+typedef struct _RecursiveContext {
+  int matrix_size;                   // Total size of the matrix (N x N).
+  int block_size;                    // Size of the leaf tiles (M x M).
+  int thread_id;                     // Unique ID for the current thread.
+  double* matrix;                    // Tile-major matrix.
+  double* diagonal;                  // Diagonal scaling elements.
+  ThreadBarrier* barrier;            // Synchronization barrier.
+  int* error;                        // Shared error flag.
+  const Distribution* distribution;  // Owner of every tile.
+  Trace* trace;                      // Timeline to record, or NULL.
+} RecursiveContext;
+
+int cholesky_recursive_leaf_size(int matrix_size) {
+  return RECURSIVE_LEAF_SIZE < matrix_size ? RECURSIVE_LEAF_SIZE : matrix_size;
+}
+
+static double* recursive_tile(RecursiveContext* ctx, int bi, int bj) {
+  return tile_block(ctx->matrix, bi * ctx->block_size, bj * ctx->block_size, ctx->matrix_size,
+                    ctx->block_size);
+}
+
+// Width of the tiles in block row or column b.
+static int recursive_width(RecursiveContext* ctx, int b) {
+  int i = b * ctx->block_size;
+  return (i + ctx->block_size < ctx->matrix_size ? ctx->block_size : ctx->matrix_size - i);
+}
+
+// C(r, c) -= R(k, r)^T * D_k * R(k, c) for tile rows [r0, r1), tile columns
+// [c0, c1) and block rows [k0, k1), upper triangle only. The largest of the
+// three ranges is halved until a single tile product remains.
+static void recursive_update(RecursiveContext* ctx, int r0, int r1, int c0, int c1, int k0,
+                             int k1) {
+  int rn = r1 - r0, cn = c1 - c0, kn = k1 - k0;
+
+  if (r0 >= c1) {
+    // Entirely below the diagonal.
+    return;
+  }
+
+  if (rn == 1 && cn == 1 && kn == 1) {
+    if (tile_owner(ctx->distribution, r0, c0) == ctx->thread_id) {
+      trace_begin(ctx->trace, ctx->thread_id);
+      main_blocks_diagonal_multiply(recursive_width(ctx, k0), recursive_width(ctx, r0),
+                                    recursive_width(ctx, c0), recursive_tile(ctx, k0, r0),
+                                    recursive_tile(ctx, k0, c0),
+                                    ctx->diagonal + k0 * ctx->block_size,
+                                    recursive_tile(ctx, r0, c0));
+      trace_end(ctx->trace, ctx->thread_id, TRACE_UPDATE, k0,
+                2.0 * recursive_width(ctx, k0) * recursive_width(ctx, r0) *
+                    recursive_width(ctx, c0));
+    }
+  } else if (kn >= rn && kn >= cn) {
+    recursive_update(ctx, r0, r1, c0, c1, k0, k0 + kn / 2);
+    recursive_update(ctx, r0, r1, c0, c1, k0 + kn / 2, k1);
+  } else if (rn >= cn) {
+    recursive_update(ctx, r0, r0 + rn / 2, c0, c1, k0, k1);
+    recursive_update(ctx, r0 + rn / 2, r1, c0, c1, k0, k1);
+  } else {
+    recursive_update(ctx, r0, r1, c0, c0 + cn / 2, k0, k1);
+    recursive_update(ctx, r0, r1, c0 + cn / 2, c1, k0, k1);
+  }
+}
+
+// Solves R^T * D * X = A in place for the tiles of block rows [k0, k1) and
+// tile columns [c0, c1), where R is the factored diagonal part of [k0, k1).
+static void recursive_solve(RecursiveContext* ctx, int k0, int k1, int c0, int c1) {
+  int c, mid;
+
+  if (k1 - k0 == 1) {
+    for (c = c0; c < c1; ++c) {
+      if (tile_owner(ctx->distribution, k0, c) == ctx->thread_id) {
+        trace_begin(ctx->trace, ctx->thread_id);
+        lower_triangle_block_diagonal_solve(recursive_width(ctx, k0), recursive_width(ctx, c),
+                                            recursive_tile(ctx, k0, k0),
+                                            ctx->diagonal + k0 * ctx->block_size,
+                                            recursive_tile(ctx, k0, c));
+        trace_end(ctx->trace, ctx->thread_id, TRACE_SCALE, k0,
+                  1.0 * recursive_width(ctx, k0) * recursive_width(ctx, k0) *
+                      recursive_width(ctx, c));
+      }
+    }
+    trace_barrier_wait(ctx->trace, ctx->thread_id, ctx->barrier, k0);
+    return;
+  }
+
+  mid = k0 + (k1 - k0) / 2;
+  recursive_solve(ctx, k0, mid, c0, c1);
+  recursive_update(ctx, mid, k1, c0, c1, k0, mid);
+  trace_barrier_wait(ctx->trace, ctx->thread_id, ctx->barrier, mid);
+  recursive_solve(ctx, mid, k1, c0, c1);
+}
+
+// Factors the diagonal part of block rows [r0, r1).
+static int recursive_factor(RecursiveContext* ctx, int r0, int r1) {
+  int mid, n;
+  double* block;
+
+  if (r1 - r0 == 1) {
+    if (tile_owner(ctx->distribution, r0, r0) == ctx->thread_id) {
+      n = recursive_width(ctx, r0);
+      block = recursive_tile(ctx, r0, r0);
+      trace_begin(ctx->trace, ctx->thread_id);
+      if (cholesky_for_block(n, block, ctx->diagonal + r0 * ctx->block_size)) {
+        printf("Cholesky method with this block size cannot be applied\n");
+        *ctx->error = 1;
+      }
+      trace_end(ctx->trace, ctx->thread_id, TRACE_FACTOR, r0, 1.0 / 3.0 * n * n * n);
+    }
+    trace_barrier_wait(ctx->trace, ctx->thread_id, ctx->barrier, r0);
+    return *ctx->error ? -1 : 0;
+  }
+
+  mid = r0 + (r1 - r0) / 2;
+  if (recursive_factor(ctx, r0, mid)) {
+    return -1;
+  }
+  recursive_solve(ctx, r0, mid, mid, r1);
+  recursive_update(ctx, mid, r1, mid, r1, r0, mid);
+  trace_barrier_wait(ctx->trace, ctx->thread_id, ctx->barrier, mid);
+  return recursive_factor(ctx, mid, r1);
+}
+
+int cholesky_recursive(int matrix_size, double* matrix, double* diagonal, int block_size,
+                       int thread_id, ThreadBarrier* barrier, int* error,
+                       const Distribution* distribution, Trace* trace) {
+  RecursiveContext ctx;
+
+  ctx.matrix_size = matrix_size;
+  ctx.block_size = block_size;
+  ctx.thread_id = thread_id;
+  ctx.matrix = matrix;
+  ctx.diagonal = diagonal;
+  ctx.barrier = barrier;
+  ctx.error = error;
+  ctx.distribution = distribution;
+  ctx.trace = trace;
+
+  return recursive_factor(&ctx, 0, tile_count(matrix_size, block_size));
+}
@@ -0,0 +1,31 @@
+#ifndef CHOLESKY_RECURSIVE_H
+#define CHOLESKY_RECURSIVE_H
+
+#include "distribution.h"
+#include "thread_barrier.h"
+#include "trace.h"
+
+// Cache-oblivious block Cholesky decomposition.
+//
+// The tile range is halved recursively: factor the leading half, solve for
+// the off-diagonal half, update the trailing half and factor it. Updates are
+// split along their largest dimension down to single tiles, so every level
+// of the cache sees a working set that fits it at some depth of the
+// recursion, whatever its size. Tiles are small and fixed, see
+// cholesky_recursive_leaf_size, which removes the block size as a tuning
+// parameter.
+//
+// Every thread walks the same recursion and applies the leaf operations on
+// the tiles it owns in the distribution, with a barrier between dependent
+// phases.
+
+// Block size the matrix has to be stored with for the recursive engine.
+int cholesky_recursive_leaf_size(int matrix_size);
+
+// trace: Timeline of the leaf operations and barrier waits, or NULL.
+// Returns: 0 on success, -1 if a diagonal block cannot be decomposed.
+int cholesky_recursive(int matrix_size, double* matrix, double* diagonal, int block_size,
+                       int thread_id, ThreadBarrier* barrier, int* error,
+                       const Distribution* distribution, Trace* trace);
+
+#endif  // CHOLESKY_RECURSIVE_H
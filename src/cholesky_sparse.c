@@ -0,0 +1,861 @@
+#include "cholesky_sparse.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_op.h"
+#include "sparse_order.h"
+#include "thread_pool.h"
+#include "timer.h"
+
+// The elimination tree is cut into subtrees until none of them holds more
+// than 1 / (SPARSE_SUBTREES_PER_THREAD * T) of the work, so that the threads
+// can balance the subtrees among themselves.
+const int SPARSE_SUBTREES_PER_THREAD = 4;
+
+// A supernode is merged into its parent while the explicit zeros this stores
+// in its tiles stay below this fraction of them.
+const double SPARSE_RELAX_ZEROS = 0.2;
+
+// Per-thread arguments of the factorization.
+typedef struct _SparseArgs {
+  cholesky_sparse_t* sparse;  // Handle being factored.
+  int thread_id;              // Unique ID for the current thread.
+  double* workspace;          // Operands and result of one update.
+  int* relative;              // Positions of the columns of an update in its target.
+  double cpu_time;            // CPU time of the last factorization in seconds.
+} SparseArgs;
+
+// Subtree handed to a thread as one task.
+typedef struct _SparseTask {
+  double work;  // Operations of the whole subtree.
+  int root;     // Root supernode of the subtree.
+} SparseTask;
+
+struct _CholeskySparse {
+  int matrix_size;              // Total size of the matrix (N x N).
+  int block_size;               // Widest supernode.
+  int total_threads;            // Number of threads in the pool.
+  int* order;                   // Original index of the row eliminated k-th.
+  int* position;                // Elimination step of every original row.
+  int supernode_count;          // Number of supernodes.
+  int* first_column;            // First row of R of every supernode, count + 1 entries.
+  int* supernode_of;            // Supernode of every row of R.
+  int* parent;                  // Parent supernode, -1 for roots.
+  size_t* index_start;          // Start of every supernode in indices, count + 1 entries.
+  int* indices;                 // Ascending column indices of every supernode's rows.
+  size_t* value_start;          // Start of every supernode in values, count + 1 entries.
+  double* values;               // Diagonal tile, then off-diagonal tile, of every supernode.
+  double* diagonal;             // Diagonal scaling elements, in elimination order.
+  int max_rows;                 // Widest off-diagonal tile.
+  size_t nonzeros;              // Nonzeros of R.
+  double flops;                 // Operations of the factorization.
+  int* subtree_first;           // First supernode of a task's subtree, -1 for other supernodes.
+  unsigned char* shared;        // Non-zero for the supernodes above the subtree tasks.
+  int* pending;                 // Children of every shared supernode not yet factored.
+  int task_count;               // Number of subtree tasks.
+  int shared_count;             // Number of shared supernodes.
+  int* tasks;                   // Roots of the subtree tasks, lightest first.
+  int* ready;                   // Stack of tasks ready to run.
+  int ready_count;              // Entries of ready.
+  int finished;                 // Tasks and shared supernodes factored.
+  pthread_mutex_t* locks;       // Serializes the updates of every shared supernode.
+  int lock_count;               // Initialized entries of locks.
+  pthread_mutex_t queue_lock;   // Protects ready, pending, finished and error.
+  pthread_cond_t queue_change;  // Signals new ready tasks, the end or an error.
+  const SparseMatrix* matrix;   // Values of the running factorization.
+  SparseArgs* args;             // Per-thread arguments of the factorization.
+  ThreadPool pool;              // Worker threads.
+  int error;                    // Error flag of the last factorization.
+  int factored;                 // Non-zero after a successful factorization.
+};
+
+static int int_compare(const void* a, const void* b) {
+  int x = *(const int*)a, y = *(const int*)b;
+  return x < y ? -1 : x > y;
+}
+
+static int task_compare(const void* a, const void* b) {
+  double x = ((const SparseTask*)a)->work, y = ((const SparseTask*)b)->work;
+  return x < y ? -1 : x > y;
+}
+
+// Elimination tree of the matrix in the order given by order and position
+// (Liu's algorithm with path compression).
+// parent: Output, parent of every row of R, -1 for roots.
+// ancestor: Scratch of N entries.
+static void sparse_etree(const SparseMatrix* a, const int* order, const int* position, int* parent,
+                         int* ancestor) {
+  int n = a->matrix_size;
+  int k, i, next;
+  size_t p;
+
+  for (k = 0; k < n; ++k) {
+    parent[k] = -1;
+    ancestor[k] = -1;
+    for (p = a->row_start[order[k]]; p < a->row_start[order[k] + 1]; ++p) {
+      for (i = position[a->columns[p]]; i != -1 && i < k; i = next) {
+        next = ancestor[i];
+        ancestor[i] = k;
+        if (next == -1) {
+          parent[i] = k;
+        }
+      }
+    }
+  }
+}
+
+// Postorder of a forest: post[k] is the node visited k-th, children in
+// ascending order before their parent.
+// Returns: 0 on success, -1 if there is not enough memory.
+static int sparse_postorder(int n, const int* parent, int* post) {
+  int* head = (int*)malloc(n * sizeof(int));
+  int* next = (int*)malloc(n * sizeof(int));
+  int* stack = (int*)malloc(n * sizeof(int));
+  int j, v, c, top, k = 0;
+
+  if (!head || !next || !stack) {
+    free(head);
+    free(next);
+    free(stack);
+    return -1;
+  }
+
+  for (j = 0; j < n; ++j) {
+    head[j] = -1;
+  }
+  for (j = n - 1; j >= 0; --j) {
+    if (parent[j] >= 0) {
+      next[j] = head[parent[j]];
+      head[parent[j]] = j;
+    }
+  }
+
+  for (j = 0; j < n; ++j) {
+    if (parent[j] >= 0) {
+      continue;
+    }
+    top = 0;
+    stack[top++] = j;
+    while (top) {
+      v = stack[top - 1];
+      if ((c = head[v]) != -1) {
+        head[v] = next[c];
+        stack[top++] = c;
+      } else {
+        --top;
+        post[k++] = v;
+      }
+    }
+  }
+
+  free(head);
+  free(next);
+  free(stack);
+  return 0;
+}
+
+// Nonzeros of every row of R, diagonal included, from the row subtrees of
+// the elimination tree: row k of A reaches every node on the tree paths
+// from its entries up to k.
+// mark: Scratch of N entries.
+static void sparse_row_counts(const SparseMatrix* a, const int* order, const int* position,
+                              const int* parent, int* count, int* mark) {
+  int n = a->matrix_size;
+  int k, j;
+  size_t p;
+
+  for (k = 0; k < n; ++k) {
+    count[k] = 1;
+    mark[k] = -1;
+  }
+  for (k = 0; k < n; ++k) {
+    mark[k] = k;
+    for (p = a->row_start[order[k]]; p < a->row_start[order[k] + 1]; ++p) {
+      for (j = position[a->columns[p]]; j < k && mark[j] != k; j = parent[j]) {
+        ++count[j];
+        mark[j] = k;
+      }
+    }
+  }
+}
+
+// Relaxed amalgamation of the fundamental supernodes: a supernode absorbs the
+// one right before it, its last child in the postorder, if the merged one is
+// at most block_size wide and less than SPARSE_RELAX_ZEROS of its tiles are
+// explicit zeros. The structure of a row contains that of its children, so
+// the merged supernode keeps the off-diagonal indices of the parent. Without
+// it most supernodes of a nested dissection ordering are a single row.
+static void sparse_amalgamate(cholesky_sparse_t* sparse, const int* column_parent,
+                              const int* counts) {
+  int count = 0;
+  int s, f, w, r, k, mw;
+  size_t nz, merged_nz = 0, stored;
+
+  for (s = 0; s < sparse->supernode_count; ++s) {
+    f = sparse->first_column[s];
+    w = sparse->first_column[s + 1] - f;
+    r = counts[f + w - 1] - 1;
+    for (nz = 0, k = f; k < f + w; ++k) {
+      nz += counts[k];
+    }
+    if (count && column_parent[f - 1] >= f && column_parent[f - 1] < f + w) {
+      mw = f + w - sparse->first_column[count - 1];
+      stored = (size_t)mw * (mw + 1) / 2 + (size_t)mw * r;
+      if (mw <= sparse->block_size && stored - merged_nz - nz < SPARSE_RELAX_ZEROS * stored) {
+        merged_nz += nz;
+        continue;
+      }
+    }
+    // count <= s, so the entries still to be read are intact.
+    sparse->first_column[count++] = f;
+    merged_nz = nz;
+  }
+  sparse->first_column[count] = sparse->matrix_size;
+  sparse->supernode_count = count;
+  for (s = 0; s < count; ++s) {
+    for (k = sparse->first_column[s]; k < sparse->first_column[s + 1]; ++k) {
+      sparse->supernode_of[k] = s;
+    }
+  }
+}
+
+// Width and off-diagonal width of supernode s.
+static void sparse_shape(cholesky_sparse_t* sparse, int s, int* w, int* r) {
+  *w = sparse->first_column[s + 1] - sparse->first_column[s];
+  *r = (int)(sparse->index_start[s + 1] - sparse->index_start[s]) - *w;
+}
+
+// Collects the column indices of every supernode: its own columns, then the
+// entries of A right of them and the indices of its children, sorted.
+// Returns: 0 on success, -1 if there is not enough memory.
+static int sparse_structure(cholesky_sparse_t* sparse, const SparseMatrix* a) {
+  int count = sparse->supernode_count;
+  int* head = (int*)malloc(count * sizeof(int));
+  int* next = (int*)malloc(count * sizeof(int));
+  int* marker = (int*)malloc(sparse->matrix_size * sizeof(int));
+  int s, t, c, q, f, last, w, tw, tr;
+  int* idx;
+  size_t p, length;
+
+  if (!head || !next || !marker) {
+    free(head);
+    free(next);
+    free(marker);
+    return -1;
+  }
+  for (s = 0; s < count; ++s) {
+    head[s] = -1;
+  }
+  for (s = count - 1; s >= 0; --s) {
+    if (sparse->parent[s] >= 0) {
+      next[s] = head[sparse->parent[s]];
+      head[sparse->parent[s]] = s;
+    }
+  }
+  for (c = 0; c < sparse->matrix_size; ++c) {
+    marker[c] = -1;
+  }
+
+  for (s = 0; s < count; ++s) {
+    f = sparse->first_column[s];
+    last = sparse->first_column[s + 1] - 1;
+    w = last - f + 1;
+    idx = sparse->indices + sparse->index_start[s];
+    length = 0;
+    for (c = f; c <= last; ++c) {
+      idx[length++] = c;
+      marker[c] = s;
+    }
+    for (c = f; c <= last; ++c) {
+      for (p = a->row_start[sparse->order[c]]; p < a->row_start[sparse->order[c] + 1]; ++p) {
+        q = sparse->position[a->columns[p]];
+        if (q > last && marker[q] != s) {
+          marker[q] = s;
+          idx[length++] = q;
+        }
+      }
+    }
+    for (t = head[s]; t != -1; t = next[t]) {
+      sparse_shape(sparse, t, &tw, &tr);
+      for (c = tw; c < tw + tr; ++c) {
+        q = sparse->indices[sparse->index_start[t] + c];
+        if (marker[q] != s) {
+          marker[q] = s;
+          idx[length++] = q;
+        }
+      }
+    }
+    qsort(idx + w, length - w, sizeof(int), int_compare);
+  }
+
+  free(head);
+  free(next);
+  free(marker);
+  return 0;
+}
+
+// Cuts the supernodal elimination tree into subtree tasks, splitting the
+// heaviest subtree while it holds too much of the work. The supernodes that
+// were split remain above the tasks and become shared.
+// Returns: 0 on success, -1 if there is not enough memory.
+static int sparse_schedule(cholesky_sparse_t* sparse) {
+  int count = sparse->supernode_count;
+  double* work = (double*)calloc(count, sizeof(double));
+  int* size = (int*)calloc(count, sizeof(int));
+  int* set = (int*)malloc(count * sizeof(int));
+  SparseTask* tasks = (SparseTask*)malloc(count * sizeof(SparseTask));
+  int s, p, k, w, r, heaviest, set_count = 0;
+  double threshold;
+
+  if (!work || !size || !set || !tasks) {
+    free(work);
+    free(size);
+    free(set);
+    free(tasks);
+    return -1;
+  }
+
+  // Children come before their parents in a postorder.
+  for (s = 0; s < count; ++s) {
+    sparse_shape(sparse, s, &w, &r);
+    work[s] += (double)w * w * w / 3 + (double)w * w * r + (double)w * r * r;
+    size[s] += 1;
+    if ((p = sparse->parent[s]) >= 0) {
+      work[p] += work[s];
+      size[p] += size[s];
+    } else {
+      set[set_count++] = s;
+      sparse->flops += work[s];
+    }
+  }
+
+  threshold = sparse->flops / (SPARSE_SUBTREES_PER_THREAD * sparse->total_threads);
+  while (sparse->total_threads > 1) {
+    heaviest = -1;
+    for (k = 0; k < set_count; ++k) {
+      s = set[k];
+      if (work[s] > threshold && size[s] > 1 && (heaviest < 0 || work[s] > work[set[heaviest]])) {
+        heaviest = k;
+      }
+    }
+    if (heaviest < 0) {
+      break;
+    }
+    s = set[heaviest];
+    set[heaviest] = set[--set_count];
+    sparse->shared[s] = 1;
+    ++sparse->shared_count;
+    // The children of s are exactly the nodes below s whose parent it is.
+    for (p = s - size[s] + 1; p < s; ++p) {
+      if (sparse->parent[p] == s) {
+        set[set_count++] = p;
+      }
+    }
+  }
+
+  sparse->task_count = set_count;
+  for (k = 0; k < set_count; ++k) {
+    tasks[k].work = work[set[k]];
+    tasks[k].root = set[k];
+  }
+  qsort(tasks, set_count, sizeof(SparseTask), task_compare);
+  for (s = 0; s < count; ++s) {
+    sparse->subtree_first[s] = -1;
+  }
+  for (k = 0; k < set_count; ++k) {
+    s = tasks[k].root;
+    sparse->tasks[k] = s;
+    sparse->subtree_first[s] = s - size[s] + 1;
+  }
+
+  free(work);
+  free(size);
+  free(set);
+  free(tasks);
+  return 0;
+}
+
+// Loads the entries of A into the tiles of supernode s.
+static void sparse_assemble(cholesky_sparse_t* sparse, int s) {
+  const SparseMatrix* a = sparse->matrix;
+  int f = sparse->first_column[s];
+  int* idx = sparse->indices + sparse->index_start[s];
+  double* tiles = sparse->values + sparse->value_start[s];
+  int w, r, c, q, lo, hi, mid, pos;
+  size_t p;
+
+  sparse_shape(sparse, s, &w, &r);
+  memset(tiles, 0, ((size_t)w * w + (size_t)w * r) * sizeof(double));
+  for (c = f; c < f + w; ++c) {
+    for (p = a->row_start[sparse->order[c]]; p < a->row_start[sparse->order[c] + 1]; ++p) {
+      q = sparse->position[a->columns[p]];
+      if (q < c) {
+        continue;
+      }
+      if (q < f + w) {
+        tiles[(c - f) * w + q - f] = a->values[p];
+        continue;
+      }
+      lo = w;
+      hi = w + r;
+      while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (idx[mid] < q) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      pos = lo - w;
+      tiles[(size_t)w * w + (size_t)(c - f) * r + pos] = a->values[p];
+    }
+  }
+}
+
+// Factors supernode s and adds its update to the ancestors, one target
+// supernode at a time.
+// Returns: 0 on success, -1 if decomposition cannot be applied.
+static int sparse_factor_supernode(SparseArgs* pa, int s) {
+  cholesky_sparse_t* sparse = pa->sparse;
+  int f = sparse->first_column[s];
+  int* idx = sparse->indices + sparse->index_start[s];
+  double* diag = sparse->values + sparse->value_start[s];
+  double* d = sparse->diagonal + f;
+  double *off, *a, *b, *c, *target;
+  int w, r, g0, g1, gm, cols, k, t, tw, tr, q, row, pos;
+  int* tidx;
+
+  sparse_shape(sparse, s, &w, &r);
+  off = diag + (size_t)w * w;
+  if (cholesky_for_block(w, diag, d)) {
+    return -1;
+  }
+  if (!r) {
+    return 0;
+  }
+  if (lower_triangle_block_diagonal_solve(w, r, diag, d, off)) {
+    return -1;
+  }
+
+  // Columns g0..g1 of the off-diagonal tile are rows of supernode t, which
+  // receives the rows g0..g1 of the update for columns g0..r.
+  a = pa->workspace;
+  b = a + (size_t)sparse->block_size * sparse->block_size;
+  c = b + (size_t)sparse->block_size * sparse->max_rows;
+  for (g0 = 0; g0 < r; g0 = g1) {
+    t = sparse->supernode_of[idx[w + g0]];
+    for (g1 = g0 + 1; g1 < r && sparse->supernode_of[idx[w + g1]] == t; ++g1) {
+    }
+    gm = g1 - g0;
+    cols = r - g0;
+    for (k = 0; k < w; ++k) {
+      memcpy(a + k * gm, off + (size_t)k * r + g0, gm * sizeof(double));
+      memcpy(b + k * cols, off + (size_t)k * r + g0, cols * sizeof(double));
+    }
+    memset(c, 0, (size_t)gm * cols * sizeof(double));
+    main_blocks_diagonal_multiply(w, gm, cols, a, b, d, c);
+
+    // The indices of s from g0 on are a subset of those of t.
+    tidx = sparse->indices + sparse->index_start[t];
+    for (k = 0, q = 0; k < cols; ++k) {
+      while (tidx[q] != idx[w + g0 + k]) {
+        ++q;
+      }
+      pa->relative[k] = q;
+    }
+
+    sparse_shape(sparse, t, &tw, &tr);
+    target = sparse->values + sparse->value_start[t];
+    if (sparse->shared[t]) {
+      pthread_mutex_lock(&sparse->locks[t]);
+    }
+    for (row = 0; row < gm; ++row) {
+      for (k = row; k < cols; ++k) {
+        pos = pa->relative[k];
+        if (pos < tw) {
+          target[pa->relative[row] * tw + pos] += c[row * cols + k];
+        } else {
+          target[(size_t)tw * tw + (size_t)pa->relative[row] * tr + pos - tw] +=
+              c[row * cols + k];
+        }
+      }
+    }
+    if (sparse->shared[t]) {
+      pthread_mutex_unlock(&sparse->locks[t]);
+    }
+  }
+  return 0;
+}
+
+// Entry point for each worker thread.
+static void* cholesky_sparse_threaded(void* ptr) {
+  double timer = get_time_pthread();
+  SparseArgs* pa = (SparseArgs*)ptr;
+  cholesky_sparse_t* sparse = pa->sparse;
+  int s, t, first, failed;
+
+  for (s = pa->thread_id; s < sparse->supernode_count; s += sparse->total_threads) {
+    sparse_assemble(sparse, s);
+  }
+  thread_barrier_wait(&sparse->pool.barrier);
+
+  for (;;) {
+    pthread_mutex_lock(&sparse->queue_lock);
+    while (!sparse->ready_count && !sparse->error &&
+           sparse->finished < sparse->task_count + sparse->shared_count) {
+      pthread_cond_wait(&sparse->queue_change, &sparse->queue_lock);
+    }
+    if (!sparse->ready_count || sparse->error) {
+      pthread_mutex_unlock(&sparse->queue_lock);
+      break;
+    }
+    s = sparse->ready[--sparse->ready_count];
+    pthread_mutex_unlock(&sparse->queue_lock);
+
+    // A task factors its whole subtree, which is contiguous in postorder.
+    first = (sparse->subtree_first[s] >= 0 ? sparse->subtree_first[s] : s);
+    failed = 0;
+    for (t = first; t <= s && !failed; ++t) {
+      failed = sparse_factor_supernode(pa, t);
+    }
+
+    pthread_mutex_lock(&sparse->queue_lock);
+    if (failed) {
+      if (!sparse->error) {
+        printf("Cholesky method with this block size cannot be applied\n");
+      }
+      sparse->error = 1;
+    } else {
+      ++sparse->finished;
+      t = sparse->parent[s];
+      if (t >= 0 && !--sparse->pending[t]) {
+        sparse->ready[sparse->ready_count++] = t;
+      }
+    }
+    pthread_cond_broadcast(&sparse->queue_change);
+    pthread_mutex_unlock(&sparse->queue_lock);
+  }
+
+  pa->cpu_time = (get_time_pthread() - timer) / (1000.0 * 1000.0 * 1000.0);
+  return NULL;
+}
+
+// Orders the matrix and finds the supernodes and their parents.
+// Returns: 0 on success, -1 if there is not enough memory.
+static int sparse_analyse(cholesky_sparse_t* sparse, const SparseMatrix* matrix) {
+  int n = matrix->matrix_size;
+  int* order = (int*)malloc(n * sizeof(int));
+  int* post = (int*)malloc(n * sizeof(int));
+  int* column_parent = (int*)malloc(n * sizeof(int));
+  int* counts = (int*)malloc(n * sizeof(int));
+  int* scratch = (int*)malloc(n * sizeof(int));
+  int k, s, w, r, result = -1;
+
+  if (!order || !post || !column_parent || !counts || !scratch ||
+      sparse_nested_dissection(matrix, order)) {
+    goto cleanup;
+  }
+
+  // Postordering the elimination tree keeps every subtree, and so every
+  // supernode, contiguous without changing the fill.
+  for (k = 0; k < n; ++k) {
+    sparse->position[order[k]] = k;
+  }
+  sparse_etree(matrix, order, sparse->position, column_parent, scratch);
+  if (sparse_postorder(n, column_parent, post)) {
+    goto cleanup;
+  }
+  for (k = 0; k < n; ++k) {
+    sparse->order[k] = order[post[k]];
+  }
+  for (k = 0; k < n; ++k) {
+    sparse->position[sparse->order[k]] = k;
+  }
+  sparse_etree(matrix, sparse->order, sparse->position, column_parent, scratch);
+  sparse_row_counts(matrix, sparse->order, sparse->position, column_parent, counts, scratch);
+
+  // Row k continues the supernode of row k - 1 if it is its parent and the
+  // structure of k - 1 is that of k plus k - 1 itself.
+  for (k = 0; k < n; ++k) {
+    s = sparse->supernode_count;
+    if (k && column_parent[k - 1] == k && counts[k - 1] == counts[k] + 1 &&
+        k - sparse->first_column[s - 1] < sparse->block_size) {
+      sparse->supernode_of[k] = s - 1;
+    } else {
+      sparse->first_column[s] = k;
+      sparse->supernode_of[k] = s;
+      ++sparse->supernode_count;
+    }
+  }
+  sparse->first_column[sparse->supernode_count] = n;
+  sparse_amalgamate(sparse, column_parent, counts);
+  s = sparse->supernode_count;
+
+  sparse->parent = (int*)malloc(s * sizeof(int));
+  sparse->index_start = (size_t*)malloc((s + 1) * sizeof(size_t));
+  sparse->value_start = (size_t*)malloc((s + 1) * sizeof(size_t));
+  if (!sparse->parent || !sparse->index_start || !sparse->value_start) {
+    goto cleanup;
+  }
+  sparse->index_start[0] = 0;
+  sparse->value_start[0] = 0;
+  for (s = 0; s < sparse->supernode_count; ++s) {
+    k = sparse->first_column[s + 1] - 1;
+    sparse->parent[s] = (column_parent[k] >= 0 ? sparse->supernode_of[column_parent[k]] : -1);
+    w = k + 1 - sparse->first_column[s];
+    r = counts[k] - 1;
+    sparse->index_start[s + 1] = sparse->index_start[s] + w + r;
+    sparse->value_start[s + 1] = sparse->value_start[s] + (size_t)w * w + (size_t)w * r;
+    sparse->max_rows = (r > sparse->max_rows ? r : sparse->max_rows);
+    sparse->nonzeros += (size_t)w * (w + 1) / 2 + (size_t)w * r;
+  }
+  result = 0;
+
+cleanup:
+  free(order);
+  free(post);
+  free(column_parent);
+  free(counts);
+  free(scratch);
+  return result;
+}
+
+cholesky_sparse_t* cholesky_sparse_create(const SparseMatrix* matrix, int block_size,
+                                          int total_threads) {
+  int n = matrix->matrix_size;
+  cholesky_sparse_t* sparse;
+  int i, s;
+  size_t workspace;
+
+  if (n <= 0 || block_size <= 0 || total_threads <= 0) {
+    return NULL;
+  }
+  if (!(sparse = (cholesky_sparse_t*)calloc(1, sizeof(cholesky_sparse_t)))) {
+    return NULL;
+  }
+  sparse->matrix_size = n;
+  sparse->block_size = block_size;
+  sparse->total_threads = total_threads;
+  pthread_mutex_init(&sparse->queue_lock, NULL);
+  pthread_cond_init(&sparse->queue_change, NULL);
+
+  sparse->order = (int*)malloc(n * sizeof(int));
+  sparse->position = (int*)malloc(n * sizeof(int));
+  sparse->supernode_of = (int*)malloc(n * sizeof(int));
+  sparse->first_column = (int*)malloc((n + 1) * sizeof(int));
+  sparse->diagonal = (double*)malloc(n * sizeof(double));
+  if (!sparse->order || !sparse->position || !sparse->supernode_of || !sparse->first_column ||
+      !sparse->diagonal || sparse_analyse(sparse, matrix)) {
+    cholesky_sparse_destroy(sparse);
+    return NULL;
+  }
+
+  s = sparse->supernode_count;
+  sparse->indices = (int*)malloc(sparse->index_start[s] * sizeof(int));
+  sparse->values = (double*)malloc(sparse->value_start[s] * sizeof(double));
+  sparse->subtree_first = (int*)malloc(s * sizeof(int));
+  sparse->shared = (unsigned char*)calloc(s, sizeof(unsigned char));
+  sparse->pending = (int*)calloc(s, sizeof(int));
+  sparse->tasks = (int*)malloc(s * sizeof(int));
+  sparse->ready = (int*)malloc(s * sizeof(int));
+  sparse->locks = (pthread_mutex_t*)malloc(s * sizeof(pthread_mutex_t));
+  sparse->args = (SparseArgs*)calloc(total_threads, sizeof(SparseArgs));
+  if (!sparse->indices || !sparse->values || !sparse->subtree_first || !sparse->shared ||
+      !sparse->pending || !sparse->tasks || !sparse->ready || !sparse->locks || !sparse->args ||
+      sparse_structure(sparse, matrix) || sparse_schedule(sparse)) {
+    cholesky_sparse_destroy(sparse);
+    return NULL;
+  }
+  for (sparse->lock_count = 0; sparse->lock_count < s; ++sparse->lock_count) {
+    pthread_mutex_init(&sparse->locks[sparse->lock_count], NULL);
+  }
+
+  // Every thread needs A and B of an update, at most M x M and M x R, and
+  // the M x R result.
+  workspace = (size_t)block_size * block_size + 2 * (size_t)block_size * sparse->max_rows;
+  for (i = 0; i < total_threads; ++i) {
+    sparse->args[i].sparse = sparse;
+    sparse->args[i].thread_id = i;
+    sparse->args[i].workspace = (double*)malloc(workspace * sizeof(double));
+    sparse->args[i].relative = (int*)malloc((sparse->max_rows + 1) * sizeof(int));
+    if (!sparse->args[i].workspace || !sparse->args[i].relative) {
+      cholesky_sparse_destroy(sparse);
+      return NULL;
+    }
+  }
+
+  if (thread_pool_init(&sparse->pool, total_threads, 0)) {
+    // The pool cleans up after itself on failure.
+    sparse->pool.total_threads = 0;
+    cholesky_sparse_destroy(sparse);
+    return NULL;
+  }
+  return sparse;
+}
+
+int cholesky_sparse_factor(cholesky_sparse_t* sparse, const SparseMatrix* matrix) {
+  int k, s;
+
+  if (matrix->matrix_size != sparse->matrix_size) {
+    return -1;
+  }
+  sparse->matrix = matrix;
+  sparse->error = 0;
+  sparse->factored = 0;
+  sparse->finished = 0;
+  for (s = 0; s < sparse->supernode_count; ++s) {
+    sparse->pending[s] = 0;
+  }
+  for (s = 0; s < sparse->supernode_count; ++s) {
+    if (sparse->parent[s] >= 0 && sparse->shared[sparse->parent[s]]) {
+      ++sparse->pending[sparse->parent[s]];
+    }
+  }
+  // The heaviest subtree starts first; shared supernodes follow their
+  // children.
+  for (k = 0; k < sparse->task_count; ++k) {
+    sparse->ready[k] = sparse->tasks[k];
+  }
+  sparse->ready_count = sparse->task_count;
+
+  thread_pool_run(&sparse->pool, cholesky_sparse_threaded, sparse->args, sizeof(SparseArgs));
+  sparse->matrix = NULL;
+  if (sparse->error) {
+    return -1;
+  }
+  sparse->factored = 1;
+  return 0;
+}
+
+// Forward substitution R^T * D * W = P * B, then backward substitution
+// R * Y = W, one supernode at a time, and X = P^T * Y.
+int cholesky_sparse_solve(cholesky_sparse_t* sparse, double* rhs, int rhs_count) {
+  int n = sparse->matrix_size;
+  double* x = (double*)malloc((size_t)n * rhs_count * sizeof(double));
+  double* gathered = (double*)malloc(((size_t)sparse->max_rows * rhs_count + 1) * sizeof(double));
+  double *diag, *off, *xs, *row;
+  int* idx;
+  int k, s, f, w, r, b, c, error = 0;
+
+  if (!sparse->factored || !x || !gathered) {
+    free(x);
+    free(gathered);
+    return -1;
+  }
+  for (k = 0; k < n; ++k) {
+    memcpy(x + (size_t)k * rhs_count, rhs + (size_t)sparse->order[k] * rhs_count,
+           rhs_count * sizeof(double));
+  }
+
+  for (s = 0; s < sparse->supernode_count && !error; ++s) {
+    sparse_shape(sparse, s, &w, &r);
+    f = sparse->first_column[s];
+    idx = sparse->indices + sparse->index_start[s];
+    diag = sparse->values + sparse->value_start[s];
+    off = diag + (size_t)w * w;
+    xs = x + (size_t)f * rhs_count;
+    if (lower_triangle_block_diagonal_solve(w, rhs_count, diag, sparse->diagonal + f, xs)) {
+      error = 1;
+      break;
+    }
+    if (!r) {
+      continue;
+    }
+    memset(gathered, 0, (size_t)r * rhs_count * sizeof(double));
+    main_blocks_diagonal_multiply(w, r, rhs_count, off, xs, sparse->diagonal + f, gathered);
+    for (b = 0; b < r; ++b) {
+      row = x + (size_t)idx[w + b] * rhs_count;
+      for (c = 0; c < rhs_count; ++c) {
+        row[c] += gathered[(size_t)b * rhs_count + c];
+      }
+    }
+  }
+
+  for (s = sparse->supernode_count - 1; s >= 0 && !error; --s) {
+    sparse_shape(sparse, s, &w, &r);
+    f = sparse->first_column[s];
+    idx = sparse->indices + sparse->index_start[s];
+    diag = sparse->values + sparse->value_start[s];
+    off = diag + (size_t)w * w;
+    xs = x + (size_t)f * rhs_count;
+    if (r) {
+      for (b = 0; b < r; ++b) {
+        memcpy(gathered + (size_t)b * rhs_count, x + (size_t)idx[w + b] * rhs_count,
+               rhs_count * sizeof(double));
+      }
+      main_blocks_multiply_subtract(w, r, rhs_count, off, gathered, xs);
+    }
+    if (upper_triangle_block_solve(w, rhs_count, diag, xs)) {
+      error = 1;
+    }
+  }
+
+  if (!error) {
+    for (k = 0; k < n; ++k) {
+      memcpy(rhs + (size_t)sparse->order[k] * rhs_count, x + (size_t)k * rhs_count,
+             rhs_count * sizeof(double));
+    }
+  }
+  free(x);
+  free(gathered);
+  return error ? -1 : 0;
+}
+
+int cholesky_sparse_supernode_count(cholesky_sparse_t* sparse) {
+  return sparse->supernode_count;
+}
+
+size_t cholesky_sparse_factor_nonzeros(cholesky_sparse_t* sparse) {
+  return sparse->nonzeros;
+}
+
+double cholesky_sparse_flops(cholesky_sparse_t* sparse) {
+  return sparse->flops;
+}
+
+double cholesky_sparse_cpu_time(cholesky_sparse_t* sparse, int thread_id) {
+  return sparse->args[thread_id].cpu_time;
+}
+
+void cholesky_sparse_destroy(cholesky_sparse_t* sparse) {
+  int i;
+
+  if (!sparse) {
+    return;
+  }
+  if (sparse->pool.total_threads) {
+    thread_pool_destroy(&sparse->pool);
+  }
+  for (i = 0; i < sparse->lock_count; ++i) {
+    pthread_mutex_destroy(&sparse->locks[i]);
+  }
+  if (sparse->args) {
+    for (i = 0; i < sparse->total_threads; ++i) {
+      free(sparse->args[i].workspace);
+      free(sparse->args[i].relative);
+    }
+  }
+  pthread_mutex_destroy(&sparse->queue_lock);
+  pthread_cond_destroy(&sparse->queue_change);
+  free(sparse->order);
+  free(sparse->position);
+  free(sparse->first_column);
+  free(sparse->supernode_of);
+  free(sparse->parent);
+  free(sparse->index_start);
+  free(sparse->indices);
+  free(sparse->value_start);
+  free(sparse->values);
+  free(sparse->diagonal);
+  free(sparse->subtree_first);
+  free(sparse->shared);
+  free(sparse->pending);
+  free(sparse->tasks);
+  free(sparse->ready);
+  free(sparse->locks);
+  free(sparse->args);
+  free(sparse);
+}
@@ -0,0 +1,67 @@
+#ifndef CHOLESKY_SPARSE_H
+#define CHOLESKY_SPARSE_H
+
+#include <stddef.h>
+
+#include "sparse_matrix.h"
+
+// Supernodal factorization P A P^T = R^T * D * R of sparse matrices.
+//
+// The handle analyses the pattern once: a nested dissection ordering (see
+// sparse_order.h), postordered along the elimination tree, the row counts
+// of R from the row subtrees of the tree, and supernodes, i.e. runs of
+// consecutive rows of R with the same structure, at most block_size wide.
+// A supernode is merged into its parent when that adds few explicit zeros,
+// so that the kernels run on wide tiles.
+// The w rows of a supernode with h column indices are stored as a w x w
+// diagonal tile followed by a w x (h - w) off-diagonal tile, in the layout of
+// the dense block kernels.
+//
+// A supernode is factored with cholesky_for_block, its off-diagonal tile is
+// solved against it, and the update B^T * D * B of the off-diagonal tile B is
+// computed with main_blocks_diagonal_multiply and added to the ancestors it
+// reaches. Subtrees of the supernodal elimination tree do not touch each
+// other, so the tree is cut into several subtrees per thread that the pool
+// factors in parallel; the supernodes above the cut start as soon as all
+// their children are done and lock the ancestors they update.
+//
+//   cholesky_sparse_t* sparse = cholesky_sparse_create(&matrix, 64, threads);
+//   cholesky_sparse_factor(sparse, &matrix);
+//   cholesky_sparse_solve(sparse, rhs, rhs_count);
+//   cholesky_sparse_destroy(sparse);
+
+typedef struct _CholeskySparse cholesky_sparse_t;
+
+// Orders and analyses the pattern of the matrix and starts the threads.
+// block_size: Widest supernode.
+// Returns: NULL if the parameters are invalid or there is not enough memory.
+cholesky_sparse_t* cholesky_sparse_create(const SparseMatrix* matrix, int block_size,
+                                          int total_threads);
+
+// Factors a matrix with the pattern the handle was created for.
+// Returns: 0 on success, -1 if the method cannot be applied.
+int cholesky_sparse_factor(cholesky_sparse_t* sparse, const SparseMatrix* matrix);
+
+// Solves A * X = B in place for an N x K row-major block of right-hand sides
+// with the last successful factorization.
+// Returns: 0 on success, -1 if there is no factor or not enough memory.
+int cholesky_sparse_solve(cholesky_sparse_t* sparse, double* rhs, int rhs_count);
+
+// Number of supernodes.
+int cholesky_sparse_supernode_count(cholesky_sparse_t* sparse);
+
+// Number of nonzeros of R, counting the upper triangles of the diagonal
+// tiles and the explicit zeros of merged supernodes.
+size_t cholesky_sparse_factor_nonzeros(cholesky_sparse_t* sparse);
+
+// Floating point operations of the factorization.
+double cholesky_sparse_flops(cholesky_sparse_t* sparse);
+
+// CPU time in seconds that a thread of the pool spent in the last
+// factorization, 0 before the first one.
+double cholesky_sparse_cpu_time(cholesky_sparse_t* sparse, int thread_id);
+
+// Stops the threads and releases the handle.
+void cholesky_sparse_destroy(cholesky_sparse_t* sparse);
+
+#endif  // CHOLESKY_SPARSE_H
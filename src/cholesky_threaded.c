@@ -3,131 +3,341 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "array_op.h"
+#include "cholesky_recursive.h"
+#include "matrix_file.h"
 #include "timer.h"
 
+// Rows per panel when the team factors a diagonal block.
+const int TEAM_PANEL_SIZE = 16;
+
+// Smallest diagonal block factored by the whole team. Smaller blocks factor
+// faster on one thread than the two barriers per panel cost.
+const int TEAM_MIN_SIZE = 96;
+
+// Columns are dealt out in whole vectors of the widest kernels.
+const int TEAM_COLUMN_GRAIN = 8;
+
 // Entry point for each worker thread.
 void* cholesky_threaded(void* ptr) {
   double timer = get_time_pthread();
   CholeskyArgs* pa = (CholeskyArgs*)ptr;
 
   // Initial synchronization before starting computations.
-  pthread_barrier_wait(pa->barrier);
+  thread_barrier_wait(pa->barrier);
 
-  cholesky(pa->matrix_size, pa->matrix, pa->diagonal, pa->workspace, pa->block_size, pa->thread_id,
-           pa->total_threads, pa->barrier, pa->error);
+  if (pa->engine == CHOLESKY_ENGINE_DAG) {
+    if (cholesky_dag(pa->dag, pa->thread_id)) {
+      *pa->error = 1;
+    }
+  } else if (pa->engine == CHOLESKY_ENGINE_RECURSIVE) {
+    cholesky_recursive(pa->matrix_size, pa->matrix, pa->diagonal, pa->block_size, pa->thread_id,
+                       pa->barrier, pa->error, pa->distribution, pa->trace);
+  } else {
+    cholesky(pa->matrix_size, pa->matrix, pa->diagonal, pa->block_size, pa->thread_id,
+             pa->total_threads, pa->barrier, pa->error, pa->distribution, pa->profile,
+             pa->checkpoint, pa->trace);
+  }
 
   // Report individual thread CPU time.
-  printf("Thread %d CPU time: %.2lf\n", pa->thread_id,
-         (get_time_pthread() - timer) / (1000.0 * 1000.0 * 1000.0));
+  pa->cpu_time = (get_time_pthread() - timer) / (1000.0 * 1000.0 * 1000.0);
+  if (!pa->quiet) {
+    printf("Thread %d CPU time: %.2lf\n", pa->thread_id, pa->cpu_time);
+  }
 
   // Final synchronization before exit.
-  pthread_barrier_wait(pa->barrier);
+  thread_barrier_wait(pa->barrier);
 
   return 0;
 }
 
-// Parallel block Cholesky implementation.
+// Part of the columns [begin, end) that thread part of parts works on.
+static void team_columns(int begin, int end, int part, int parts, int* c0, int* c1) {
+  int units = (end - begin + TEAM_COLUMN_GRAIN - 1) / TEAM_COLUMN_GRAIN;
+
+  *c0 = begin + units * part / parts * TEAM_COLUMN_GRAIN;
+  *c1 = begin + units * (part + 1) / parts * TEAM_COLUMN_GRAIN;
+  *c0 = (*c0 < end ? *c0 : end);
+  *c1 = (*c1 < end ? *c1 : end);
+}
+
+// Factors the n x n diagonal block a with all threads of the barrier, so that
+// the critical path of a step shrinks as threads are added. The block is
+// split into panels of rows: thread 0 updates and factors the diagonal part
+// of a panel while the others update the rest of its columns, then all
+// threads solve the rest against the diagonal part. Every thread calls it;
+// the block must be final on entry, and the caller's barrier after the
+// return publishes the last panel.
+static int cholesky_diagonal_team(int n, double* a, double* d, int thread_id,
+                                  int total_threads, ThreadBarrier* barrier, int* error,
+                                  Trace* trace, int step) {
+  int p, s, c0, c1;
+
+  for (p = 0; p < n; p += TEAM_PANEL_SIZE) {
+    s = (p + TEAM_PANEL_SIZE < n ? TEAM_PANEL_SIZE : n - p);
+
+    trace_begin(trace, thread_id);
+    if (thread_id == 0) {
+      cholesky_block_panel_update(n, p, s, p, p + s, a, d);
+      if (cholesky_block_panel(n, p, s, p, p + s, a, d)) {
+        printf("Cholesky method with this block size cannot be applied\n");
+        *error = 1;
+      }
+      trace_end(trace, thread_id, TRACE_FACTOR, step, 1.0 * p * s * s + 1.0 / 3.0 * s * s * s);
+    } else {
+      team_columns(p + s, n, thread_id - 1, total_threads - 1, &c0, &c1);
+      cholesky_block_panel_update(n, p, s, c0, c1, a, d);
+      trace_end(trace, thread_id, TRACE_FACTOR, step, 2.0 * p * s * (c1 - c0));
+    }
+    if (p + s == n) {
+      break;
+    }
+
+    trace_barrier_wait(trace, thread_id, barrier, step);
+    if (*error) {
+      return -1;
+    }
+
+    team_columns(p + s, n, thread_id, total_threads, &c0, &c1);
+    trace_begin(trace, thread_id);
+    cholesky_block_panel(n, p, s, c0, c1, a, d);
+    trace_end(trace, thread_id, TRACE_FACTOR, step, 1.0 * s * s * (c1 - c0));
+    trace_barrier_wait(trace, thread_id, barrier, step);
+  }
+
+  return 0;
+}
+
+// Decides on thread 0, before the barrier that ends a block step, whether a
+// checkpoint follows the step; the barrier publishes the decision. No
+// checkpoint follows the last step.
+static void checkpoint_decide(CholeskyCheckpoint* checkpoint, int thread_id, int next_step,
+                              int matrix_size) {
+  if (checkpoint && checkpoint->file_name && thread_id == 0) {
+    checkpoint->due = next_step < matrix_size &&
+                      get_time_monotonic() - checkpoint->last >= checkpoint->interval * 1e9;
+  }
+}
+
+// Thread 0 writes the state before block step next_step while the others
+// wait. All threads must be done with the previous step. A checkpoint that
+// cannot be written does not stop the decomposition.
+static void checkpoint_write(CholeskyCheckpoint* checkpoint, CholeskySchedule schedule,
+                             int matrix_size, double* matrix, double* diagonal, int block_size,
+                             int next_step, int thread_id, ThreadBarrier* barrier, Trace* trace) {
+  if (thread_id == 0) {
+    if (matrix_file_write_factor(checkpoint->file_name, MATRIX_CONTENT_CHECKPOINT, matrix_size,
+                                 block_size, next_step, schedule, matrix, diagonal)) {
+      printf("Cannot write checkpoint %s\n", checkpoint->file_name);
+    }
+    checkpoint->last = get_time_monotonic();
+  }
+  trace_barrier_wait(trace, thread_id, barrier, next_step / block_size);
+}
+
+// Left-looking schedule for DISTRIBUTION_COLUMN.
 //
 // Each thread is responsible for updating a specific set of blocks in each
 // iteration of the outer loop. Barriers are used to ensure data consistency
-// between block updates and diagonal decomposition.
-int cholesky(int matrix_size, double* matrix, double* diagonal, double* workspace, int block_size,
-             int thread_id, int total_threads, pthread_barrier_t* barrier, int* error) {
-  int i, j, k, t;
+// between block updates and diagonal decomposition. The matrix is stored in
+// tile-major format, so every update works on the tiles in place. With a
+// skyline profile a tile only gathers the rows k below the envelope of both
+// its column and the diagonal column, and tiles above the envelope stay zero.
+static int cholesky_left_looking(int matrix_size, double* matrix, double* diagonal,
+                                 int block_size, int thread_id, int total_threads,
+                                 ThreadBarrier* barrier, int* error, const TileProfile* profile,
+                                 CholeskyCheckpoint* checkpoint, Trace* trace) {
+  int i, j, k;
   int pij_n, pij_m;
-  int pki_n, pki_m;
-  int pkj_n, pkj_m;
-
-  double *ma, *mb, *mc, *md, *me;
-  me = workspace;
-  // Each thread uses a private portion of the workspace for block operations.
-  ma = workspace + thread_id * 4 * block_size * block_size + block_size * block_size;
-  mb = ma + block_size * block_size;
-  mc = mb + block_size * block_size;
-  md = mc + block_size * block_size;
-
-  for (i = 0; i < matrix_size; i += block_size) {
+  int pki_n;
+  int end, start;
+
+  double *mc, *md;
+
+  for (i = checkpoint ? checkpoint->first_step : 0; i < matrix_size; i += block_size) {
+    pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    end = tile_profile_row_end(profile, i, matrix_size);
+
     // Stage 1: Update blocks in the current row.
-    for (j = i + thread_id * block_size; j < matrix_size; j += total_threads * block_size) {
-      pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    for (j = i + thread_id * block_size; j < end; j += total_threads * block_size) {
       pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
-
-      if (j != i) {
-        cpy_matrix_block_to_block(matrix, i, j, matrix_size, pij_n, pij_m, mc);
-      } else {
-        cpy_diagonal_block_to_block(matrix, i, matrix_size, pij_n, mc);
+      mc = tile_profile_block(profile, matrix, i, j, matrix_size, block_size);
+      start = tile_profile_column_start(profile, i);
+      if (start < tile_profile_column_start(profile, j)) {
+        start = tile_profile_column_start(profile, j);
       }
+      if (start >= i) {
+        continue;
+      }
+      trace_begin(trace, thread_id);
 
-      k = 0;
-      for (t = 0; t < i; t += block_size) {
-        if (k >= i) {
-          k = 0;
-        }
-
+      for (k = start; k < i; k += block_size) {
         pki_n = (k + block_size < matrix_size ? block_size : matrix_size - k);
-        pki_m = (i + block_size < matrix_size ? block_size : matrix_size - i);
-        pkj_n = (k + block_size < matrix_size ? block_size : matrix_size - k);
-        pkj_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
-
-        cpy_matrix_block_to_block(matrix, k, i, matrix_size, pki_n, pki_m, ma);
-        cpy_matrix_block_to_block(matrix, k, j, matrix_size, pkj_n, pkj_m, mb);
+        main_blocks_diagonal_multiply(
+            pki_n, pij_n, pij_m, tile_profile_block(profile, matrix, k, i, matrix_size, block_size),
+            tile_profile_block(profile, matrix, k, j, matrix_size, block_size), diagonal + k, mc);
+      }
+      trace_end(trace, thread_id, TRACE_UPDATE, i / block_size,
+                2.0 * (i - start) * pij_n * pij_m);
+    }
 
-        main_blocks_diagonal_multiply(pki_n, pki_m, pkj_m, ma, mb, diagonal + k, mc);
-        k += block_size;
+    // Stage 2: Thread 0 handles the diagonal block decomposition, or the whole
+    // team once the block is large enough to be worth splitting.
+    md = tile_profile_block(profile, matrix, i, i, matrix_size, block_size);
+    if (total_threads > 1 && pij_n >= TEAM_MIN_SIZE) {
+      trace_barrier_wait(trace, thread_id, barrier, i / block_size);
+      cholesky_diagonal_team(pij_n, md, diagonal + i, thread_id, total_threads, barrier, error,
+                             trace, i / block_size);
+    } else if (thread_id == 0) {
+      trace_begin(trace, thread_id);
+      if (cholesky_for_block(pij_n, md, diagonal + i)) {
+        printf("Cholesky method with this block size cannot be applied\n");
+        *error = 1;
       }
+      trace_end(trace, thread_id, TRACE_FACTOR, i / block_size, 1.0 / 3.0 * pij_n * pij_n * pij_n);
+    }
+
+    trace_barrier_wait(trace, thread_id, barrier, i / block_size);
+    if (*error) {
+      return -1;
+    }
 
-      if (j != i) {
-        cpy_block_to_matrix_block(matrix, i, j, matrix_size, pij_n, pij_m, mc);
-      } else {
-        cpy_block_to_diagonal_block(matrix, i, matrix_size, pij_n, mc);
+    // Stage 3: Solve the remaining off-diagonal blocks against the factored
+    // diagonal block, which all threads read in place.
+    for (j = i + block_size + thread_id * block_size; j < end; j += total_threads * block_size) {
+      if (tile_profile_column_start(profile, j) > i) {
+        continue;
       }
+      pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      trace_begin(trace, thread_id);
+      lower_triangle_block_diagonal_solve(
+          pij_n, pij_m, md, diagonal + i,
+          tile_profile_block(profile, matrix, i, j, matrix_size, block_size));
+      trace_end(trace, thread_id, TRACE_SCALE, i / block_size, 1.0 * pij_n * pij_n * pij_m);
     }
 
-    pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    checkpoint_decide(checkpoint, thread_id, i + block_size, matrix_size);
+    trace_barrier_wait(trace, thread_id, barrier, i / block_size);
 
-    // Stage 2: Thread 0 handles the diagonal block decomposition and inversion.
-    if (thread_id == 0) {
-      cpy_diagonal_block_to_block(matrix, i, matrix_size, pij_n, mb);
+    // The rows after the step are still untouched.
+    if (checkpoint && checkpoint->due) {
+      checkpoint_write(checkpoint, CHOLESKY_SCHEDULE_LEFT, matrix_size, matrix, diagonal,
+                       block_size, i + block_size, thread_id, barrier, trace);
+    }
+  }
 
-      if (cholesky_for_block(pij_n, mb, diagonal + i)) {
-        printf("Cholesky method with this block size cannot be applied\n");
-        *error = 1;
-      }
+  return 0;
+}
+
+// Right-looking schedule for the owner-based distributions.
+//
+// Every tile is only ever written by its owner. On each step the owner of the
+// diagonal tile factors it, the owners of the row scale their tiles, and then
+// every thread applies the step's update to its tiles of the trailing
+// triangle. The diagonal tile of the next step comes first in that sweep, so
+// it is final as soon as its owner leaves the step. With a skyline profile
+// only the tiles of the row below the envelope take part in the step.
+static int cholesky_right_looking(int matrix_size, double* matrix, double* diagonal,
+                                  int block_size, int thread_id, int total_threads,
+                                  ThreadBarrier* barrier, int* error,
+                                  const Distribution* distribution, const TileProfile* profile,
+                                  CholeskyCheckpoint* checkpoint, Trace* trace) {
+  int i, j, r, c;
+  int pij_n, pij_m, pr_m, pc_m;
+  int end;
+
+  double* md;
 
-      cpy_block_to_diagonal_block(matrix, i, matrix_size, pij_n, mb);
+  for (i = checkpoint ? checkpoint->first_step : 0; i < matrix_size; i += block_size) {
+    pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    end = tile_profile_row_end(profile, i, matrix_size);
 
-      if (!(*error) && inverse_upper_triangle_block_and_diagonal(pij_n, mb, diagonal + i, me)) {
+    // Stage 2: The owner of the diagonal block decomposes it. A large block is
+    // factored by the whole team instead, once all updates of it are done.
+    md = tile_profile_block(profile, matrix, i, i, matrix_size, block_size);
+    if (total_threads > 1 && pij_n >= TEAM_MIN_SIZE) {
+      trace_barrier_wait(trace, thread_id, barrier, i / block_size);
+      cholesky_diagonal_team(pij_n, md, diagonal + i, thread_id, total_threads, barrier, error,
+                             trace, i / block_size);
+    } else if (thread_id == tile_owner(distribution, i / block_size, i / block_size)) {
+      trace_begin(trace, thread_id);
+      if (cholesky_for_block(pij_n, md, diagonal + i)) {
         printf("Cholesky method with this block size cannot be applied\n");
-        *error = 2;
+        *error = 1;
       }
+      trace_end(trace, thread_id, TRACE_FACTOR, i / block_size, 1.0 / 3.0 * pij_n * pij_n * pij_n);
     }
 
-    pthread_barrier_wait(barrier);
+    trace_barrier_wait(trace, thread_id, barrier, i / block_size);
     if (*error) {
       return -1;
     }
 
-    // Copy the inverted diagonal block to thread-local storage for
-    // multiplication.
-    memcpy(md, me, pij_n * pij_n * sizeof(double));
+    // Stage 3: Owners solve the off-diagonal blocks of the current row
+    // against the factored diagonal block.
+    for (j = i + block_size; j < end; j += block_size) {
+      if (thread_id == tile_owner(distribution, i / block_size, j / block_size) &&
+          tile_profile_column_start(profile, j) <= i) {
+        pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+        trace_begin(trace, thread_id);
+        lower_triangle_block_diagonal_solve(
+            pij_n, pij_m, md, diagonal + i,
+            tile_profile_block(profile, matrix, i, j, matrix_size, block_size));
+        trace_end(trace, thread_id, TRACE_SCALE, i / block_size, 1.0 * pij_n * pij_n * pij_m);
+      }
+    }
 
-    // Stage 3: Update remaining off-diagonal blocks using the inverted
-    // diagonal.
-    for (j = i + block_size + thread_id * block_size; j < matrix_size;
-         j += total_threads * block_size) {
-      pij_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
-      pij_m = (j + block_size < matrix_size ? block_size : matrix_size - j);
+    checkpoint_decide(checkpoint, thread_id, i + block_size, matrix_size);
+    trace_barrier_wait(trace, thread_id, barrier, i / block_size);
 
-      cpy_matrix_block_to_block(matrix, i, j, matrix_size, pij_n, pij_m, mb);
-      main_blocks_multiply(pij_n, pij_n, pij_m, md, mb, mc);
-      cpy_block_to_matrix_block(matrix, i, j, matrix_size, pij_n, pij_m, mc);
+    // Stage 1: Owners apply the current row to the trailing triangle.
+    for (r = i + block_size; r < end; r += block_size) {
+      if (tile_profile_column_start(profile, r) > i) {
+        continue;
+      }
+      pr_m = (r + block_size < matrix_size ? block_size : matrix_size - r);
+      for (c = r; c < end; c += block_size) {
+        if (thread_id != tile_owner(distribution, r / block_size, c / block_size) ||
+            tile_profile_column_start(profile, c) > i) {
+          continue;
+        }
+        pc_m = (c + block_size < matrix_size ? block_size : matrix_size - c);
+        trace_begin(trace, thread_id);
+        main_blocks_diagonal_multiply(
+            pij_n, pr_m, pc_m, tile_profile_block(profile, matrix, i, r, matrix_size, block_size),
+            tile_profile_block(profile, matrix, i, c, matrix_size, block_size), diagonal + i,
+            tile_profile_block(profile, matrix, r, c, matrix_size, block_size));
+        trace_end(trace, thread_id, TRACE_UPDATE, i / block_size, 2.0 * pij_n * pr_m * pc_m);
+      }
     }
 
-    pthread_barrier_wait(barrier);
+    // The rows after the step have all its updates once every owner is done.
+    if (checkpoint && checkpoint->due) {
+      trace_barrier_wait(trace, thread_id, barrier, i / block_size);
+      checkpoint_write(checkpoint, CHOLESKY_SCHEDULE_RIGHT, matrix_size, matrix, diagonal,
+                       block_size, i + block_size, thread_id, barrier, trace);
+    }
   }
 
   return 0;
 }
+
+// Parallel block Cholesky implementation.
+int cholesky(int matrix_size, double* matrix, double* diagonal, int block_size, int thread_id,
+             int total_threads, ThreadBarrier* barrier, int* error,
+             const Distribution* distribution, const TileProfile* profile,
+             CholeskyCheckpoint* checkpoint, Trace* trace) {
+  if (cholesky_schedule(distribution) == CHOLESKY_SCHEDULE_LEFT) {
+    return cholesky_left_looking(matrix_size, matrix, diagonal, block_size, thread_id,
+                                 total_threads, barrier, error, profile, checkpoint, trace);
+  }
+  return cholesky_right_looking(matrix_size, matrix, diagonal, block_size, thread_id,
+                                total_threads, barrier, error, distribution, profile, checkpoint,
+                                trace);
+}
+
+CholeskySchedule cholesky_schedule(const Distribution* distribution) {
+  return distribution->kind == DISTRIBUTION_COLUMN ? CHOLESKY_SCHEDULE_LEFT
+                                                   : CHOLESKY_SCHEDULE_RIGHT;
+}
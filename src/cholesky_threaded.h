@@ -1,19 +1,53 @@
 #ifndef CHOLESKY_THREADED
 #define CHOLESKY_THREADED
 
-#include <pthread.h>
+#include "cholesky_dag.h"
+#include "distribution.h"
+#include "skyline.h"
+#include "thread_barrier.h"
+#include "trace.h"
+
+// Scheduling strategy of the decomposition.
+typedef enum {
+  CHOLESKY_ENGINE_DAG = 0,        // Dependency-driven tasks with work stealing.
+  CHOLESKY_ENGINE_BARRIER = 1,    // Static row distribution, two barriers per step.
+  CHOLESKY_ENGINE_RECURSIVE = 2,  // Cache-oblivious recursion on fixed small tiles.
+} CholeskyEngine;
+
+// Order of the updates of the barrier engine, which tells what state the
+// rows after a block step are in.
+typedef enum {
+  CHOLESKY_SCHEDULE_LEFT = 0,   // Left-looking, DISTRIBUTION_COLUMN.
+  CHOLESKY_SCHEDULE_RIGHT = 1,  // Right-looking, the owner-based distributions.
+} CholeskySchedule;
+
+// Checkpoints of the barrier engine, see cholesky().
+typedef struct _CholeskyCheckpoint {
+  const char* file_name;  // Checkpoint file, or NULL to take none.
+  double interval;        // Seconds between checkpoints.
+  double last;            // Monotonic time of the start or the last checkpoint in ns.
+  int first_step;         // First row of the block step to start with, 0 unless resumed.
+  int due;                // Non-zero if the current step ends with a checkpoint.
+} CholeskyCheckpoint;
 
 // Arguments passed to each worker thread.
 typedef struct _CholeskyArgs {
-  int matrix_size;             // Total size of the matrix (N x N).
-  double* matrix;              // Pointer to the packed matrix data.
-  double* diagonal;            // Pointer to the diagonal scaling elements.
-  double* workspace;           // Thread-local or shared workspace buffers.
-  int block_size;              // Size of the computation blocks (M x M).
-  int thread_id;               // Unique ID for the current thread.
-  int total_threads;           // Total number of active threads.
-  pthread_barrier_t* barrier;  // Synchronization barrier.
-  int* error;                  // Shared error flag for re-entrant reporting.
+  int matrix_size;                   // Total size of the matrix (N x N).
+  double* matrix;                    // Pointer to the tile-major matrix data.
+  double* diagonal;                  // Pointer to the diagonal scaling elements.
+  int block_size;                    // Size of the computation blocks (M x M).
+  int thread_id;                     // Unique ID for the current thread.
+  int total_threads;                 // Total number of active threads.
+  ThreadBarrier* barrier;            // Synchronization barrier.
+  int* error;                        // Shared error flag for re-entrant reporting.
+  CholeskyEngine engine;             // Scheduling strategy to use.
+  CholeskyDag* dag;                  // Shared scheduler state for CHOLESKY_ENGINE_DAG.
+  const Distribution* distribution;  // Tile mapping for the barrier and recursive engines.
+  const TileProfile* profile;        // Skyline tile layout of the barrier engine, or NULL.
+  CholeskyCheckpoint* checkpoint;    // Checkpoints of the barrier engine, or NULL.
+  int quiet;                         // Non-zero to skip the CPU time report.
+  Trace* trace;                      // Timeline to record, or NULL.
+  double cpu_time;                   // CPU seconds of the thread in the last decomposition.
 } CholeskyArgs;
 
 // Entry point for pthread_create.
@@ -22,8 +56,30 @@ void* cholesky_threaded(void* ptr);
 // Core multi-threaded block Cholesky decomposition implementation.
 //
 // Performs the decomposition in parallel by distributing block updates
-// across threads and synchronizing at critical stages.
-int cholesky(int matrix_size, double* matrix, double* diagonal, double* workspace, int block_size,
-             int thread_id, int total_threads, pthread_barrier_t* barrier, int* error);
+// across threads, as given by the distribution, and synchronizing at
+// critical stages. The off-diagonal tiles of a block row are solved against
+// the factored diagonal tile in place (TRSM); the diagonal tile is never
+// inverted. Every tile operation and barrier wait is recorded in the
+// trace, if there is one. With a profile the matrix is in its skyline tile
+// layout (see skyline.h), and the tiles above the envelope are skipped.
+//
+// With a checkpoint file, a block step that ends interval seconds or more
+// after the last checkpoint is followed by a new one: once all threads are
+// done with the step, thread 0 writes the tiles and D as a
+// MATRIX_CONTENT_CHECKPOINT (see matrix_file.h) while the others wait. The
+// left-looking schedule has not touched the rows after the step yet and the
+// right-looking one has applied the step to them, so the checkpoint records
+// CHOLESKY_SCHEDULE_LEFT or CHOLESKY_SCHEDULE_RIGHT and can only be resumed
+// by a distribution with the same schedule, with any number of threads. The
+// decomposition starts at block step first_step, with the tiles and D of a
+// checkpoint taken before it. Not available with a profile.
+// checkpoint: NULL to take none and start at the first step.
+int cholesky(int matrix_size, double* matrix, double* diagonal, int block_size, int thread_id,
+             int total_threads, ThreadBarrier* barrier, int* error,
+             const Distribution* distribution, const TileProfile* profile,
+             CholeskyCheckpoint* checkpoint, Trace* trace);
+
+// Schedule that cholesky() runs for a distribution.
+CholeskySchedule cholesky_schedule(const Distribution* distribution);
 
 #endif  // CHOLESKY_THREADED
@@ -0,0 +1,55 @@
+#include "distribution.h"
+
+#include <string.h>
+
+#include "tile_matrix.h"
+
+int distribution_parse(const char* name, DistributionKind* kind) {
+  if (!strcmp(name, "column")) {
+    *kind = DISTRIBUTION_COLUMN;
+  } else if (!strcmp(name, "2d")) {
+    *kind = DISTRIBUTION_2D_CYCLIC;
+  } else if (!strcmp(name, "triangle")) {
+    *kind = DISTRIBUTION_TRIANGLE;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+int distribution_init(Distribution* distribution, DistributionKind kind, int grid_rows,
+                      int total_threads, int matrix_size, int block_size) {
+  int p;
+
+  if (grid_rows <= 0) {
+    for (p = 1, grid_rows = 1; p * p <= total_threads; ++p) {
+      if (total_threads % p == 0) {
+        grid_rows = p;
+      }
+    }
+  }
+  if (total_threads % grid_rows) {
+    return -1;
+  }
+
+  distribution->kind = kind;
+  distribution->grid_rows = grid_rows;
+  distribution->grid_columns = total_threads / grid_rows;
+  distribution->total_threads = total_threads;
+  distribution->tiles_per_row = tile_count(matrix_size, block_size);
+  return 0;
+}
+
+int tile_owner(const Distribution* distribution, int bi, int bj) {
+  int nb = distribution->tiles_per_row;
+
+  switch (distribution->kind) {
+    case DISTRIBUTION_2D_CYCLIC:
+      return (bi % distribution->grid_rows) * distribution->grid_columns +
+             bj % distribution->grid_columns;
+    case DISTRIBUTION_TRIANGLE:
+      return ((((size_t)bi * ((nb << 1) - bi + 1)) >> 1) + bj - bi) % distribution->total_threads;
+    default:
+      return (bj - bi) % distribution->total_threads;
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef DISTRIBUTION_H
+#define DISTRIBUTION_H
+
+// Mapping of tile updates to worker threads for the barrier engine.
+
+typedef enum {
+  // Column blocks of every step are dealt out cyclically, starting at the
+  // diagonal. Left-looking: each tile accumulates all its updates at once.
+  DISTRIBUTION_COLUMN = 0,
+  // Threads form a p x q grid and tile (r, c) belongs to thread
+  // (r mod p) * q + (c mod q). Right-looking: each step updates the whole
+  // trailing triangle, which stays spread over the full grid.
+  DISTRIBUTION_2D_CYCLIC = 1,
+  // Tiles of the upper triangle are dealt out cyclically in block-row order,
+  // so every trailing triangle is split evenly. Right-looking.
+  DISTRIBUTION_TRIANGLE = 2,
+} DistributionKind;
+
+typedef struct _Distribution {
+  DistributionKind kind;  // Mapping strategy.
+  int grid_rows;          // Rows p of the thread grid.
+  int grid_columns;       // Columns q of the thread grid.
+  int total_threads;      // Number of threads, p * q.
+  int tiles_per_row;      // Number of tiles along one dimension.
+} Distribution;
+
+// Parses a distribution name: "column", "2d" or "triangle".
+// Returns: 0 on success, -1 if the name is unknown.
+int distribution_parse(const char* name, DistributionKind* kind);
+
+// Sets up the mapping. A grid_rows of 0 picks the most square p x q grid
+// with p * q = total_threads.
+// Returns: 0 on success, -1 if the grid does not match the thread count.
+int distribution_init(Distribution* distribution, DistributionKind kind, int grid_rows,
+                      int total_threads, int matrix_size, int block_size);
+
+// Returns the thread that updates tile (bi, bj), given in block indices.
+int tile_owner(const Distribution* distribution, int bi, int bj);
+
+#endif  // DISTRIBUTION_H
@@ -0,0 +1,95 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "array_op.h"
+#include "tile_matrix.h"
+
+// Checks of the packed and tile-major index arithmetic.
+//
+// The packed triangle of an n x n matrix has more than INT_MAX elements from
+// n = 65536 on, and so has the tile-major storage of one with small tiles.
+// Every index is compared with a reference that counts the elements of the
+// earlier rows one by one in 64 bits, for sizes on both sides of that limit.
+
+// Matrix sizes checked, around the first one whose packed triangle outgrows int.
+static const int TEST_SIZES[] = {65535, 65536, 65537, 100000, 1 << 20};
+
+// Block sizes checked with every matrix size; 1 gives the most tiles.
+static const int TEST_BLOCK_SIZES[] = {1, 7, 64};
+
+#define TEST_COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+// Stand-in for the tile storage; tile_block() only offsets the pointer.
+static double test_tiles[1];
+
+static int failures = 0;
+
+static void check(int ok, const char* what, int n, int m, int i, uint64_t got, uint64_t want) {
+  if (!ok && failures++ < 10) {
+    printf("FAIL %s n=%d m=%d i=%d: %llu, expected %llu\n", what, n, m, i,
+           (unsigned long long)got, (unsigned long long)want);
+  }
+}
+
+// Index of the diagonal element of row i: rows 0..i-1 hold n, n-1, ... elements.
+static uint64_t reference_row_offset(uint64_t n, uint64_t i) {
+  return i * n - i * (i - 1) / 2;
+}
+
+static void check_packed(int n) {
+  size_t* offsets = packed_row_offsets(n);
+  uint64_t want = 0;
+  int i;
+
+  if (!offsets) {
+    printf("FAIL packed_row_offsets n=%d: out of memory\n", n);
+    ++failures;
+    return;
+  }
+  for (i = 0; i <= n; ++i) {
+    check(packed_row_offset(n, i) == want, "packed_row_offset", n, 0, i, packed_row_offset(n, i),
+          want);
+    check(offsets[i] == want, "packed_row_offsets", n, 0, i, offsets[i], want);
+    check(want == reference_row_offset(n, i), "reference", n, 0, i, reference_row_offset(n, i),
+          want);
+    want += n - i;
+  }
+  free(offsets);
+}
+
+static void check_tiles(int n, int m) {
+  uint64_t nb = ((uint64_t)n + m - 1) / m;
+  uint64_t tile = (uint64_t)m * m;
+  uint64_t bi, got;
+
+  check(tile_matrix_length(n, m) == nb * (nb + 1) / 2 * tile, "tile_matrix_length", n, m, 0,
+        tile_matrix_length(n, m), nb * (nb + 1) / 2 * tile);
+
+  // The diagonal tile and the last tile of every block row.
+  for (bi = 0; bi < nb; ++bi) {
+    got = tile_block(test_tiles, bi * m, bi * m, n, m) - test_tiles;
+    check(got == reference_row_offset(nb, bi) * tile, "tile_block diagonal", n, m, bi, got,
+          reference_row_offset(nb, bi) * tile);
+    got = tile_block(test_tiles, bi * m, (nb - 1) * m, n, m) - test_tiles;
+    check(got == (reference_row_offset(nb, bi) + nb - 1 - bi) * tile, "tile_block last", n, m, bi,
+          got, (reference_row_offset(nb, bi) + nb - 1 - bi) * tile);
+  }
+}
+
+int main(void) {
+  int i, j;
+
+  for (i = 0; i < TEST_COUNT(TEST_SIZES); ++i) {
+    check_packed(TEST_SIZES[i]);
+    for (j = 0; j < TEST_COUNT(TEST_BLOCK_SIZES); ++j) {
+      check_tiles(TEST_SIZES[i], TEST_BLOCK_SIZES[j]);
+    }
+  }
+  if (failures) {
+    printf("%d index checks failed\n", failures);
+    return 1;
+  }
+  printf("Index checks passed\n");
+  return 0;
+}
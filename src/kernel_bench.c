@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "array_op.h"
+#include "array_op_simd.h"
+#include "timer.h"
+
+// Microbenchmark of the block kernels.
+//
+// Every kernel is timed on its own, on buffers that stay in cache, so that a
+// regression in one kernel is not hidden by the noise of a whole
+// factorization. The results are set against a roofline measured on the same
+// machine: the peak rate of independent multiply-add chains of the widest
+// vector instruction set, and the bandwidth of a STREAM triad over arrays of
+// the size of the blocks, i.e. of the cache level the blocks live in. Kernels
+// without floating point operations, such as the copies, are set against the
+// bandwidth alone.
+
+// Samples per measurement; the median is reported.
+const int BENCH_SAMPLES = 11;
+
+// Minimum duration of one sample in nanoseconds.
+const double BENCH_SAMPLE_TIME = 2e6;
+
+// Duration of the warmup before the samples in nanoseconds.
+const double BENCH_WARMUP_TIME = 2e7;
+
+// Doubles per array of the main memory triad, 32 MB each.
+const long BENCH_STREAM_LENGTH = 1L << 22;
+
+// Independent accumulators of the peak loop, enough to hide the FMA latency.
+#define BENCH_PEAK_CHAINS 12
+
+// Multiply-add steps of every chain in one peak measurement.
+const long BENCH_PEAK_ITERATIONS = 1L << 22;
+
+// Default block sizes, the candidates of the autotuner.
+static const int BENCH_BLOCK_SIZES[] = {16, 24, 32, 48, 64, 96, 128, 192, 256};
+
+// Inputs of one block size. The packed matrix is 4m x 4m, so that the copies
+// have an off-diagonal block at (m, 2m) and a diagonal block at m.
+typedef struct _BenchBuffers {
+  int m;           // Block size.
+  double* a;       // m x m input block.
+  double* b;       // m x m input block.
+  double* c;       // m x m output block.
+  double* d;       // Diagonal of +-1 elements.
+  double* e;       // Diagonal written by cholesky_for_block.
+  double* source;  // Symmetric block cholesky_for_block can factor.
+  double* factor;  // Factored source for the inversion and the solve.
+  double* packed;  // Packed upper triangle of a 4m x 4m matrix.
+} BenchBuffers;
+
+typedef struct _BenchKernel {
+  const char* name;                        // Printed name.
+  void (*prepare)(BenchBuffers* buffers);  // Untimed reset before every call, or NULL.
+  void (*run)(BenchBuffers* buffers);      // One call of the kernel.
+  double flops;                            // Floating point operations per m^3.
+  double traffic;                          // Doubles read and written per m^2.
+} BenchKernel;
+
+static void bench_diagonal_multiply(BenchBuffers* p) {
+  main_blocks_diagonal_multiply(p->m, p->m, p->m, p->a, p->b, p->d, p->c);
+}
+
+static void bench_multiply(BenchBuffers* p) {
+  main_blocks_multiply(p->m, p->m, p->m, p->a, p->b, p->c);
+}
+
+static void bench_restore_source(BenchBuffers* p) {
+  memcpy(p->c, p->source, p->m * p->m * sizeof(double));
+}
+
+static void bench_cholesky(BenchBuffers* p) {
+  cholesky_for_block(p->m, p->c, p->e);
+}
+
+static void bench_inverse(BenchBuffers* p) {
+  inverse_upper_triangle_block_and_diagonal(p->m, p->factor, p->e, p->c);
+}
+
+static void bench_restore_rhs(BenchBuffers* p) {
+  memcpy(p->c, p->a, p->m * p->m * sizeof(double));
+}
+
+static void bench_solve(BenchBuffers* p) {
+  lower_triangle_block_diagonal_solve(p->m, p->m, p->factor, p->e, p->c);
+}
+
+static void bench_copy_from_matrix(BenchBuffers* p) {
+  cpy_matrix_block_to_block(p->packed, p->m, 2 * p->m, 4 * p->m, p->m, p->m, p->c);
+}
+
+static void bench_copy_to_matrix(BenchBuffers* p) {
+  cpy_block_to_matrix_block(p->packed, p->m, 2 * p->m, 4 * p->m, p->m, p->m, p->a);
+}
+
+static void bench_copy_from_diagonal(BenchBuffers* p) {
+  cpy_diagonal_block_to_block(p->packed, p->m, 4 * p->m, p->m, p->c);
+}
+
+static void bench_copy_to_diagonal(BenchBuffers* p) {
+  cpy_block_to_diagonal_block(p->packed, p->m, 4 * p->m, p->m, p->factor);
+}
+
+// The diagonal multiply is listed once per instruction set, see main().
+static const BenchKernel BENCH_KERNELS[] = {
+    {"main_blocks_diagonal_multiply", NULL, bench_diagonal_multiply, 2.0, 4.0},
+    {"main_blocks_multiply", NULL, bench_multiply, 2.0, 3.0},
+    {"cholesky_for_block", bench_restore_source, bench_cholesky, 1.0 / 3.0, 1.0},
+    {"inverse_upper_triangle_block", NULL, bench_inverse, 1.0 / 3.0, 1.5},
+    {"lower_triangle_block_diagonal_solve", bench_restore_rhs, bench_solve, 1.0, 2.5},
+    {"cpy_matrix_block_to_block", NULL, bench_copy_from_matrix, 0.0, 2.0},
+    {"cpy_block_to_matrix_block", NULL, bench_copy_to_matrix, 0.0, 2.0},
+    {"cpy_diagonal_block_to_block", NULL, bench_copy_from_diagonal, 0.0, 1.5},
+    {"cpy_block_to_diagonal_block", NULL, bench_copy_to_diagonal, 0.0, 1.0},
+};
+
+static int bench_compare(const void* x, const void* y) {
+  double a = *(const double*)x, b = *(const double*)y;
+  return a < b ? -1 : a > b;
+}
+
+// Times the kernel until BENCH_SAMPLE_TIME has passed. Kernels with a prepare
+// step are timed call by call, so that the reset is not counted.
+// Returns: nanoseconds per call.
+static double bench_sample(const BenchKernel* kernel, BenchBuffers* buffers) {
+  double start, elapsed = 0, total;
+  long calls = 0;
+
+  start = get_time_monotonic();
+  do {
+    if (kernel->prepare) {
+      kernel->prepare(buffers);
+      total = get_time_monotonic();
+      kernel->run(buffers);
+      elapsed += get_time_monotonic() - total;
+    } else {
+      kernel->run(buffers);
+    }
+    ++calls;
+    total = get_time_monotonic() - start;
+  } while (total < BENCH_SAMPLE_TIME);
+
+  return (kernel->prepare ? elapsed : total) / calls;
+}
+
+// Fills times[0 .. samples - 1] with nanoseconds per call after a warmup and
+// sorts them.
+static void bench_measure(const BenchKernel* kernel, BenchBuffers* buffers, int samples,
+                          double* times) {
+  double start = get_time_monotonic();
+  int s;
+
+  while (get_time_monotonic() - start < BENCH_WARMUP_TIME) {
+    bench_sample(kernel, buffers);
+  }
+  for (s = 0; s < samples; ++s) {
+    times[s] = bench_sample(kernel, buffers);
+  }
+  qsort(times, samples, sizeof(double), bench_compare);
+}
+
+// Peak loop of one vector width: BENCH_PEAK_CHAINS independent chains of
+// acc = acc * x + y, which the compiler contracts to FMA where available.
+// Returns: GFLOP/s.
+#define BENCH_PEAK_LOOP(name, lanes, target)                                                    \
+  typedef double name##_vector __attribute__((vector_size(8 * (lanes))));                      \
+  target static double name(void) {                                                            \
+    name##_vector acc[BENCH_PEAK_CHAINS], x, y;                                                 \
+    double start, elapsed, sum = 0;                                                             \
+    long i;                                                                                     \
+    int c, k;                                                                                   \
+    for (k = 0; k < (lanes); ++k) {                                                             \
+      x[k] = 0.999999;                                                                          \
+      y[k] = 1e-9;                                                                              \
+    }                                                                                           \
+    for (c = 0; c < BENCH_PEAK_CHAINS; ++c) {                                                   \
+      acc[c] = y * (double)(c + 1);                                                             \
+    }                                                                                           \
+    start = get_time_monotonic();                                                               \
+    for (i = 0; i < BENCH_PEAK_ITERATIONS; ++i) {                                               \
+      _Pragma("GCC unroll 12") for (c = 0; c < BENCH_PEAK_CHAINS; ++c) {                        \
+        acc[c] = acc[c] * x + y;                                                                \
+      }                                                                                         \
+    }                                                                                           \
+    elapsed = get_time_monotonic() - start;                                                     \
+    for (c = 0; c < BENCH_PEAK_CHAINS; ++c) {                                                   \
+      for (k = 0; k < (lanes); ++k) {                                                           \
+        sum += acc[c][k];                                                                       \
+      }                                                                                         \
+    }                                                                                           \
+    /* Keeps the chains alive. */                                                               \
+    if (sum < 0) {                                                                              \
+      printf("%f\n", sum);                                                                      \
+    }                                                                                           \
+    return 2.0 * (lanes) * BENCH_PEAK_CHAINS * BENCH_PEAK_ITERATIONS / elapsed;                 \
+  }
+
+BENCH_PEAK_LOOP(bench_peak_scalar, 2, )
+#ifdef CHOLESKY_X86_KERNELS
+BENCH_PEAK_LOOP(bench_peak_avx2, 4, __attribute__((target("avx2,fma"))))
+BENCH_PEAK_LOOP(bench_peak_avx512, 8, __attribute__((target("avx512f,fma"))))
+#endif
+
+// Best of the samples of the peak loop for the instruction set of the
+// dispatched kernels.
+static double bench_peak(KernelIsa isa, int samples) {
+  double (*loop)(void) = bench_peak_scalar;
+  double rate, best = 0;
+  int s;
+
+#ifdef CHOLESKY_X86_KERNELS
+  if (isa == KERNEL_ISA_AVX2) {
+    loop = bench_peak_avx2;
+  } else if (isa == KERNEL_ISA_AVX512) {
+    loop = bench_peak_avx512;
+  }
+#else
+  (void)isa;
+#endif
+  for (s = 0; s <= samples; ++s) {
+    if ((rate = loop()) > best) {
+      best = rate;
+    }
+  }
+  return best;
+}
+
+// Best bandwidth of a[i] = b[i] + s * c[i] over arrays of the given length in
+// GB/s, counting 24 bytes per element as STREAM does, or 0 if there is not
+// enough memory.
+static double bench_bandwidth(long length, int samples) {
+  double* a = (double*)malloc(3 * length * sizeof(double));
+  double *b, *c, start, elapsed, rate, best = 0;
+  long i, passes;
+  int s;
+
+  if (!a) {
+    return 0;
+  }
+  b = a + length;
+  c = b + length;
+  for (i = 0; i < length; ++i) {
+    a[i] = 0;
+    b[i] = 1;
+    c[i] = 2;
+  }
+  // The first sample only faults the pages in and warms the caches.
+  for (s = 0; s <= samples; ++s) {
+    passes = 0;
+    start = get_time_monotonic();
+    do {
+      for (i = 0; i < length; ++i) {
+        a[i] = b[i] + 3.0 * c[i];
+      }
+      ++passes;
+      elapsed = get_time_monotonic() - start;
+    } while (elapsed < BENCH_SAMPLE_TIME);
+    rate = 3.0 * length * passes * sizeof(double) / elapsed;
+    if (s && rate > best) {
+      best = rate;
+    }
+  }
+  if (a[length / 2] != 7.0) {
+    printf("Triad check failed\n");
+  }
+  free(a);
+  return best;
+}
+
+// Returns: 0 on success, -1 if there is not enough memory.
+static int bench_buffers_init(BenchBuffers* p, int m) {
+  int len = m * m, packed_len = (4 * m * (4 * m + 1)) / 2;
+  int i, j;
+
+  p->m = m;
+  if (!(p->a = (double*)malloc((6 * len + 2 * m + packed_len) * sizeof(double)))) {
+    return -1;
+  }
+  p->b = p->a + len;
+  p->c = p->b + len;
+  p->source = p->c + len;
+  p->factor = p->source + len;
+  p->d = p->factor + len;
+  p->e = p->d + m;
+  p->packed = p->e + m;
+
+  // Diagonally dominant with alternating signs, so that cholesky_for_block
+  // succeeds and produces both signs of D.
+  for (i = 0; i < m; ++i) {
+    for (j = 0; j < m; ++j) {
+      p->a[i * m + j] = 1.0 / (i + j + 1);
+      p->b[i * m + j] = 1.0 / (i + j + 2);
+      p->c[i * m + j] = 0;
+      p->source[i * m + j] = 1.0 / (i + j + 1) + (i == j ? (i % 3 ? m : -m) : 0);
+    }
+    p->d[i] = i % 3 ? 1 : -1;
+  }
+  for (i = 0; i < packed_len; ++i) {
+    p->packed[i] = 1.0 / (i + 1);
+  }
+  memcpy(p->factor, p->source, len * sizeof(double));
+  if (cholesky_for_block(m, p->factor, p->e)) {
+    free(p->a);
+    return -1;
+  }
+  return 0;
+}
+
+// Measures a kernel and prints one row of the table.
+static void bench_report(const BenchKernel* kernel, const char* isa_name, BenchBuffers* buffers,
+                         int samples, double peak, double bandwidth) {
+  char name[64];
+  double times[64];
+  double m = buffers->m;
+  double median, flops, bytes, roof, rate;
+
+  bench_measure(kernel, buffers, samples, times);
+  median = times[samples / 2];
+  flops = kernel->flops * m * m * m;
+  bytes = kernel->traffic * m * m * sizeof(double);
+  // Attainable rate at the arithmetic intensity of the kernel.
+  roof = flops > 0 ? (peak < flops / bytes * bandwidth ? peak : flops / bytes * bandwidth) : 0;
+  rate = flops > 0 ? flops / median : bytes / median;
+
+  snprintf(name, sizeof(name), "%s%s%s", kernel->name, isa_name ? "/" : "",
+           isa_name ? isa_name : "");
+  printf("%-38s %4d %11.3f %9.2f %9.2f %6.1f%% %6.1f%%\n", name, buffers->m, median / 1000.0,
+         flops / median, bytes / median, 100.0 * rate / (flops > 0 ? roof : bandwidth),
+         100.0 * (times[(3 * samples) / 4] - times[samples / 4]) / median);
+}
+
+static void print_usage(const char* program_name) {
+  printf("Usage: %s [-n samples] [-k kernel] [block_size ...]\n", program_name);
+}
+
+// Entry point for the kernel microbenchmark.
+//
+// Usage: ./kernel_bench [-n samples] [-k kernel] [block_size ...]
+//
+// -n sets the samples per measurement (default 11, at most 63), -k limits the
+// run to the kernels whose name contains the given text. The columns are the
+// median time per call, the rates it gives, the share of the roofline
+// reached, and the interquartile range of the samples relative to the
+// median.
+int main(int argc, char* argv[]) {
+  const char* program_name = argv[0];
+  const char* filter = NULL;
+  int samples = BENCH_SAMPLES;
+  int block_sizes[64];
+  int block_count = 0;
+  int i, k, isa, opt;
+  KernelIsa best_isa;
+  BenchBuffers buffers;
+  double peak, memory_bandwidth;
+  double bandwidth[64];
+
+  while ((opt = getopt(argc, argv, "n:k:")) != -1) {
+    if (opt == 'n' && (samples = atoi(optarg)) > 0 && samples < 64) {
+      continue;
+    } else if (opt == 'k') {
+      filter = optarg;
+    } else {
+      print_usage(program_name);
+      return -1;
+    }
+  }
+  for (i = optind; i < argc && block_count < 64; ++i) {
+    if ((block_sizes[block_count++] = atoi(argv[i])) <= 0) {
+      print_usage(program_name);
+      return -1;
+    }
+  }
+  if (!block_count) {
+    block_count = sizeof(BENCH_BLOCK_SIZES) / sizeof(BENCH_BLOCK_SIZES[0]);
+    memcpy(block_sizes, BENCH_BLOCK_SIZES, sizeof(BENCH_BLOCK_SIZES));
+  }
+
+  best_isa = kernel_isa();
+  peak = bench_peak(best_isa, samples);
+  memory_bandwidth = bench_bandwidth(BENCH_STREAM_LENGTH, samples);
+  printf("Roofline: peak %.2f GFLOP/s (%s), main memory %.2f GB/s\n", peak,
+         kernel_isa_name(best_isa), memory_bandwidth);
+  for (i = 0; i < block_count; ++i) {
+    bandwidth[i] = bench_bandwidth((long)block_sizes[i] * block_sizes[i], samples);
+    printf("Triad over m=%d blocks: %.2f GB/s\n", block_sizes[i], bandwidth[i]);
+  }
+  printf("\n");
+  printf("%-38s %4s %11s %9s %9s %7s %7s\n", "kernel", "m", "time (us)", "GFLOP/s", "GB/s",
+         "roof", "spread");
+
+  for (k = 0; k < (int)(sizeof(BENCH_KERNELS) / sizeof(BENCH_KERNELS[0])); ++k) {
+    if (filter && !strstr(BENCH_KERNELS[k].name, filter)) {
+      continue;
+    }
+    for (i = 0; i < block_count; ++i) {
+      if (bench_buffers_init(&buffers, block_sizes[i])) {
+        printf("Cannot prepare blocks of size %d\n", block_sizes[i]);
+        continue;
+      }
+      if (BENCH_KERNELS[k].run != bench_diagonal_multiply) {
+        bench_report(BENCH_KERNELS + k, NULL, &buffers, samples, peak, bandwidth[i]);
+      } else {
+        for (isa = KERNEL_ISA_SCALAR; isa <= KERNEL_ISA_AVX512; ++isa) {
+          if (!kernel_select_isa((KernelIsa)isa)) {
+            bench_report(BENCH_KERNELS + k, kernel_isa_name((KernelIsa)isa), &buffers, samples,
+                         peak, bandwidth[i]);
+          }
+        }
+        kernel_select_isa(best_isa);
+      }
+      free(buffers.a);
+    }
+  }
+
+  return 0;
+}
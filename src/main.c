@@ -1,141 +1,636 @@
 #include <math.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "array_io.h"
 #include "array_op.h"
-#include "cholesky_threaded.h"
+#include "array_op_simd.h"
+#include "autotune.h"
+#include "cholesky_batch.h"
+#include "cholesky_factor.h"
+#include "cholesky_ooc.h"
+#include "cholesky_sparse.h"
+#include "matrix_file.h"
+#include "read_threaded.h"
+#include "report.h"
+#include "skyline.h"
+#include "sparse_matrix.h"
+#include "tile_matrix.h"
 #include "timer.h"
 
-const int WORKSPACE_MATRIX_COUNT = 4;
+static const char* const ENGINE_NAMES[] = {"dag", "barrier", "recursive"};
+static const char* const DISTRIBUTION_NAMES[] = {"column", "2d", "triangle"};
+
+// Tile buffers of the out-of-core mode without -b.
+const size_t DEFAULT_MEMORY_BUDGET = (size_t)1 << 30;
+
+static void print_usage(const char* program_name) {
+  printf(
+      "Usage: %s [-e dag|barrier|recursive] [-d column|2d|triangle] [-g PxQ] [-r rhs_count] [-k] "
+      "[-a] [-m] [-p compact|scatter|cpu_list] [-t trace.json] [-c] [-j report.json] "
+      "[-o tile_file] [-b budget] [-s w] [-S] [-B count] [-u rank] [-w factor_file] "
+      "[-l factor_file] [-C checkpoint_file] [-i seconds] <n> [m|auto] [threads|auto] [file]\n",
+      program_name);
+}
+
+// Parses a byte count with an optional K, M or G suffix.
+// Returns: the count, 0 if the text is not a valid size.
+static size_t parse_size(const char* text) {
+  char* end;
+  size_t size = strtoull(text, &end, 10);
+
+  if (*end == 'K' || *end == 'k') {
+    size <<= 10;
+    ++end;
+  } else if (*end == 'M' || *end == 'm') {
+    size <<= 20;
+    ++end;
+  } else if (*end == 'G' || *end == 'g') {
+    size <<= 30;
+    ++end;
+  }
+  return *end ? 0 : size;
+}
+
+// Solves count generated systems of size n with the batched kernels (see
+// cholesky_batch.h) and reports the time per system and the worst residual.
+// Returns: 0 on success, -2 if there is not enough memory.
+static int run_batch(int n, int count, int total_threads, RunReport* report,
+                     const char* report_file_name) {
+  size_t matrix_length = cholesky_batch_matrix_length(n, count);
+  size_t vector_length = cholesky_batch_vector_length(n, count);
+  double* matrices = (double*)calloc(matrix_length, sizeof(double));
+  double* diagonal = (double*)calloc(vector_length, sizeof(double));
+  double* rhs = (double*)calloc(vector_length, sizeof(double));
+  double* solution = (double*)malloc(vector_length * sizeof(double));
+  double* vector_answer = (double*)malloc(n * sizeof(double));
+  cholesky_batch_t* batch = cholesky_batch_create(total_threads);
+  double phase_start, residual, rhs_norm, error, system_residual, system_rhs_norm, system_error;
+  double sum;
+  int b, i, j, failed, result = 0;
+
+  if (!matrices || !diagonal || !rhs || !solution || !vector_answer || !batch) {
+    printf("Not enough memory\n");
+    result = -2;
+    goto cleanup;
+  }
+
+  fill_vector_answer(n, vector_answer);
+  fill_batch(n, count, matrices, vector_answer, rhs);
+  memcpy(solution, rhs, vector_length * sizeof(double));
+
+  phase_start = get_time_monotonic();
+  failed = cholesky_batch_factor(batch, n, count, matrices, diagonal, NULL);
+  report->decomposition_time = (get_time_monotonic() - phase_start) / 1e9;
+  if (failed) {
+    printf("Cholesky method cannot be applied to %d systems\n", failed);
+    goto cleanup;
+  }
+  phase_start = get_time_monotonic();
+  cholesky_batch_solve(batch, n, count, matrices, diagonal, solution);
+  report->solve_time = (get_time_monotonic() - phase_start) / 1e9;
+  printf("Batch of %d systems: %.1f ns per factorization, %.1f ns per solve\n", count,
+         report->decomposition_time * 1e9 / count, report->solve_time * 1e9 / count);
+
+  // The factors overwrote the matrices, which are generated again for the
+  // verification. The worst system is reported.
+  fill_batch(n, count, matrices, vector_answer, rhs);
+  residual = 0;
+  rhs_norm = 1;
+  error = 0;
+  for (b = 0; b < count; ++b) {
+    system_residual = 0;
+    system_rhs_norm = 0;
+    system_error = 0;
+    for (i = 0; i < n; ++i) {
+      sum = 0;
+      for (j = 0; j < n; ++j) {
+        sum += matrices[cholesky_batch_matrix_index(n, b, i < j ? i : j, i < j ? j : i)] *
+               solution[cholesky_batch_vector_index(n, b, j)];
+      }
+      sum -= rhs[cholesky_batch_vector_index(n, b, i)];
+      system_residual += sum * sum;
+      system_rhs_norm += rhs[cholesky_batch_vector_index(n, b, i)] *
+                         rhs[cholesky_batch_vector_index(n, b, i)];
+      sum = solution[cholesky_batch_vector_index(n, b, i)] - vector_answer[i];
+      system_error += sum * sum;
+    }
+    if (sqrt(system_residual) / sqrt(system_rhs_norm) >= residual / rhs_norm || !b) {
+      residual = sqrt(system_residual);
+      rhs_norm = sqrt(system_rhs_norm);
+    }
+    if (sqrt(system_error) > error) {
+      error = sqrt(system_error);
+    }
+  }
+
+  printf("Error: %11.5le ; Residual: %11.5le (%11.5le)\n", error, residual, residual / rhs_norm);
+  report->error = error;
+  report->residual = residual;
+  report->residual_rel = residual / rhs_norm;
+  report->success = 1;
+
+cleanup:
+  if (report_file_name) {
+    report_write_json(report, report_file_name);
+  }
+  cholesky_batch_destroy(batch);
+  free(matrices);
+  free(diagonal);
+  free(rhs);
+  free(solution);
+  free(vector_answer);
+  return result;
+}
+
+// Number of online CPUs, clamped to the 128 threads the solver accepts.
+static int default_thread_count(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus < 1 ? 1 : cpus > 128 ? 128 : (int)cpus;
+}
+
+// Fills in an omitted (zero) block size or thread count from the tuning
+// profile, tuning first if requested.
+// Returns: 0 on success, -1 if tuning failed.
+static int resolve_configuration(int matrix_size, int* block_size, int* total_threads, int autotune,
+                                 const CholeskyOptions* options) {
+  char path[1024];
+  TuneProfile profile;
+  int max_threads = *total_threads > 0 ? *total_threads : default_thread_count();
+
+  autotune_profile_path(path, sizeof(path));
+  if (autotune) {
+    if (autotune_run(matrix_size, max_threads, options, &profile)) {
+      printf("Cannot tune the solver\n");
+      return -1;
+    }
+    printf("Tuned for n=%d: m=%d threads=%d (%.2f GFLOP/s)\n", profile.matrix_size,
+           profile.block_size, profile.total_threads, profile.gflops);
+    // The profile entry covers the size that was timed, not a larger request.
+    autotune_store(path, profile.matrix_size, options->engine, &profile);
+  } else if (autotune_lookup(path, matrix_size, options->engine, &profile)) {
+    profile.block_size = 64;
+    profile.total_threads = max_threads;
+    printf("No tuning profile for n=%d, run with -a to create one\n", matrix_size);
+  }
+
+  if (!*block_size) {
+    *block_size = profile.block_size < matrix_size ? profile.block_size : matrix_size;
+  }
+  if (!*total_threads) {
+    *total_threads = profile.total_threads;
+  }
+  printf("Using m=%d threads=%d\n", *block_size, *total_threads);
+  return 0;
+}
 
 // Entry point for the block Cholesky solver.
 //
-// Usage: ./a <matrix_size> <block_size> <thread_count> [matrix_file]
+// Usage: ./a [-e dag|barrier|recursive] [-d column|2d|triangle] [-g PxQ] [-r rhs_count] [-k]
+//            [-a] [-m] [-p compact|scatter|cpu_list] [-t trace.json] [-c] [-j report.json]
+//            [-o tile_file] [-b budget] [-s w] <matrix_size> [block_size] [thread_count]
+//            [matrix_file]
+//
+// A block size or thread count that is omitted or given as "auto" is taken
+// from the tuning profile; -a benchmarks the candidates first and updates the
+// profile. matrix_file requires both of them (either may be "auto").
+//
+// matrix_file is either text with the full matrix or a binary file written
+// by matrix_convert, which is mapped instead of parsed.
+//
+// With -r K the system is solved for K right-hand sides at once; column c is
+// generated from the known answer scaled by c + 1. With -k the pool workers
+// keep spinning between the factorization and the solve. With -m the matrix
+// is factored in single precision and the solution is refined to double
+// precision accuracy; the refinement steps are reported with the residual.
+// -p pins the threads to CPUs as described in affinity.h. -t records the
+// decomposition of every thread, prints a per-phase summary and writes the
+// timeline as Chrome trace JSON; -c adds hardware counters to the trace. -j
+// writes the configuration, phase times, rates, residuals and thread CPU
+// times as JSON (see report.h), for benchmark.py.
+//
+// -o factors out of core (see cholesky_ooc.h): the tiles live in tile_file,
+// which must not exist and is removed at the end, and at most -b bytes of
+// tile buffers (1G by default, K, M and G suffixes) are held in memory. The
+// input is then the generated matrix or a binary file, never the whole
+// packed matrix in memory, and the residual is computed tile by tile.
+//
+// -s stores the matrix in skyline storage (see skyline.h) and factors it with
+// the barrier engine, which skips the tiles above the envelope. The
+// generated matrix is then banded, with columns reaching at most w rows above
+// the diagonal; a text matrix_file is scanned for its envelope instead.
+//
+// -S factors the matrix as a sparse one with the supernodal engine (see
+// cholesky_sparse.h). The generated matrix is then the 5-point Laplacian of a
+// square grid with n points, and matrix_file is a Matrix Market coordinate
+// file of size n; m caps the width of the supernodes.
+//
+// -B count solves count independent generated systems of size n at once with
+// the batched kernels (see cholesky_batch.h) and reports the time per system;
+// m is ignored, and the thread count defaults to the number of CPUs.
+//
+// -u k modifies the factored matrix by the rank-k update A + V * V^T of
+// generated vectors V, or by the downdate A - V * V^T for a negative k, with
+// cholesky_factor_update instead of a new factorization, and then solves and
+// verifies the modified system.
+//
+// -w writes the factor to factor_file (see matrix_file.h) before the solve,
+// and -l maps a factor written by -w for the same n and m instead of
+// factoring; the matrix is still generated or read for the verification.
+// -C takes a checkpoint of the barrier engine in checkpoint_file every -i
+// seconds (600 by default) and removes it at the end. If checkpoint_file
+// exists at the start, for instance after the run was killed, the
+// factorization resumes from it.
 int main(int argc, char* argv[]) {
   int matrix_size, block_size, total_threads;
-  int i;
-  int len;
-
-  CholeskyArgs* cholesky_args;
-  pthread_t* threads;
-  pthread_barrier_t barrier;
-  int error_flag = 0;
-
-  double* matrix;
-  double* diagonal;
+  int i, c, opt;
+  size_t len;
+  int rhs_count = 1;
+  int grid_columns = 0;
+  int autotune = 0;
+  const char* program_name = argv[0];
+  const char* input_file_name;
+  const char* trace_file_name = NULL;
+  const char* report_file_name = NULL;
+  const char* ooc_file_name = NULL;
+  size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+  int bandwidth = -1;
+  int sparse_input = 0;
+  int engine_options = 0;
+  int batch_count = 0;
+  int update_rank = 0;
+  int update_sign;
+  const char* factor_out_name = NULL;
+  const char* factor_in_name = NULL;
+  const char* checkpoint_file_name = NULL;
+  int resume = 0;
+  RunReport report;
+  double thread_cpu_times[128];
+  double run_start, phase_start;
+
+  CholeskyOptions options;
+  cholesky_factor_t* factor = NULL;
+  cholesky_ooc_t* ooc = NULL;
+  OocSource source;
+  Skyline skyline;
+  cholesky_sparse_t* sparse = NULL;
+  SparseMatrix sparse_matrix;
+
+  MatrixFile input;
+  int binary = 0;
+  double* matrix = NULL;
+  double* packed;
+  double* input_tiles = NULL;
+  double printed[(15 * 16) / 2];
   double* vector_answer;
   double* vector;
   double* exact_rhs;
   double* rhs;
-  double* workspace;
+  double* column;
+  double* update_vectors = NULL;
 
   double residual, rhs_norm, answer_error;
+  double column_residual, column_rhs_norm, column_error;
 
   timer_start();
+  run_start = get_time_monotonic();
+  memset(&report, 0, sizeof(report));
+  memset(&skyline, 0, sizeof(skyline));
+  memset(&sparse_matrix, 0, sizeof(sparse_matrix));
+  cholesky_options_default(&options);
+
+  // Parse options, then shift them away so the positional arguments keep
+  // their historical indices.
+  while ((opt = getopt(argc, argv, "e:d:g:r:kamp:t:cj:o:b:s:SB:u:w:l:C:i:")) != -1) {
+    // Options of the dense engines, which the sparse solver has no use for.
+    engine_options |= opt == 'e' || opt == 'd' || opt == 'g' || opt == 'k' || opt == 'p';
+    if (opt == 'e' && !strcmp(optarg, "dag")) {
+      options.engine = CHOLESKY_ENGINE_DAG;
+    } else if (opt == 'e' && !strcmp(optarg, "barrier")) {
+      options.engine = CHOLESKY_ENGINE_BARRIER;
+    } else if (opt == 'e' && !strcmp(optarg, "recursive")) {
+      options.engine = CHOLESKY_ENGINE_RECURSIVE;
+    } else if (opt == 'd' && !distribution_parse(optarg, &options.distribution)) {
+      if (options.engine == CHOLESKY_ENGINE_DAG) {
+        options.engine = CHOLESKY_ENGINE_BARRIER;
+      }
+    } else if (opt == 'g' && sscanf(optarg, "%dx%d", &options.grid_rows, &grid_columns) == 2) {
+      continue;
+    } else if (opt == 'r' && (rhs_count = atoi(optarg)) > 0) {
+      continue;
+    } else if (opt == 'k') {
+      options.keep_hot = 1;
+    } else if (opt == 'a') {
+      autotune = 1;
+    } else if (opt == 'm') {
+      options.mixed_precision = 1;
+    } else if (opt == 'p') {
+      options.affinity = optarg;
+    } else if (opt == 't') {
+      trace_file_name = optarg;
+    } else if (opt == 'c') {
+      options.trace = 2;
+    } else if (opt == 'j') {
+      report_file_name = optarg;
+    } else if (opt == 'o') {
+      ooc_file_name = optarg;
+    } else if (opt == 'b' && (memory_budget = parse_size(optarg))) {
+      continue;
+    } else if (opt == 's' && sscanf(optarg, "%d", &bandwidth) == 1 && bandwidth >= 0) {
+      continue;
+    } else if (opt == 'S') {
+      sparse_input = 1;
+    } else if (opt == 'B' && (batch_count = atoi(optarg)) > 0) {
+      continue;
+    } else if (opt == 'u' && (update_rank = atoi(optarg))) {
+      continue;
+    } else if (opt == 'w') {
+      factor_out_name = optarg;
+    } else if (opt == 'l') {
+      factor_in_name = optarg;
+    } else if (opt == 'C') {
+      checkpoint_file_name = optarg;
+    } else if (opt == 'i' && sscanf(optarg, "%lf", &options.checkpoint_interval) == 1 &&
+               options.checkpoint_interval >= 0) {
+      continue;
+    } else {
+      print_usage(program_name);
+      return -1;
+    }
+  }
+  if (trace_file_name && !options.trace) {
+    options.trace = 1;
+  }
+  options.checkpoint = checkpoint_file_name;
+  if ((bandwidth >= 0 || checkpoint_file_name) && options.engine == CHOLESKY_ENGINE_DAG) {
+    options.engine = CHOLESKY_ENGINE_BARRIER;
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
 
   // Parse command line arguments.
-  if (argc == 4 || argc == 5) {
+  if (argc >= 2 && argc <= 5) {
     matrix_size = atoi(argv[1]);
-    block_size = atoi(argv[2]);
-    if (argc == 4) {
-      total_threads = atoi(argv[3]);
-    } else {
-      total_threads = atoi(argv[4]);
+    // "auto" parses as 0.
+    block_size = argc > 2 ? atoi(argv[2]) : 0;
+    total_threads = argc == 4 ? atoi(argv[3]) : argc == 5 ? atoi(argv[4]) : 0;
+    input_file_name = argc == 5 ? argv[3] : NULL;
+
+    if (batch_count) {
+      // The systems are factored whole, so m is ignored and not tuned.
+      block_size = matrix_size;
+      total_threads = total_threads ? total_threads : default_thread_count();
+    } else if (matrix_size > 0 && (autotune || !block_size || !total_threads) &&
+               resolve_configuration(matrix_size, &block_size, &total_threads, autotune,
+                                     &options)) {
+      return -1;
     }
 
     if (matrix_size <= 0 || block_size <= 0 || total_threads <= 0 || total_threads > 128 ||
-        block_size > matrix_size) {
+        block_size > matrix_size ||
+        (options.grid_rows && options.grid_rows * grid_columns != total_threads)) {
       printf("Wrong input parameters\n");
       return -1;
     }
 
-    // Allocate a single large buffer for all matrix-related arrays to
-    // maximize memory contiguousness.
-    len = total_threads * WORKSPACE_MATRIX_COUNT * block_size * block_size +
-          2 * block_size * block_size + ((matrix_size * (matrix_size + 1)) / 2) + 5 * matrix_size;
-    len *= sizeof(double);
+    if (ooc_file_name && (options.mixed_precision || options.trace ||
+                          (input_file_name && !matrix_file_is_binary(input_file_name)))) {
+      printf("Out-of-core mode takes a generated or binary matrix, without -m and -t\n");
+      return -1;
+    }
+    if (ooc_file_name && memory_budget < cholesky_ooc_min_budget(matrix_size, block_size)) {
+      printf("Memory budget must be at least %zu bytes\n",
+             cholesky_ooc_min_budget(matrix_size, block_size));
+      return -1;
+    }
+    if (bandwidth >= 0 &&
+        (ooc_file_name || options.mixed_precision || options.engine != CHOLESKY_ENGINE_BARRIER ||
+         (input_file_name && matrix_file_is_binary(input_file_name)))) {
+      printf("Skyline storage takes a generated or text matrix and the barrier engine, "
+             "without -m and -o\n");
+      return -1;
+    }
+    if (sparse_input && (engine_options || ooc_file_name || options.mixed_precision ||
+                         options.trace || bandwidth >= 0 ||
+                         (input_file_name && matrix_file_is_binary(input_file_name)))) {
+      printf("Sparse mode takes a generated grid or a Matrix Market file, "
+             "without -d, -e, -g, -k, -m, -o, -p, -s and -t\n");
+      return -1;
+    }
+    if (batch_count && (autotune || input_file_name || ooc_file_name || options.mixed_precision ||
+                        options.trace || bandwidth >= 0 || sparse_input)) {
+      printf("Batch mode takes generated systems, without -a, -m, -o, -s, -S and -t\n");
+      return -1;
+    }
+    if ((factor_out_name || factor_in_name || checkpoint_file_name) &&
+        (ooc_file_name || options.mixed_precision || bandwidth >= 0 || sparse_input ||
+         batch_count)) {
+      printf("Factor and checkpoint files take the in-memory dense solver, "
+             "without -m, -o, -s, -S and -B\n");
+      return -1;
+    }
+    if (checkpoint_file_name && options.engine != CHOLESKY_ENGINE_BARRIER) {
+      printf("Checkpoints take the barrier engine\n");
+      return -1;
+    }
+    if (factor_in_name && (update_rank || checkpoint_file_name)) {
+      printf("A loaded factor is solved as it is, without -u and -C\n");
+      return -1;
+    }
+    if (update_rank && (ooc_file_name || options.mixed_precision || bandwidth >= 0 ||
+                        sparse_input || batch_count || abs(update_rank) > matrix_size ||
+                        (input_file_name && matrix_file_is_binary(input_file_name)))) {
+      printf("Low-rank updates take a generated or text matrix and a rank up to n, "
+             "without -m, -o, -s, -S and -B\n");
+      return -1;
+    }
 
-    if (!(matrix = (double*)malloc(len))) {
+    // Configuration of the JSON report.
+    report.matrix_size = matrix_size;
+    report.block_size = block_size;
+    report.total_threads = total_threads;
+    report.rhs_count = rhs_count;
+    report.engine = ooc_file_name  ? "out_of_core"
+                    : sparse_input ? "sparse"
+                                   : ENGINE_NAMES[options.engine];
+    report.distribution = sparse_input ? NULL : DISTRIBUTION_NAMES[options.distribution];
+    report.mixed_precision = options.mixed_precision;
+    report.kernel_isa = kernel_isa_name(kernel_isa());
+    report.affinity = options.affinity;
+    report.input = input_file_name;
+    report.memory_budget = ooc_file_name ? memory_budget : 0;
+    report.skyline = bandwidth >= 0;
+    report.update_rank = update_rank;
+
+    if (batch_count) {
+      report.engine = "batch";
+      report.batch_count = batch_count;
+      report.flops = report_decomposition_flops(matrix_size) * batch_count;
+      return run_batch(matrix_size, batch_count, total_threads, &report, report_file_name);
+    }
+
+    // Binary input is mapped, and a packed payload is used in place.
+    if (input_file_name && (binary = matrix_file_is_binary(input_file_name))) {
+      if (matrix_file_map(&input, input_file_name, 1)) {
+        return -1;
+      }
+      if (input.header.matrix_size != (uint64_t)matrix_size ||
+          input.header.content != MATRIX_CONTENT_MATRIX) {
+        printf("Wrong input parameters\n");
+        matrix_file_unmap(&input);
+        return -1;
+      }
+    }
+
+    // Allocate a single large buffer for the vectors to maximize memory
+    // contiguousness. The packed matrix gets its own buffer unless it is
+    // mapped, stored as a skyline or sparse, or the factorization runs out
+    // of core.
+    len = (size_t)(4 + rhs_count) * matrix_size * sizeof(double);
+    if (!(vector_answer = (double*)malloc(len)) ||
+        (!ooc_file_name && bandwidth < 0 && !sparse_input &&
+         (!binary || input.header.layout != MATRIX_LAYOUT_PACKED) &&
+         !(matrix = (double*)malloc(packed_row_offset(matrix_size, matrix_size) *
+                                    sizeof(double))))) {
       printf("Not enough memory\n");
+      free(vector_answer);
+      if (binary) {
+        matrix_file_unmap(&input);
+      }
       return -2;
     }
 
-    memset(matrix, 0, len);
+    memset(vector_answer, 0, len);
 
     // Calculate offsets into the large memory buffer.
-    diagonal = matrix + ((matrix_size * (matrix_size + 1)) / 2);
-    vector_answer = diagonal + matrix_size;
     vector = vector_answer + matrix_size;
-    exact_rhs = vector + matrix_size;
+    exact_rhs = vector + rhs_count * matrix_size;
     rhs = exact_rhs + matrix_size;
-    workspace = rhs + matrix_size;
+    column = rhs + matrix_size;
+    packed = matrix;
 
-    if (!(cholesky_args = (CholeskyArgs*)malloc(total_threads * sizeof(CholeskyArgs)))) {
-      printf("Not enough memory\n");
-      free(matrix);
-      return -2;
-    }
+    fill_vector_answer(matrix_size, vector_answer);
 
-    if (!(threads = (pthread_t*)malloc(total_threads * sizeof(pthread_t)))) {
-      printf("Not enough memory\n");
-      free(matrix);
-      free(cholesky_args);
-      return -2;
+    // A skyline is loaded first, since the handle only stores its envelope.
+    if (bandwidth >= 0) {
+      if (input_file_name ? read_skyline(matrix_size, &skyline, vector_answer, rhs, input_file_name)
+                          : fill_skyline(matrix_size, bandwidth, &skyline, vector_answer, rhs)) {
+        printf("Cannot read matrix\n");
+        goto cleanup;
+      }
+      options.skyline = &skyline;
     }
 
-    if (pthread_barrier_init(&barrier, NULL, total_threads)) {
-      printf("Cannot initialize barrier\n");
-      free(matrix);
-      free(cholesky_args);
-      free(threads);
-      return -2;
+    // So is a sparse matrix, whose pattern the handle analyses.
+    if (sparse_input) {
+      if (input_file_name ? sparse_read_matrix_market(input_file_name, &sparse_matrix)
+                          : sparse_fill_grid(matrix_size, &sparse_matrix)) {
+        printf("Cannot read matrix\n");
+        goto cleanup;
+      }
+      if (sparse_matrix.matrix_size != matrix_size) {
+        printf("Wrong input parameters\n");
+        goto cleanup;
+      }
+      sparse_matrix_vector_multiply(&sparse_matrix, vector_answer, rhs);
     }
 
-    // Initialize thread arguments.
-    for (i = 0; i < total_threads; ++i) {
-      cholesky_args[i].matrix_size = matrix_size;
-      cholesky_args[i].matrix = matrix;
-      cholesky_args[i].diagonal = diagonal;
-      cholesky_args[i].workspace = workspace;
-      cholesky_args[i].block_size = block_size;
-      cholesky_args[i].thread_id = i;
-      cholesky_args[i].total_threads = total_threads;
-      cholesky_args[i].barrier = &barrier;
-      cholesky_args[i].error = &error_flag;
+    // The handle owns the tile-major factor and the threads.
+    if (ooc_file_name) {
+      if (!(ooc = cholesky_ooc_create(matrix_size, block_size, total_threads, ooc_file_name,
+                                      memory_budget))) {
+        printf("Cannot create solver\n");
+        goto cleanup;
+      }
+    } else if (sparse_input) {
+      if (!(sparse = cholesky_sparse_create(&sparse_matrix, block_size, total_threads))) {
+        printf("Cannot create solver\n");
+        goto cleanup;
+      }
+      report.flops = cholesky_sparse_flops(sparse);
+      printf("Supernodes: %d ; Nonzeros of R: %zu ; GFLOP: %.2f\n",
+             cholesky_sparse_supernode_count(sparse), cholesky_sparse_factor_nonzeros(sparse),
+             report.flops / 1e9);
+    } else if (!(factor = cholesky_factor_create(matrix_size, block_size, total_threads,
+                                                 &options))) {
+      printf("Cannot create solver\n");
+      goto cleanup;
+    } else {
+      // The recursive engine picks its own tile size.
+      block_size = cholesky_factor_block_size(factor);
+      report.block_size = block_size;
     }
 
-    fill_vector_answer(matrix_size, vector_answer);
-
     // Load or generate matrix data.
-    if (argc == 4) {
+    if (ooc) {
+      // Tiles go straight to the tile file; the right-hand side is computed
+      // from the same source.
+      source.kind = OOC_SOURCE_GENERATED;
+      source.data = NULL;
+      if (input_file_name) {
+        source.kind = input.header.layout == MATRIX_LAYOUT_PACKED ? OOC_SOURCE_PACKED
+                                                                  : OOC_SOURCE_TILES;
+        source.data = input.data;
+      }
+      if (source.kind == OOC_SOURCE_TILES && input.header.block_size != (uint32_t)block_size) {
+        printf("Out-of-core tile input needs m=%u\n", input.header.block_size);
+        goto cleanup;
+      }
+      if (cholesky_ooc_load(ooc, &source) ||
+          ooc_source_multiply(&source, matrix_size, block_size, vector_answer, rhs)) {
+        printf("Cannot load matrix\n");
+        goto cleanup;
+      }
+      packed = source.kind == OOC_SOURCE_PACKED ? input.data : NULL;
+    } else if (bandwidth >= 0 || sparse) {
+      // The skyline or sparse matrix and its right-hand side are already
+      // loaded.
+    } else if (!input_file_name) {
       if (fill_matrix(matrix_size, matrix, vector_answer, rhs)) {
         printf("Cannot fill matrix\n");
         goto cleanup;
       }
-    } else if (argc == 5) {
-      if (read_matrix(matrix_size, &matrix, vector_answer, rhs, argv[3])) {
+    } else if (!binary) {
+      if (read_matrix_threaded(matrix_size, matrix, vector_answer, rhs, input_file_name,
+                               total_threads)) {
         printf("Cannot read matrix\n");
         goto cleanup;
       }
+      packed = matrix;
+    } else {
+      if (input.header.layout == MATRIX_LAYOUT_PACKED) {
+        packed = input.data;
+      } else {
+        // Tiles of the factorization block size are loaded as they are; the
+        // packed copy is only needed for the verification.
+        if (input.header.block_size == (uint32_t)block_size && !options.mixed_precision) {
+          input_tiles = input.data;
+        }
+        tiles_to_packed(matrix_size, input.header.block_size, input.data, matrix);
+      }
+      packed_matrix_vector_multiply(matrix_size, packed, vector_answer, rhs);
     }
 
     for (i = 0; i < matrix_size; i++) {
       exact_rhs[i] = rhs[i];
-      vector[i] = rhs[i];
+      for (c = 0; c < rhs_count; ++c) {
+        vector[i * rhs_count + c] = (c + 1) * rhs[i];
+      }
     }
   } else {
-    printf("Usage: %s <n> <m> <threads> [file]\n", argv[0]);
+    print_usage(program_name);
     return 0;
   }
 
+  report.initialization_time = (get_time_monotonic() - run_start) / 1e9;
+
   print_time("on initialization");
 
-  if (matrix_size < 15) {
+  if (matrix_size < 15 && packed) {
     printf("matrix A:\n");
-    printf_matrix(matrix_size, matrix);
+    printf_matrix(matrix_size, packed);
     printf("\nrhs:\n");
     for (i = 0; i < matrix_size; ++i) {
       printf("%.10f ", rhs[i]);
@@ -143,81 +638,172 @@ int main(int argc, char* argv[]) {
     printf("\n\n");
   }
 
-  // Spawn worker threads.
-  for (i = 1; i < total_threads; ++i) {
-    if (pthread_create(threads + i, 0, cholesky_threaded, cholesky_args + i)) {
-      fprintf(stderr, "Cannot create thread #%d\n", i);
-    }
+  // A checkpoint left behind by an interrupted run is resumed.
+  if (checkpoint_file_name && !access(checkpoint_file_name, F_OK)) {
+    printf("Resuming from checkpoint %s\n", checkpoint_file_name);
+    resume = 1;
   }
 
-  // Thread 0 also performs work.
-  cholesky_threaded(cholesky_args + 0);
+  phase_start = get_time_monotonic();
+  if (ooc ? cholesky_ooc_factor(ooc)
+      : sparse         ? cholesky_sparse_factor(sparse, &sparse_matrix)
+      : bandwidth >= 0 ? cholesky_factor_factor_skyline(factor, &skyline)
+      : factor_in_name ? cholesky_factor_map(factor, factor_in_name)
+      : resume         ? cholesky_factor_resume(factor, checkpoint_file_name)
+      : input_tiles    ? cholesky_factor_factor_tiles(factor, input_tiles)
+                       : cholesky_factor_factor(factor, packed)) {
+    goto cleanup;
+  }
+  report.decomposition_time = (get_time_monotonic() - phase_start) / 1e9;
+  for (i = 0; (factor || sparse) && i < total_threads; ++i) {
+    thread_cpu_times[i] =
+        factor ? cholesky_factor_cpu_time(factor, i) : cholesky_sparse_cpu_time(sparse, i);
+  }
+  report.thread_cpu_times = factor || sparse ? thread_cpu_times : NULL;
+
+  print_full_time("on cholesky decomposition");
 
-  for (i = 1; i < total_threads; ++i) {
-    if (pthread_join(threads[i], 0)) {
-      fprintf(stderr, "Cannot wait for thread #%d\n", i);
+  if (factor && cholesky_factor_trace(factor)) {
+    trace_print_summary(cholesky_factor_trace(factor));
+    if (trace_file_name) {
+      trace_write_chrome(cholesky_factor_trace(factor), trace_file_name);
     }
   }
 
-  print_full_time("on cholesky decomposition");
+  // The modified system replaces the factored one, for the solve and the
+  // verification.
+  if (update_rank) {
+    update_sign = update_rank < 0 ? -1 : 1;
+    update_rank = abs(update_rank);
+    if (!(update_vectors = (double*)malloc((size_t)matrix_size * update_rank * sizeof(double)))) {
+      printf("Not enough memory\n");
+      goto cleanup;
+    }
+    fill_update(matrix_size, update_rank, update_sign, update_vectors, packed, vector_answer, rhs);
+
+    phase_start = get_time_monotonic();
+    if (cholesky_factor_update(factor, update_vectors, update_rank, update_sign)) {
+      printf("Cannot %s the factor\n", update_sign > 0 ? "update" : "downdate");
+      goto cleanup;
+    }
+    report.update_time = (get_time_monotonic() - phase_start) / 1e9;
+    printf("Rank-%d %s: %.3f ms\n", update_rank, update_sign > 0 ? "update" : "downdate",
+           report.update_time * 1e3);
+
+    for (i = 0; i < matrix_size; i++) {
+      exact_rhs[i] = rhs[i];
+      for (c = 0; c < rhs_count; ++c) {
+        vector[i * rhs_count + c] = (c + 1) * rhs[i];
+      }
+    }
+  }
 
-  // Solve the resulting triangular systems.
-  if (solve_lower_triangle_matrix_system(matrix_size, matrix, vector, workspace, block_size)) {
-    printf("Cannot solve R^T y = b part\n");
+  if (factor_out_name && cholesky_factor_save(factor, factor_out_name)) {
+    printf("Cannot write factor %s\n", factor_out_name);
     goto cleanup;
   }
 
-  if (solve_upper_triangle_matrix_diagonal_system(matrix_size, matrix, diagonal, vector, workspace,
-                                                  block_size)) {
-    printf("Cannot solve D R x = y part\n");
+  // Solve the resulting triangular systems for all right-hand sides.
+  phase_start = get_time_monotonic();
+  if (ooc      ? cholesky_ooc_solve(ooc, vector, rhs_count)
+      : sparse ? cholesky_sparse_solve(sparse, vector, rhs_count)
+               : cholesky_factor_solve(factor, vector, rhs_count)) {
+    printf("Cannot solve R^T D R x = b\n");
     goto cleanup;
   }
+  report.solve_time = (get_time_monotonic() - phase_start) / 1e9;
 
-  if (matrix_size < 15) {
+  if (matrix_size < 15 && factor && !cholesky_factor_profile(factor)) {
     printf("cholesky decomposition:\n");
-    printf_matrix(matrix_size, matrix);
+    // Small enough for the stack; the input matrix is kept for verification.
+    if (options.mixed_precision) {
+      tiles_float_to_packed(matrix_size, block_size, cholesky_factor_tiles_float(factor), printed);
+    } else {
+      tiles_to_packed(matrix_size, block_size, cholesky_factor_tiles(factor), printed);
+    }
+    printf_matrix(matrix_size, printed);
     printf("\ndiagonal:\n");
     for (i = 0; i < matrix_size; i++) {
-      printf("%.1f ", diagonal[i]);
+      printf("%.1f ", cholesky_factor_diagonal(factor)[i]);
     }
     printf("\n\n");
   }
 
   print_time("on algorithm");
 
-  // Verify results by calculating error and residual.
+  // Verify results by calculating error and residual. With several
+  // right-hand sides the worst column is reported.
   residual = 0;
   rhs_norm = 0;
   answer_error = 0;
 
-  if (argc == 4) {
-    fill_matrix(matrix_size, matrix, vector, rhs);
-  } else if (argc == 5) {
-    read_matrix(matrix_size, &matrix, vector, rhs, argv[3]);
-  }
+  for (c = 0; c < rhs_count; ++c) {
+    for (i = 0; i < matrix_size; ++i) {
+      column[i] = vector[i * rhs_count + c];
+    }
+    if (bandwidth >= 0) {
+      skyline_vector_multiply(&skyline, column, rhs);
+    } else if (sparse) {
+      sparse_matrix_vector_multiply(&sparse_matrix, column, rhs);
+    } else if (packed) {
+      packed_matrix_vector_multiply(matrix_size, packed, column, rhs);
+    } else if (ooc_source_multiply(&source, matrix_size, block_size, column, rhs)) {
+      printf("Not enough memory\n");
+      goto cleanup;
+    }
 
-  for (i = 0; i < matrix_size; ++i) {
-    residual += (exact_rhs[i] - rhs[i]) * (exact_rhs[i] - rhs[i]);
-    rhs_norm += exact_rhs[i] * exact_rhs[i];
-    answer_error += (vector_answer[i] - vector[i]) * (vector_answer[i] - vector[i]);
-  }
+    column_residual = 0;
+    column_rhs_norm = 0;
+    column_error = 0;
+    for (i = 0; i < matrix_size; ++i) {
+      column_residual += ((c + 1) * exact_rhs[i] - rhs[i]) * ((c + 1) * exact_rhs[i] - rhs[i]);
+      column_rhs_norm += ((c + 1) * exact_rhs[i]) * ((c + 1) * exact_rhs[i]);
+      column_error +=
+          ((c + 1) * vector_answer[i] - column[i]) * ((c + 1) * vector_answer[i] - column[i]);
+    }
 
-  residual = sqrt(residual);
-  rhs_norm = sqrt(rhs_norm);
-  answer_error = sqrt(answer_error);
+    if (sqrt(column_residual) / sqrt(column_rhs_norm) >= residual / rhs_norm || !c) {
+      residual = sqrt(column_residual);
+      rhs_norm = sqrt(column_rhs_norm);
+    }
+    if (sqrt(column_error) > answer_error) {
+      answer_error = sqrt(column_error);
+    }
+  }
 
   printf("\n");
-  printf("Error: %11.5le ; Residual: %11.5le (%11.5le)\n", answer_error, residual,
+  printf("Error: %11.5le ; Residual: %11.5le (%11.5le)", answer_error, residual,
          residual / rhs_norm);
+  if (options.mixed_precision) {
+    printf(" ; Refinement iterations: %d", cholesky_factor_iterations(factor));
+  }
+  printf("\n");
+  report.error = answer_error;
+  report.residual = residual;
+  report.residual_rel = residual / rhs_norm;
+  report.iterations = factor ? cholesky_factor_iterations(factor) : 0;
+  report.success = 1;
   printf("Total time in seconds: %.2f\n", WallTimerGet() / 100.0);
   printf("CPU time in seconds: %.2f\n", TimerGet() / 100.0);
   printf("\n");
 
 cleanup:
+  if (report_file_name) {
+    report.total_time = (get_time_monotonic() - run_start) / 1e9;
+    report.cpu_time = TimerGet() / 100.0;
+    report_write_json(&report, report_file_name);
+  }
   free(matrix);
-  free(cholesky_args);
-  free(threads);
-  pthread_barrier_destroy(&barrier);
+  free(vector_answer);
+  free(update_vectors);
+  skyline_destroy(&skyline);
+  sparse_matrix_destroy(&sparse_matrix);
+  if (binary) {
+    matrix_file_unmap(&input);
+  }
+  cholesky_factor_destroy(factor);
+  cholesky_ooc_destroy(ooc);
+  cholesky_sparse_destroy(sparse);
 
   return 0;
 }
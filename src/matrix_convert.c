@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "array_io.h"
+#include "array_op.h"
+#include "matrix_file.h"
+#include "read_threaded.h"
+#include "tile_matrix.h"
+
+static void print_usage(const char* program_name) {
+  printf("Usage: %s [-t block_size] <n> <text_file> <binary_file>\n", program_name);
+}
+
+// Converts a text matrix file to the binary format of matrix_file.h.
+//
+// Usage: ./matrix_convert [-t block_size] <matrix_size> <text_file> <binary_file>
+//
+// The binary file holds the packed upper triangle, or with -t the tile-major
+// layout for the given block size, which the solver loads without conversion
+// when it runs with the same block size.
+int main(int argc, char* argv[]) {
+  int matrix_size, opt;
+  int block_size = 0;
+  int result;
+  const char* program_name = argv[0];
+
+  double* matrix;
+  double* vector_answer;
+  double* rhs;
+  double* tiles = NULL;
+
+  while ((opt = getopt(argc, argv, "t:")) != -1) {
+    if (opt == 't' && (block_size = atoi(optarg)) > 0) {
+      continue;
+    }
+    print_usage(program_name);
+    return -1;
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if (argc != 4) {
+    print_usage(program_name);
+    return 0;
+  }
+
+  matrix_size = atoi(argv[1]);
+  if (matrix_size <= 0 || block_size > matrix_size) {
+    printf("Wrong input parameters\n");
+    return -1;
+  }
+
+  // The reader also accumulates a right-hand side, which is discarded here.
+  if (!(matrix = (double*)malloc(
+            (packed_row_offset(matrix_size, matrix_size) + 2 * matrix_size) * sizeof(double)))) {
+    printf("Not enough memory\n");
+    return -2;
+  }
+  vector_answer = matrix + packed_row_offset(matrix_size, matrix_size);
+  rhs = vector_answer + matrix_size;
+  fill_vector_answer(matrix_size, vector_answer);
+
+  if (read_matrix_threaded(matrix_size, matrix, vector_answer, rhs, argv[2],
+                           sysconf(_SC_NPROCESSORS_ONLN))) {
+    printf("Cannot read matrix\n");
+    free(matrix);
+    return -3;
+  }
+
+  if (!block_size) {
+    result = matrix_file_write(argv[3], matrix_size, MATRIX_LAYOUT_PACKED, 0, matrix);
+  } else if ((tiles = tile_matrix_alloc(matrix_size, block_size))) {
+    packed_to_tiles(matrix_size, block_size, matrix, tiles);
+    result = matrix_file_write(argv[3], matrix_size, MATRIX_LAYOUT_TILES, block_size, tiles);
+  } else {
+    printf("Not enough memory\n");
+    result = -2;
+  }
+
+  free(matrix);
+  free(tiles);
+  return result;
+}
@@ -0,0 +1,216 @@
+#include "matrix_file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tile_matrix.h"
+
+// The magic without its version character, and the version written.
+static const char MATRIX_FILE_MAGIC[7] = {'C', 'H', 'O', 'L', 'M', 'A', 'T'};
+static const char MATRIX_FILE_VERSION = '2';
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+
+// Number of payload elements for a matrix or factor stored in the given
+// layout.
+static size_t matrix_file_length(int matrix_size, MatrixLayout layout, int block_size,
+                                 MatrixContent content) {
+  if (content != MATRIX_CONTENT_MATRIX) {
+    return tile_matrix_length(matrix_size, block_size) + matrix_size;
+  }
+  if (layout == MATRIX_LAYOUT_TILES) {
+    return tile_matrix_length(matrix_size, block_size);
+  }
+  return ((size_t)matrix_size * (matrix_size + 1)) / 2;
+}
+
+// Returns: the format version of a magic, 0 if it is not a known one.
+static int matrix_file_version(const char* magic) {
+  if (memcmp(magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC)) ||
+      magic[sizeof(MATRIX_FILE_MAGIC)] < '1' ||
+      magic[sizeof(MATRIX_FILE_MAGIC)] > MATRIX_FILE_VERSION) {
+    return 0;
+  }
+  return magic[sizeof(MATRIX_FILE_MAGIC)] - '0';
+}
+
+int matrix_file_is_binary(const char* file_name) {
+  char magic[sizeof(((MatrixFileHeader*)0)->magic)];
+  FILE* file = fopen(file_name, "rb");
+  int binary;
+
+  if (!file) {
+    return 0;
+  }
+  binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && matrix_file_version(magic);
+  fclose(file);
+  return binary;
+}
+
+// FNV-1a over 64-bit words instead of bytes, which keeps pace with reading
+// the file from the page cache. Continues from hash, so that a payload in
+// two parts hashes as one.
+static uint64_t matrix_file_hash(uint64_t hash, const double* data, size_t length) {
+  uint64_t word;
+  size_t i;
+
+  for (i = 0; i < length; ++i) {
+    memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint64_t matrix_file_checksum(const double* data, size_t length) {
+  return matrix_file_hash(FNV_OFFSET_BASIS, data, length);
+}
+
+// Fills the fields of a header that all files share.
+static void matrix_file_header(MatrixFileHeader* header, int matrix_size, MatrixLayout layout,
+                               int block_size, MatrixContent content) {
+  memset(header, 0, sizeof(MatrixFileHeader));
+  memcpy(header->magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC));
+  header->magic[sizeof(MATRIX_FILE_MAGIC)] = MATRIX_FILE_VERSION;
+  header->layout = layout;
+  header->dtype = MATRIX_DTYPE_FLOAT64;
+  header->block_size = layout == MATRIX_LAYOUT_TILES ? block_size : 0;
+  header->content = content;
+  header->matrix_size = matrix_size;
+  header->length = matrix_file_length(matrix_size, layout, block_size, content);
+}
+
+// Writes the header and a payload of head_length elements of head followed
+// by the rest of header->length from tail.
+static int matrix_file_store(const char* file_name, const MatrixFileHeader* header,
+                             const double* head, size_t head_length, const double* tail) {
+  size_t tail_length = header->length - head_length;
+  FILE* file;
+
+  if (!(file = fopen(file_name, "wb"))) {
+    printf("Error: cannot open output file\n");
+    return -1;
+  }
+  if (fwrite(header, sizeof(MatrixFileHeader), 1, file) != 1 ||
+      fwrite(head, sizeof(double), head_length, file) != head_length ||
+      (tail_length && fwrite(tail, sizeof(double), tail_length, file) != tail_length)) {
+    printf("Cannot write matrix to file\n");
+    fclose(file);
+    return -1;
+  }
+  if (fclose(file)) {
+    printf("Cannot write matrix to file\n");
+    return -1;
+  }
+  return 0;
+}
+
+int matrix_file_write(const char* file_name, int matrix_size, MatrixLayout layout, int block_size,
+                      const double* data) {
+  MatrixFileHeader header;
+
+  matrix_file_header(&header, matrix_size, layout, block_size, MATRIX_CONTENT_MATRIX);
+  header.checksum = matrix_file_checksum(data, header.length);
+  return matrix_file_store(file_name, &header, data, header.length, NULL);
+}
+
+int matrix_file_write_factor(const char* file_name, MatrixContent content, int matrix_size,
+                             int block_size, int step, int schedule, const double* tiles,
+                             const double* diagonal) {
+  MatrixFileHeader header;
+  size_t length = tile_matrix_length(matrix_size, block_size);
+  char* temporary = (char*)malloc(strlen(file_name) + sizeof(".tmp"));
+  int result;
+
+  if (!temporary) {
+    printf("Not enough memory\n");
+    return -1;
+  }
+  matrix_file_header(&header, matrix_size, MATRIX_LAYOUT_TILES, block_size, content);
+  if (content == MATRIX_CONTENT_CHECKPOINT) {
+    header.step = step;
+    header.schedule = schedule;
+  }
+  header.checksum = matrix_file_hash(matrix_file_checksum(tiles, length), diagonal, matrix_size);
+
+  strcpy(temporary, file_name);
+  strcat(temporary, ".tmp");
+  result = matrix_file_store(temporary, &header, tiles, length, diagonal);
+  if (!result && rename(temporary, file_name)) {
+    printf("Cannot write matrix to file\n");
+    result = -1;
+  }
+  if (result) {
+    remove(temporary);
+  }
+  free(temporary);
+  return result;
+}
+
+int matrix_file_map(MatrixFile* file, const char* file_name, int verify) {
+  MatrixFileHeader* header;
+  struct stat st;
+  int fd, version;
+
+  memset(file, 0, sizeof(MatrixFile));
+
+  if ((fd = open(file_name, O_RDONLY)) < 0) {
+    printf("Error: cannot open input file\n");
+    return -1;
+  }
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(MatrixFileHeader)) {
+    printf("Not a binary matrix file\n");
+    close(fd);
+    return -2;
+  }
+
+  file->mapping_size = st.st_size;
+  file->mapping = mmap(NULL, file->mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file referenced.
+  close(fd);
+  if (file->mapping == MAP_FAILED) {
+    printf("Cannot map input file\n");
+    file->mapping = NULL;
+    return -1;
+  }
+
+  header = (MatrixFileHeader*)file->mapping;
+  file->header = *header;
+  file->data = (double*)(header + 1);
+
+  version = matrix_file_version(header->magic);
+  if (!version || (version == 1 && header->content != MATRIX_CONTENT_MATRIX) ||
+      header->content > MATRIX_CONTENT_CHECKPOINT ||
+      (header->content != MATRIX_CONTENT_MATRIX && header->layout != MATRIX_LAYOUT_TILES) ||
+      header->dtype != MATRIX_DTYPE_FLOAT64 ||
+      (header->layout != MATRIX_LAYOUT_PACKED && header->layout != MATRIX_LAYOUT_TILES) ||
+      header->matrix_size == 0 || header->matrix_size > 0x7fffffff ||
+      (header->layout == MATRIX_LAYOUT_TILES &&
+       (header->block_size == 0 || header->block_size > header->matrix_size)) ||
+      header->length != matrix_file_length(header->matrix_size, header->layout,
+                                           header->block_size, header->content) ||
+      header->length > (file->mapping_size - sizeof(MatrixFileHeader)) / sizeof(double)) {
+    printf("Not a binary matrix file\n");
+    matrix_file_unmap(file);
+    return -2;
+  }
+
+  if (verify && matrix_file_checksum(file->data, header->length) != header->checksum) {
+    printf("Checksum mismatch in binary matrix file\n");
+    matrix_file_unmap(file);
+    return -2;
+  }
+
+  return 0;
+}
+
+void matrix_file_unmap(MatrixFile* file) {
+  if (file->mapping) {
+    munmap(file->mapping, file->mapping_size);
+  }
+  memset(file, 0, sizeof(MatrixFile));
+}
@@ -0,0 +1,93 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary matrix files.
+//
+// A 64-byte header is followed by the upper triangle of a symmetric matrix,
+// either in packed upper triangular format or in the tile-major format of
+// tile_matrix.h, as native-endian doubles. The payload therefore starts on a
+// cache line boundary of the mapping and is used in place, without parsing
+// or copying.
+//
+// Version 2 files also hold factors: the tile-major factor R followed by the
+// N elements of D, either complete or as the checkpoint of a barrier engine
+// factorization that stopped between two block steps. Version 1 files, which
+// only held matrices, are still read.
+
+// Storage order of the payload.
+typedef enum {
+  MATRIX_LAYOUT_PACKED = 0,  // Packed upper triangle, row by row.
+  MATRIX_LAYOUT_TILES = 1,   // Tile-major with header block_size.
+} MatrixLayout;
+
+// What the payload holds.
+typedef enum {
+  MATRIX_CONTENT_MATRIX = 0,      // The matrix.
+  MATRIX_CONTENT_FACTOR = 1,      // Tile-major R and D of a complete factorization.
+  MATRIX_CONTENT_CHECKPOINT = 2,  // Tile-major R and D before block step step.
+} MatrixContent;
+
+// Element type of the payload.
+typedef enum {
+  MATRIX_DTYPE_FLOAT64 = 0,  // IEEE 754 double.
+} MatrixDtype;
+
+typedef struct _MatrixFileHeader {
+  char magic[8];         // "CHOLMAT" and the format version, '1' or '2'.
+  uint32_t layout;       // MatrixLayout of the payload.
+  uint32_t dtype;        // MatrixDtype of the payload.
+  uint32_t block_size;   // Tile size for MATRIX_LAYOUT_TILES, 0 otherwise.
+  uint32_t content;      // MatrixContent of the payload, zero in version 1.
+  uint64_t matrix_size;  // Order of the matrix N.
+  uint64_t length;       // Number of elements in the payload.
+  uint64_t checksum;     // matrix_file_checksum of the payload.
+  uint64_t step;         // First row of the next block step of a checkpoint.
+  uint32_t schedule;     // Engine-defined order of the updates of a checkpoint.
+  uint8_t padding[4];    // Zero, pads the header to 64 bytes.
+} MatrixFileHeader;
+
+// A read-only mapping of a binary matrix file.
+typedef struct _MatrixFile {
+  MatrixFileHeader header;  // Copy of the validated header.
+  double* data;             // Payload inside the mapping.
+  void* mapping;            // Start of the mapping.
+  size_t mapping_size;      // Length of the mapping in bytes.
+} MatrixFile;
+
+// Returns: non-zero if the file starts with the binary matrix magic.
+int matrix_file_is_binary(const char* file_name);
+
+// Checksum of the payload, a word-wise FNV-1a hash.
+uint64_t matrix_file_checksum(const double* data, size_t length);
+
+// Writes a matrix in the given layout, MATRIX_CONTENT_MATRIX.
+// block_size: Tile size for MATRIX_LAYOUT_TILES, ignored otherwise.
+// Returns: 0 on success, -1 if the file cannot be written.
+int matrix_file_write(const char* file_name, int matrix_size, MatrixLayout layout, int block_size,
+                      const double* data);
+
+// Writes a tile-major factor R and its diagonal D. The file is written
+// under a temporary name and renamed, so that a checkpoint replaces the
+// previous one atomically.
+// content: MATRIX_CONTENT_FACTOR or MATRIX_CONTENT_CHECKPOINT.
+// step, schedule: Header fields of a checkpoint, ignored otherwise.
+// Returns: 0 on success, -1 if the file cannot be written.
+int matrix_file_write_factor(const char* file_name, MatrixContent content, int matrix_size,
+                             int block_size, int step, int schedule, const double* tiles,
+                             const double* diagonal);
+
+// Maps a binary matrix file and validates its header. The payload of a factor
+// is the tiles; D follows them in the mapping.
+// verify: non-zero to also check the payload checksum, which reads the whole
+//         file once.
+// Returns: 0 on success, -1 if the file cannot be mapped, -2 if it is not a
+//          valid binary matrix file.
+int matrix_file_map(MatrixFile* file, const char* file_name, int verify);
+
+// Releases the mapping.
+void matrix_file_unmap(MatrixFile* file);
+
+#endif  // MATRIX_FILE_H
@@ -0,0 +1,292 @@
+#include "read_threaded.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "array_op.h"
+
+// Powers of ten that are exact in double precision.
+static const double EXACT_POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                             1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                             1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Longest token handed to strtod.
+#define MAX_TOKEN_LENGTH 512
+
+static int is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Slow path for what the fast parser does not handle exactly: long mantissas,
+// large exponents, hexadecimal floats, infinities and NaNs.
+static const char* parse_double_strtod(const char* p, const char* end, double* value) {
+  char token[MAX_TOKEN_LENGTH];
+  char* token_end;
+  int length = 0;
+
+  while (p + length < end && !is_space(p[length])) {
+    if (length == MAX_TOKEN_LENGTH - 1) {
+      return NULL;
+    }
+    token[length] = p[length];
+    ++length;
+  }
+  token[length] = 0;
+
+  *value = strtod(token, &token_end);
+  return token_end == token + length && length ? p + length : NULL;
+}
+
+// Parses one whitespace-terminated number in [p, end).
+//
+// Decimal numbers with at most 19 significant digits whose value is
+// m * 10^e with m < 2^53 and |e| <= 22 are converted with a single exact
+// multiplication or division, which is correctly rounded. Everything else
+// goes through strtod.
+// Returns: the end of the number, or NULL if it is malformed.
+static const char* parse_double(const char* p, const char* end, double* value) {
+  const char* start = p;
+  uint64_t mantissa = 0;
+  int significant = 0, digits = 0, exponent = 0;
+  int negative = 0, exponent_negative = 0, explicit_exponent = 0;
+
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p++ == '-';
+  }
+  for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+    if (significant < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      significant += mantissa != 0;
+    } else {
+      return parse_double_strtod(start, end, value);
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+      if (significant < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        significant += mantissa != 0;
+        --exponent;
+      } else {
+        return parse_double_strtod(start, end, value);
+      }
+    }
+  }
+  if (!digits) {
+    return parse_double_strtod(start, end, value);
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    if (p < end && (*p == '-' || *p == '+')) {
+      exponent_negative = *p++ == '-';
+    }
+    if (p == end || *p < '0' || *p > '9') {
+      return parse_double_strtod(start, end, value);
+    }
+    for (; p < end && *p >= '0' && *p <= '9' && explicit_exponent < 10000; ++p) {
+      explicit_exponent = explicit_exponent * 10 + (*p - '0');
+    }
+    exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+  }
+  if ((p < end && !is_space(*p)) || mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) {
+    return parse_double_strtod(start, end, value);
+  }
+
+  *value = exponent < 0 ? (double)mantissa / EXACT_POWERS_OF_TEN[-exponent]
+                        : (double)mantissa * EXACT_POWERS_OF_TEN[exponent];
+  if (negative) {
+    *value = -*value;
+  }
+  return p;
+}
+
+// Counts the whitespace-separated tokens of the chunk.
+static long count_elements(const char* p, const char* end) {
+  long count = 0;
+  int in_token = 0;
+
+  for (; p < end; ++p) {
+    count += !in_token && !is_space(*p);
+    in_token = !is_space(*p);
+  }
+  return count;
+}
+
+// Parses the chunk into the packed matrix. Rows that lie entirely inside the
+// chunk get their right-hand side directly, the others are left for the
+// caller to combine.
+static int parse_elements(ReadArgs* pa) {
+  int n = pa->matrix_size;
+  long k = pa->first_element;
+  long total = (long)n * n;
+  int i = k / n, j = k % n;
+  int started = j == 0;
+  size_t row = packed_row_offset(n, i);
+  double sum = 0, value;
+  const char* p = pa->begin;
+
+  for (; k < total; ++k) {
+    while (p < pa->end && is_space(*p)) {
+      ++p;
+    }
+    if (p == pa->end) {
+      break;
+    }
+    if (!(p = parse_double(p, pa->end, &value))) {
+      return -1;
+    }
+
+    if (j >= i) {
+      pa->matrix[row + j - i] = value;
+    }
+    sum += value * pa->vector_answer[j];
+
+    if (++j == n) {
+      if (started) {
+        pa->rhs[i] = sum;
+      } else {
+        pa->partial_row[0] = i;
+        pa->partial_sum[0] = sum;
+      }
+      row += n - i;
+      ++i;
+      j = 0;
+      sum = 0;
+      started = 1;
+    }
+  }
+
+  if (j) {
+    pa->partial_row[started] = i;
+    pa->partial_sum[started] = sum;
+  }
+  return 0;
+}
+
+// Entry point for each parser thread.
+void* read_threaded(void* ptr) {
+  ReadArgs* pa = (ReadArgs*)ptr;
+  long total = 0;
+  int t;
+
+  pa->element_count = count_elements(pa->begin, pa->end);
+  thread_barrier_wait(pa->barrier);
+
+  // Every thread computes its own offset from the counts of the others.
+  pa->first_element = 0;
+  for (t = 0; t < pa->total_threads; ++t) {
+    if (t < pa->thread_id) {
+      pa->first_element += pa->all[t].element_count;
+    }
+    total += pa->all[t].element_count;
+  }
+  pa->failed = total < (long)pa->matrix_size * pa->matrix_size || parse_elements(pa);
+  return 0;
+}
+
+// Maps the file, runs the parser threads and combines the split rows.
+int read_matrix_threaded(int matrix_size, double* matrix, double* vector_answer, double* rhs,
+                         const char* input_file_name, int total_threads) {
+  ReadArgs* args = NULL;
+  pthread_t* threads = NULL;
+  ThreadBarrier barrier;
+  struct stat st;
+  const char* text;
+  size_t size, split;
+  int fd, i, r;
+  int error = 0;
+
+  if ((fd = open(input_file_name, O_RDONLY)) < 0) {
+    printf("Error: cannot open input file\n");
+    return -1;
+  }
+  if (fstat(fd, &st) || !st.st_size) {
+    printf("Cannot read matrix from file\n");
+    close(fd);
+    return -2;
+  }
+  size = st.st_size;
+  text = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    printf("Error: cannot open input file\n");
+    return -1;
+  }
+
+  if (!(args = (ReadArgs*)malloc(total_threads * sizeof(ReadArgs))) ||
+      !(threads = (pthread_t*)malloc(total_threads * sizeof(pthread_t))) ||
+      thread_barrier_init(&barrier, total_threads)) {
+    printf("Not enough memory\n");
+    free(args);
+    free(threads);
+    munmap((void*)text, size);
+    return -2;
+  }
+
+  // Chunks end at the first whitespace after an even split, so that no
+  // number is cut in two.
+  for (i = 0; i < total_threads; ++i) {
+    split = size * (i + 1) / total_threads;
+    if (i && text + split < args[i - 1].end) {
+      split = args[i - 1].end - text;
+    }
+    while (split < size && !is_space(text[split])) {
+      ++split;
+    }
+    args[i].matrix_size = matrix_size;
+    args[i].matrix = matrix;
+    args[i].vector_answer = vector_answer;
+    args[i].rhs = rhs;
+    args[i].begin = i ? args[i - 1].end : text;
+    args[i].end = text + split;
+    args[i].partial_row[0] = args[i].partial_row[1] = -1;
+    args[i].partial_sum[0] = args[i].partial_sum[1] = 0;
+    args[i].thread_id = i;
+    args[i].total_threads = total_threads;
+    args[i].barrier = &barrier;
+    args[i].all = args;
+    args[i].failed = 0;
+  }
+
+  for (i = 0; i < matrix_size; ++i) {
+    rhs[i] = 0;
+  }
+
+  for (i = 1; i < total_threads; ++i) {
+    if (pthread_create(threads + i, 0, read_threaded, args + i)) {
+      fprintf(stderr, "Cannot create thread #%d\n", i);
+    }
+  }
+  read_threaded(args + 0);
+  for (i = 1; i < total_threads; ++i) {
+    if (pthread_join(threads[i], 0)) {
+      fprintf(stderr, "Cannot wait for thread #%d\n", i);
+    }
+  }
+
+  for (i = 0; i < total_threads; ++i) {
+    error |= args[i].failed;
+    for (r = 0; r < 2; ++r) {
+      if (args[i].partial_row[r] >= 0) {
+        rhs[args[i].partial_row[r]] += args[i].partial_sum[r];
+      }
+    }
+  }
+
+  if (error) {
+    printf("Cannot read matrix from file\n");
+  }
+
+  thread_barrier_destroy(&barrier);
+  free(args);
+  free(threads);
+  munmap((void*)text, size);
+  return error ? -2 : 0;
+}
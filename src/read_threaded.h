@@ -0,0 +1,40 @@
+#ifndef READ_THREADED_H
+#define READ_THREADED_H
+
+#include "thread_barrier.h"
+
+// Arguments passed to each parser thread.
+typedef struct _ReadArgs {
+  int matrix_size;         // Total size of the matrix (N x N).
+  double* matrix;          // Packed upper triangular output.
+  double* vector_answer;   // Known solution the right-hand side is built from.
+  double* rhs;             // Right-hand side A * vector_answer.
+  const char* begin;       // First character of this thread's chunk.
+  const char* end;         // End of this thread's chunk.
+  long element_count;      // Numbers in the chunk, counted in the first pass.
+  long first_element;      // Index of the first number of the chunk in the file.
+  int partial_row[2];      // Rows only partly in the chunk, or -1.
+  double partial_sum[2];   // Contributions of the chunk to the partial rows.
+  int thread_id;           // Unique ID for the current thread.
+  int total_threads;       // Total number of active threads.
+  ThreadBarrier* barrier;  // Synchronization barrier between the passes.
+  struct _ReadArgs* all;   // Arguments of every thread, for the prefix sum.
+  int failed;              // Non-zero if the chunk could not be parsed.
+} ReadArgs;
+
+// Entry point for pthread_create.
+void* read_threaded(void* ptr);
+
+// Multi-threaded version of read_matrix.
+//
+// The file is mapped and split into one chunk per thread at whitespace
+// boundaries. Every thread first counts the numbers in its chunk, which gives
+// the position of its first element in the matrix, and then parses them
+// straight into the packed upper triangle while summing the right-hand side
+// of its rows. Rows split between two chunks are combined at the end.
+// Returns: 0 on success, -1 if the file cannot be opened, -2 if it has too
+//          few or malformed numbers.
+int read_matrix_threaded(int matrix_size, double* matrix, double* vector_answer, double* rhs,
+                         const char* input_file_name, int total_threads);
+
+#endif  // READ_THREADED_H
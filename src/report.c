@@ -0,0 +1,87 @@
+#include "report.h"
+
+#include <math.h>
+#include <stdio.h>
+
+double report_decomposition_flops(int matrix_size) {
+  return (double)matrix_size * matrix_size * matrix_size / 3.0;
+}
+
+// Writes a JSON string or null. The names written here never need escapes
+// beyond quotes and backslashes.
+static void report_string(FILE* file, const char* value) {
+  if (!value) {
+    fprintf(file, "null");
+    return;
+  }
+  fputc('"', file);
+  for (; *value; ++value) {
+    if (*value == '"' || *value == '\\') {
+      fputc('\\', file);
+    }
+    fputc(*value, file);
+  }
+  fputc('"', file);
+}
+
+// Writes a JSON number, or null for NaN and infinities, which JSON lacks.
+static void report_number(FILE* file, const char* name, double value) {
+  if (isfinite(value)) {
+    fprintf(file, "  \"%s\": %.6e,\n", name, value);
+  } else {
+    fprintf(file, "  \"%s\": null,\n", name);
+  }
+}
+
+int report_write_json(const RunReport* report, const char* file_name) {
+  FILE* file = fopen(file_name, "w");
+  double flops, rate;
+  int i;
+
+  if (!file) {
+    printf("Cannot write report %s\n", file_name);
+    return -1;
+  }
+  flops = report->flops > 0 ? report->flops : report_decomposition_flops(report->matrix_size);
+  rate = report->decomposition_time > 0 ? flops / report->decomposition_time / 1e9 : 0;
+
+  fprintf(file, "{\n  \"config\": {\"n\": %d, \"m\": %d, \"threads\": %d, \"rhs_count\": %d, ",
+          report->matrix_size, report->block_size, report->total_threads, report->rhs_count);
+  fprintf(file, "\"engine\": ");
+  report_string(file, report->engine);
+  fprintf(file, ", \"distribution\": ");
+  report_string(file, report->distribution);
+  fprintf(file, ", \"mixed_precision\": %s, \"kernel_isa\": ",
+          report->mixed_precision ? "true" : "false");
+  report_string(file, report->kernel_isa);
+  fprintf(file, ", \"affinity\": ");
+  report_string(file, report->affinity);
+  fprintf(file, ", \"input\": ");
+  report_string(file, report->input);
+  fprintf(file, ", \"memory_budget\": %zu, \"skyline\": %s, \"batch_count\": %d",
+          report->memory_budget, report->skyline ? "true" : "false", report->batch_count);
+  fprintf(file, ", \"update_rank\": %d},\n", report->update_rank);
+
+  fprintf(file,
+          "  \"phases\": {\"initialization_s\": %.9f, \"decomposition_s\": %.9f, "
+          "\"update_s\": %.9f, \"solve_s\": %.9f, \"total_s\": %.9f},\n",
+          report->initialization_time, report->decomposition_time, report->update_time,
+          report->solve_time, report->total_time);
+  fprintf(file, "  \"cpu_time_s\": %.9f,\n  \"thread_cpu_s\": [", report->cpu_time);
+  for (i = 0; report->thread_cpu_times && i < report->total_threads; ++i) {
+    fprintf(file, "%s%.9f", i ? ", " : "", report->thread_cpu_times[i]);
+  }
+  fprintf(file, "],\n");
+  fprintf(file, "  \"gflops\": %.6f,\n", rate);
+  report_number(file, "error", report->error);
+  report_number(file, "residual", report->residual);
+  report_number(file, "residual_rel", report->residual_rel);
+  fprintf(file, "  \"refinement_iterations\": %d,\n  \"success\": %s\n}\n", report->iterations,
+          report->success ? "true" : "false");
+
+  if (fclose(file)) {
+    printf("Cannot write report %s\n", file_name);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stddef.h>
+
+// Machine-readable results of a solver run.
+//
+// The solver fills a report as it goes and writes it as one JSON object, so
+// that benchmark scripts do not have to parse the human-readable output.
+// Times are wall clock seconds of each phase; phases that were not reached
+// stay 0 and success stays 0.
+
+typedef struct _RunReport {
+  int matrix_size;                 // Total size of the matrix (N x N).
+  int block_size;                  // Size of the tiles (M x M) actually used.
+  int total_threads;               // Number of threads.
+  int rhs_count;                   // Number of right-hand sides.
+  const char* engine;              // Scheduling engine name.
+  const char* distribution;        // Tile distribution name.
+  int mixed_precision;             // Non-zero if factored in single precision.
+  const char* kernel_isa;          // Instruction set of the dispatched kernels.
+  const char* affinity;            // Affinity map, or NULL.
+  const char* input;               // Matrix file, or NULL for a generated matrix.
+  size_t memory_budget;            // Tile buffer bytes out of core, 0 in memory.
+  int skyline;                     // Non-zero if the matrix was stored as a skyline.
+  double flops;                    // Operations of the decomposition, 0 for a dense one.
+  int batch_count;                 // Systems of a batched run, 0 otherwise.
+  int update_rank;                 // Vectors of a low-rank update, negative for a downdate.
+  double initialization_time;      // Allocation, thread start and input.
+  double decomposition_time;       // Factorization, including the input conversion.
+  double update_time;              // Low-rank update of the factor.
+  double solve_time;               // Triangular solves or iterative refinement.
+  double total_time;               // Whole run, including the verification.
+  double cpu_time;                 // CPU time of the process.
+  const double* thread_cpu_times;  // CPU time of every thread in the decomposition, or NULL.
+  double error;                    // ||x - x_exact||_2 of the worst column.
+  double residual;                 // ||b - A x||_2 of the worst column.
+  double residual_rel;             // residual / ||b||_2.
+  int iterations;                  // Refinement steps with mixed_precision.
+  int success;                     // Non-zero if the system was solved.
+} RunReport;
+
+// Floating point operations of the decomposition, N^3 / 3.
+double report_decomposition_flops(int matrix_size);
+
+// Writes the report as JSON.
+// Returns: 0 on success, -1 if the file cannot be written.
+int report_write_json(const RunReport* report, const char* file_name);
+
+#endif  // REPORT_H
@@ -0,0 +1,170 @@
+#include "skyline.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tile_matrix.h"
+
+int skyline_init(Skyline* skyline, int matrix_size, const int* first) {
+  int j;
+
+  memset(skyline, 0, sizeof(Skyline));
+  for (j = 0; j < matrix_size; ++j) {
+    if (first[j] < 0 || first[j] > j) {
+      return -1;
+    }
+  }
+
+  skyline->matrix_size = matrix_size;
+  skyline->first = (int*)malloc(matrix_size * sizeof(int));
+  skyline->offsets = (size_t*)malloc((matrix_size + 1) * sizeof(size_t));
+  if (!skyline->first || !skyline->offsets) {
+    skyline_destroy(skyline);
+    return -1;
+  }
+
+  memcpy(skyline->first, first, matrix_size * sizeof(int));
+  skyline->offsets[0] = 0;
+  for (j = 0; j < matrix_size; ++j) {
+    skyline->offsets[j + 1] = skyline->offsets[j] + j - first[j] + 1;
+  }
+
+  if (!(skyline->values = (double*)calloc(skyline->offsets[matrix_size], sizeof(double)))) {
+    skyline_destroy(skyline);
+    return -1;
+  }
+  return 0;
+}
+
+void skyline_destroy(Skyline* skyline) {
+  free(skyline->first);
+  free(skyline->offsets);
+  free(skyline->values);
+  memset(skyline, 0, sizeof(Skyline));
+}
+
+// Every stored column is used twice, as a column and as the mirrored row, so
+// the values are read contiguously.
+void skyline_vector_multiply(const Skyline* skyline, const double* x, double* y) {
+  int i, j;
+  double *pa, sum, xj;
+
+  memset(y, 0, skyline->matrix_size * sizeof(double));
+  for (j = 0; j < skyline->matrix_size; ++j) {
+    pa = skyline->values + skyline->offsets[j] - skyline->first[j];
+    xj = x[j];
+    sum = pa[j] * xj;
+    for (i = skyline->first[j]; i < j; ++i) {
+      sum += pa[i] * x[i];
+      y[i] += pa[i] * xj;
+    }
+    y[j] += sum;
+  }
+}
+
+int tile_profile_init(TileProfile* profile, const Skyline* skyline, int block_size) {
+  int nb = tile_count(skyline->matrix_size, block_size);
+  int bi, bj, j;
+
+  memset(profile, 0, sizeof(TileProfile));
+  profile->matrix_size = skyline->matrix_size;
+  profile->block_size = block_size;
+  profile->first_block = (int*)malloc(nb * sizeof(int));
+  profile->last_block = (int*)malloc(nb * sizeof(int));
+  profile->offsets = (size_t*)malloc((nb + 1) * sizeof(size_t));
+  if (!profile->first_block || !profile->last_block || !profile->offsets) {
+    tile_profile_destroy(profile);
+    return -1;
+  }
+
+  // A block column starts with the highest first row of its columns.
+  for (bj = 0; bj < nb; ++bj) {
+    profile->first_block[bj] = bj;
+    profile->last_block[bj] = bj;
+    for (j = bj * block_size; j < skyline->matrix_size && j < (bj + 1) * block_size; ++j) {
+      if (skyline->first[j] / block_size < profile->first_block[bj]) {
+        profile->first_block[bj] = skyline->first[j] / block_size;
+      }
+    }
+  }
+
+  // Block row bi ends at the last block column that reaches up to it. The
+  // tiles in between whose columns start further down are stored but zero.
+  for (bj = 0; bj < nb; ++bj) {
+    for (bi = profile->first_block[bj]; bi < bj; ++bi) {
+      profile->last_block[bi] = bj;
+    }
+  }
+
+  profile->offsets[0] = 0;
+  for (bi = 0; bi < nb; ++bi) {
+    profile->offsets[bi + 1] = profile->offsets[bi] + profile->last_block[bi] - bi + 1;
+  }
+  return 0;
+}
+
+void tile_profile_destroy(TileProfile* profile) {
+  free(profile->first_block);
+  free(profile->last_block);
+  free(profile->offsets);
+  memset(profile, 0, sizeof(TileProfile));
+}
+
+size_t tile_profile_length(const TileProfile* profile) {
+  int nb = tile_count(profile->matrix_size, profile->block_size);
+  return profile->offsets[nb] * profile->block_size * profile->block_size;
+}
+
+double* tile_profile_block(const TileProfile* profile, double* tiles, int row, int column,
+                           int matrix_size, int block_size) {
+  int bi = row / block_size;
+
+  if (!profile) {
+    return tile_block(tiles, row, column, matrix_size, block_size);
+  }
+  return tiles + (profile->offsets[bi] + column / block_size - bi) * block_size * block_size;
+}
+
+int tile_profile_row_end(const TileProfile* profile, int row, int matrix_size) {
+  int end;
+
+  if (!profile) {
+    return matrix_size;
+  }
+  end = (profile->last_block[row / profile->block_size] + 1) * profile->block_size;
+  return end < matrix_size ? end : matrix_size;
+}
+
+int tile_profile_column_start(const TileProfile* profile, int column) {
+  return profile ? profile->first_block[column / profile->block_size] * profile->block_size : 0;
+}
+
+// Walks the columns of the stored tiles once; element (r, c) of the envelope
+// lands in tile (i / block_size, c / block_size), whose rows are pm wide.
+void skyline_to_tile_rows(const Skyline* skyline, const TileProfile* profile, double* tiles,
+                          int first_row, int row_step) {
+  int matrix_size = skyline->matrix_size;
+  int block_size = profile->block_size;
+  int i, j, r, c, end, pn, pm;
+  double *column, *tile;
+
+  for (i = first_row * block_size; i < matrix_size; i += row_step * block_size) {
+    pn = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    end = tile_profile_row_end(profile, i, matrix_size);
+    tile = tile_profile_block(profile, tiles, i, i, matrix_size, block_size);
+    memset(tile, 0,
+           (profile->offsets[i / block_size + 1] - profile->offsets[i / block_size]) *
+               block_size * block_size * sizeof(double));
+
+    for (j = i; j < end; j += block_size) {
+      pm = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      tile = tile_profile_block(profile, tiles, i, j, matrix_size, block_size);
+      for (c = j; c < j + pm; ++c) {
+        column = skyline->values + skyline->offsets[c] - skyline->first[c];
+        for (r = (skyline->first[c] > i ? skyline->first[c] : i); r < i + pn && r <= c; ++r) {
+          tile[(r - i) * pm + c - j] = column[r];
+        }
+      }
+    }
+  }
+}
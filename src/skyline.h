@@ -0,0 +1,77 @@
+#ifndef SKYLINE_H
+#define SKYLINE_H
+
+#include <stddef.h>
+
+// Skyline (envelope) storage for banded symmetric matrices.
+//
+// Column j of the upper triangle is stored from its first nonzero row down
+// to the diagonal, one column after another, so a matrix whose columns reach
+// at most w rows above the diagonal takes about N * (w + 1) doubles instead
+// of N^2 / 2. The factorization R^T * D * R creates no fill above the
+// envelope, so R has the same profile.
+//
+// The barrier engine works on the same profile one level up: block row bi
+// only stores its tiles from the diagonal to the last block column whose
+// envelope reaches the row, in the slot layout of tile_matrix.h, and tiles
+// that lie entirely above the envelope of their column are skipped by every
+// update and solve.
+
+typedef struct _Skyline {
+  int matrix_size;  // Total size of the matrix (N x N).
+  int* first;       // First stored row of every column, first[j] <= j.
+  size_t* offsets;  // Start of every column in values, N + 1 entries.
+  double* values;   // Columns from their first row down to the diagonal.
+} Skyline;
+
+typedef struct _TileProfile {
+  int matrix_size;   // Total size of the matrix (N x N).
+  int block_size;    // Size of the tiles (M x M).
+  int* first_block;  // First block row that can be nonzero in every block column.
+  int* last_block;   // Last stored block column of every block row.
+  size_t* offsets;   // First tile of every block row, nb + 1 entries.
+} TileProfile;
+
+// Allocates a zero matrix with the envelope given by the first row of every
+// column, which is copied.
+// Returns: 0 on success, -1 if a first row is out of range or there is not
+//          enough memory.
+int skyline_init(Skyline* skyline, int matrix_size, const int* first);
+
+// Releases the storage; a zeroed Skyline is left alone.
+void skyline_destroy(Skyline* skyline);
+
+// Symmetric matrix-vector product y = A * x.
+void skyline_vector_multiply(const Skyline* skyline, const double* x, double* y);
+
+// Derives the block profile of the skyline for the given tile size.
+// Returns: 0 on success, -1 if there is not enough memory.
+int tile_profile_init(TileProfile* profile, const Skyline* skyline, int block_size);
+
+// Releases the profile; a zeroed TileProfile is left alone.
+void tile_profile_destroy(TileProfile* profile);
+
+// Number of doubles needed to store the tiles of the profile.
+size_t tile_profile_length(const TileProfile* profile);
+
+// The functions below take a NULL profile for the dense layout of
+// tile_matrix.h, so that the engines share one code path.
+//
+// Returns a pointer to the tile which starts at element (row, column), which
+// must be stored, i.e. column < tile_profile_row_end(profile, row).
+double* tile_profile_block(const TileProfile* profile, double* tiles, int row, int column,
+                           int matrix_size, int block_size);
+
+// End of the stored tiles of the block row starting at element row.
+int tile_profile_row_end(const TileProfile* profile, int row, int matrix_size);
+
+// First element row of the block rows that can be nonzero in the block
+// column starting at element column; the tiles above it stay zero.
+int tile_profile_column_start(const TileProfile* profile, int column);
+
+// Copies the block rows first_row, first_row + row_step, ... of a skyline to
+// the tiles of its profile, zeroing the stored tiles above the envelope.
+void skyline_to_tile_rows(const Skyline* skyline, const TileProfile* profile, double* tiles,
+                          int first_row, int row_step);
+
+#endif  // SKYLINE_H
@@ -0,0 +1,97 @@
+#include "solve_threaded.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "array_op.h"
+
+// Entry point for each solver thread.
+void* solve_threaded(void* ptr) {
+  SolveArgs* pa = (SolveArgs*)ptr;
+
+  solve_system(pa->matrix_size, pa->matrix, pa->diagonal, pa->profile, pa->rhs, pa->rhs_count,
+               pa->block_size, pa->thread_id, pa->total_threads, pa->barrier, pa->error);
+
+  return 0;
+}
+
+// Forward substitution R^T * D * W = B, then backward substitution R * X = W.
+int solve_system(int matrix_size, double* matrix, double* diagonal, const TileProfile* profile,
+                 double* rhs, int rhs_count, int block_size, int thread_id, int total_threads,
+                 ThreadBarrier* barrier, int* error) {
+  int i, j, residue, end;
+  int pi_n, pj_n;
+  int step = total_threads * block_size;
+  double *xi, *xj;
+
+  // Forward substitution: block row i is final once its owner has applied
+  // every earlier row and the diagonal block.
+  for (i = 0; i < matrix_size; i += block_size) {
+    pi_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    xi = rhs + i * rhs_count;
+
+    if ((i / block_size) % total_threads == thread_id &&
+        lower_triangle_block_diagonal_solve(
+            pi_n, rhs_count, tile_profile_block(profile, matrix, i, i, matrix_size, block_size),
+            diagonal + i, xi)) {
+      *error = 1;
+    }
+
+    thread_barrier_wait(barrier);
+    if (*error) {
+      return -1;
+    }
+
+    // Start at the first block row after i owned by this thread.
+    end = tile_profile_row_end(profile, i, matrix_size);
+    j = i + block_size +
+        ((thread_id - (i / block_size + 1) % total_threads + total_threads) % total_threads) *
+            block_size;
+    for (; j < end; j += step) {
+      if (tile_profile_column_start(profile, j) > i) {
+        continue;
+      }
+      pj_n = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      main_blocks_diagonal_multiply(
+          pi_n, pj_n, rhs_count, tile_profile_block(profile, matrix, i, j, matrix_size, block_size),
+          xi, diagonal + i, rhs + j * rhs_count);
+    }
+  }
+
+  // Backward substitution: the same ownership, walking up the block rows.
+  residue = matrix_size - (matrix_size % block_size);
+  if (residue == matrix_size) {
+    residue -= block_size;
+  }
+
+  for (i = residue; i >= 0; i -= block_size) {
+    pi_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    xi = rhs + i * rhs_count;
+
+    if ((i / block_size) % total_threads == thread_id &&
+        upper_triangle_block_solve(
+            pi_n, rhs_count, tile_profile_block(profile, matrix, i, i, matrix_size, block_size),
+            xi)) {
+      *error = 1;
+    }
+
+    thread_barrier_wait(barrier);
+    if (*error) {
+      return -1;
+    }
+
+    // Only the block rows from the top of the envelope of column i on.
+    j = tile_profile_column_start(profile, i);
+    j += ((thread_id - (j / block_size) % total_threads + total_threads) % total_threads) *
+         block_size;
+    for (; j < i; j += step) {
+      pj_n = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      xj = rhs + j * rhs_count;
+      main_blocks_multiply_subtract(
+          pj_n, pi_n, rhs_count, tile_profile_block(profile, matrix, j, i, matrix_size, block_size),
+          xi, xj);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef SOLVE_THREADED_H
+#define SOLVE_THREADED_H
+
+#include "skyline.h"
+#include "thread_barrier.h"
+
+// Arguments passed to each solver thread.
+typedef struct _SolveArgs {
+  int matrix_size;             // Total size of the matrix (N x N).
+  double* matrix;              // Tile-major factor R from the decomposition.
+  double* diagonal;            // Diagonal scaling elements D.
+  const TileProfile* profile;  // Skyline tile layout of the factor, or NULL.
+  double* rhs;                 // N x K right-hand sides, row-major, solved in place.
+  int rhs_count;               // Number of right-hand sides K.
+  int block_size;              // Size of the computation blocks (M x M).
+  int thread_id;               // Unique ID for the current thread.
+  int total_threads;           // Total number of active threads.
+  ThreadBarrier* barrier;      // Synchronization barrier.
+  int* error;                  // Shared error flag for re-entrant reporting.
+} SolveArgs;
+
+// Entry point for pthread_create.
+void* solve_threaded(void* ptr);
+
+// Multi-threaded solution of R^T * D * R * X = B for a block of right-hand
+// sides.
+//
+// Block row i of X is owned by thread i mod total_threads, which applies
+// every update to it. On each step the owner of the current block row solves
+// it with the diagonal block, and after one barrier all threads use it to
+// update their own block rows with matrix-matrix kernels. With a profile the
+// factor is in its skyline tile layout, and the zero tiles above the
+// envelope are skipped.
+// Returns: 0 on success, -1 if a diagonal block is singular.
+int solve_system(int matrix_size, double* matrix, double* diagonal, const TileProfile* profile,
+                 double* rhs, int rhs_count, int block_size, int thread_id, int total_threads,
+                 ThreadBarrier* barrier, int* error);
+
+#endif  // SOLVE_THREADED_H
@@ -0,0 +1,186 @@
+#include "sparse_matrix.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// One element while a matrix is assembled from coordinates.
+typedef struct _SparseEntry {
+  int row;       // Row of the element.
+  int column;    // Column of the element.
+  double value;  // Value of the element.
+} SparseEntry;
+
+static int sparse_entry_compare(const void* a, const void* b) {
+  const SparseEntry* x = (const SparseEntry*)a;
+  const SparseEntry* y = (const SparseEntry*)b;
+
+  if (x->row != y->row) {
+    return x->row < y->row ? -1 : 1;
+  }
+  return x->column < y->column ? -1 : x->column > y->column;
+}
+
+// Builds the CSR arrays from an unsorted list of entries, summing duplicates.
+// Returns: 0 on success, -1 if there is not enough memory.
+static int sparse_from_entries(int n, SparseEntry* entries, size_t count, SparseMatrix* matrix) {
+  size_t k, length = 0;
+
+  memset(matrix, 0, sizeof(SparseMatrix));
+  qsort(entries, count, sizeof(SparseEntry), sparse_entry_compare);
+
+  matrix->matrix_size = n;
+  matrix->row_start = (size_t*)calloc(n + 1, sizeof(size_t));
+  matrix->columns = (int*)malloc((count ? count : 1) * sizeof(int));
+  matrix->values = (double*)malloc((count ? count : 1) * sizeof(double));
+  if (!matrix->row_start || !matrix->columns || !matrix->values) {
+    sparse_matrix_destroy(matrix);
+    return -1;
+  }
+
+  for (k = 0; k < count; ++k) {
+    if (length && entries[k].row == entries[k - 1].row &&
+        entries[k].column == entries[k - 1].column) {
+      matrix->values[length - 1] += entries[k].value;
+      continue;
+    }
+    matrix->columns[length] = entries[k].column;
+    matrix->values[length] = entries[k].value;
+    ++matrix->row_start[entries[k].row + 1];
+    ++length;
+  }
+  for (k = 0; k < (size_t)n; ++k) {
+    matrix->row_start[k + 1] += matrix->row_start[k];
+  }
+  return 0;
+}
+
+int sparse_read_matrix_market(const char* file_name, SparseMatrix* matrix) {
+  char line[1024], object[64], format[64], field[64], symmetry[64];
+  FILE* file = fopen(file_name, "r");
+  SparseEntry* entries;
+  long rows, columns, count, k;
+  size_t length = 0;
+  int i, j, symmetric, result;
+  double value;
+
+  memset(matrix, 0, sizeof(SparseMatrix));
+  if (!file) {
+    printf("Error: cannot open input file\n");
+    return -1;
+  }
+
+  if (!fgets(line, sizeof(line), file) ||
+      sscanf(line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) != 4 ||
+      strcasecmp(object, "matrix") || strcasecmp(format, "coordinate") ||
+      (strcasecmp(field, "real") && strcasecmp(field, "integer")) ||
+      (strcasecmp(symmetry, "symmetric") && strcasecmp(symmetry, "general"))) {
+    printf("Not a real coordinate Matrix Market file\n");
+    fclose(file);
+    return -2;
+  }
+  symmetric = !strcasecmp(symmetry, "symmetric");
+
+  // Comments run up to the size line.
+  do {
+    if (!fgets(line, sizeof(line), file)) {
+      fclose(file);
+      return -2;
+    }
+  } while (line[0] == '%');
+  if (sscanf(line, "%ld %ld %ld", &rows, &columns, &count) != 3 || rows != columns || rows <= 0 ||
+      rows > 0x7fffffff || count < 0) {
+    printf("Matrix Market file is not a square matrix\n");
+    fclose(file);
+    return -2;
+  }
+
+  if (!(entries = (SparseEntry*)malloc((2 * count + 1) * sizeof(SparseEntry)))) {
+    fclose(file);
+    return -3;
+  }
+
+  for (k = 0; k < count; ++k) {
+    if (fscanf(file, "%d %d %lf", &i, &j, &value) != 3 || i < 1 || j < 1 || i > rows ||
+        j > rows) {
+      printf("Cannot read matrix from file\n");
+      free(entries);
+      fclose(file);
+      return -2;
+    }
+    // Only the upper triangle of a general file is used, and it is mirrored.
+    if (!symmetric && i > j) {
+      continue;
+    }
+    entries[length].row = i - 1;
+    entries[length].column = j - 1;
+    entries[length++].value = value;
+    if (i != j) {
+      entries[length].row = j - 1;
+      entries[length].column = i - 1;
+      entries[length++].value = value;
+    }
+  }
+  fclose(file);
+
+  result = sparse_from_entries((int)rows, entries, length, matrix) ? -3 : 0;
+  free(entries);
+  return result;
+}
+
+int sparse_fill_grid(int n, SparseMatrix* matrix) {
+  int width = (int)ceil(sqrt((double)n));
+  int v, k, neighbour;
+  int offsets[4] = {-width, -1, 1, width};
+  SparseEntry* entries = (SparseEntry*)malloc(5 * (size_t)n * sizeof(SparseEntry));
+  size_t length = 0;
+  int result;
+
+  if (!entries) {
+    return -1;
+  }
+
+  for (v = 0; v < n; ++v) {
+    entries[length].row = v;
+    entries[length].column = v;
+    entries[length++].value = 4.0;
+    for (k = 0; k < 4; ++k) {
+      neighbour = v + offsets[k];
+      // Horizontal neighbours have to be on the same grid row.
+      if (neighbour < 0 || neighbour >= n ||
+          ((k == 1 || k == 2) && neighbour / width != v / width)) {
+        continue;
+      }
+      entries[length].row = v;
+      entries[length].column = neighbour;
+      entries[length++].value = -1.0;
+    }
+  }
+
+  result = sparse_from_entries(n, entries, length, matrix);
+  free(entries);
+  return result;
+}
+
+void sparse_matrix_vector_multiply(const SparseMatrix* matrix, const double* x, double* y) {
+  int i;
+  size_t k;
+  double sum;
+
+  for (i = 0; i < matrix->matrix_size; ++i) {
+    sum = 0;
+    for (k = matrix->row_start[i]; k < matrix->row_start[i + 1]; ++k) {
+      sum += matrix->values[k] * x[matrix->columns[k]];
+    }
+    y[i] = sum;
+  }
+}
+
+void sparse_matrix_destroy(SparseMatrix* matrix) {
+  free(matrix->row_start);
+  free(matrix->columns);
+  free(matrix->values);
+  memset(matrix, 0, sizeof(SparseMatrix));
+}
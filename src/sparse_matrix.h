@@ -0,0 +1,38 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include <stddef.h>
+
+// Symmetric sparse matrices in compressed sparse row (CSR) format.
+//
+// Both triangles and the diagonal are stored, so that row i lists every
+// neighbour of i in the graph of the matrix; the columns of a row are sorted
+// and unique.
+
+typedef struct _SparseMatrix {
+  int matrix_size;    // Total size of the matrix (N x N).
+  size_t* row_start;  // Start of every row in columns and values, N + 1 entries.
+  int* columns;       // Column of every stored element.
+  double* values;     // Value of every stored element.
+} SparseMatrix;
+
+// Reads a Matrix Market coordinate file with real or integer values. A
+// symmetric file lists one triangle, which is mirrored; a general one has to
+// list both, and only its upper triangle is used.
+// Returns: 0 on success, -1 if the file cannot be opened, -2 if it is not a
+//          square real coordinate matrix or malformed, -3 if there is not
+//          enough memory.
+int sparse_read_matrix_market(const char* file_name, SparseMatrix* matrix);
+
+// Fills the 5-point Laplacian of a grid ceil(sqrt(n)) points wide, cut off
+// after n points, as a sparse test matrix.
+// Returns: 0 on success, -1 if there is not enough memory.
+int sparse_fill_grid(int n, SparseMatrix* matrix);
+
+// Computes y = A * x.
+void sparse_matrix_vector_multiply(const SparseMatrix* matrix, const double* x, double* y);
+
+// Releases the storage; a zeroed SparseMatrix is left alone.
+void sparse_matrix_destroy(SparseMatrix* matrix);
+
+#endif  // SPARSE_MATRIX_H
@@ -0,0 +1,191 @@
+#include "sparse_order.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Parts of at most this many vertices are not dissected further.
+const int ND_LEAF_SIZE = 64;
+
+// Breadth-first sweeps spent looking for a pseudo-peripheral root.
+const int ND_ROOT_SWEEPS = 4;
+
+// Working storage of one ordering.
+typedef struct _NdContext {
+  const SparseMatrix* matrix;  // Graph to order.
+  int* order;                  // Vertices of every pending range, reordered in place.
+  int* subset;                 // Range id of every vertex.
+  int* level;                  // Breadth-first level, -1 if not reached.
+  int* queue;                  // Vertices in breadth-first order.
+  int* scratch;                // Rearranged range.
+  int* ranges;                 // Stack of pending [lo, hi) ranges.
+} NdContext;
+
+// Breadth-first search from root inside the vertices of range id, which
+// must all have level -1.
+// Returns: the number of vertices reached; queue holds them by level.
+static int nd_search(NdContext* ctx, int root, int id) {
+  const SparseMatrix* a = ctx->matrix;
+  int head = 0, tail = 1;
+  int v, u;
+  size_t k;
+
+  ctx->queue[0] = root;
+  ctx->level[root] = 0;
+  while (head < tail) {
+    v = ctx->queue[head++];
+    for (k = a->row_start[v]; k < a->row_start[v + 1]; ++k) {
+      u = a->columns[k];
+      if (ctx->subset[u] == id && ctx->level[u] < 0) {
+        ctx->level[u] = ctx->level[v] + 1;
+        ctx->queue[tail++] = u;
+      }
+    }
+  }
+  return tail;
+}
+
+static void nd_reset_levels(NdContext* ctx, int lo, int hi) {
+  int p;
+
+  for (p = lo; p < hi; ++p) {
+    ctx->level[ctx->order[p]] = -1;
+  }
+}
+
+// Queues a non-empty range for dissection. The queued ranges are disjoint,
+// so the stack never holds more than N of them.
+static void push_range(NdContext* ctx, int* top, int lo, int hi) {
+  if (hi > lo) {
+    ctx->ranges[(*top)++] = lo;
+    ctx->ranges[(*top)++] = hi;
+  }
+}
+
+// Splits range [lo, hi), pushing the ranges that still need dissection.
+// Returns: the new top of the range stack.
+static int nd_dissect(NdContext* ctx, int lo, int hi, int id, int top) {
+  const SparseMatrix* a = ctx->matrix;
+  int count = hi - lo;
+  int reached, found, depth, sweep, separator_level, below, v, u, p;
+  int parts[3], position[3];
+  size_t k;
+
+  for (p = lo; p < hi; ++p) {
+    ctx->subset[ctx->order[p]] = id;
+  }
+  if (count <= ND_LEAF_SIZE) {
+    return top;
+  }
+
+  // Components are independent; each of them is dissected on its own.
+  nd_reset_levels(ctx, lo, hi);
+  reached = nd_search(ctx, ctx->order[lo], id);
+  if (reached < count) {
+    memcpy(ctx->scratch, ctx->queue, reached * sizeof(int));
+    push_range(ctx, &top, lo, lo + reached);
+    for (p = lo; p < hi; ++p) {
+      v = ctx->order[p];
+      if (ctx->level[v] < 0) {
+        found = nd_search(ctx, v, id);
+        memcpy(ctx->scratch + reached, ctx->queue, found * sizeof(int));
+        push_range(ctx, &top, lo + reached, lo + reached + found);
+        reached += found;
+      }
+    }
+    memcpy(ctx->order + lo, ctx->scratch, count * sizeof(int));
+    return top;
+  }
+
+  // A root at the end of a long level structure gives thin middle levels.
+  depth = ctx->level[ctx->queue[count - 1]];
+  for (sweep = 0; sweep < ND_ROOT_SWEEPS; ++sweep) {
+    v = ctx->queue[count - 1];
+    nd_reset_levels(ctx, lo, hi);
+    nd_search(ctx, v, id);
+    if (ctx->level[ctx->queue[count - 1]] <= depth) {
+      break;
+    }
+    depth = ctx->level[ctx->queue[count - 1]];
+  }
+  depth = ctx->level[ctx->queue[count - 1]];
+  if (depth < 2) {
+    return top;
+  }
+
+  // The separator level is the one that holds the median vertex.
+  separator_level = ctx->level[ctx->queue[count / 2]];
+  separator_level = (separator_level < 1 ? 1 : separator_level);
+  separator_level = (separator_level > depth - 1 ? depth - 1 : separator_level);
+
+  // Vertices of the separator level without a neighbour below it join the
+  // upper part, which keeps the separator minimal. parts: 0 upper, 1 lower,
+  // 2 separator.
+  parts[0] = parts[1] = parts[2] = 0;
+  for (p = 0; p < count; ++p) {
+    v = ctx->queue[p];
+    if (ctx->level[v] == separator_level) {
+      below = 0;
+      for (k = a->row_start[v]; k < a->row_start[v + 1] && !below; ++k) {
+        u = a->columns[k];
+        below = ctx->subset[u] == id && ctx->level[u] == separator_level + 1;
+      }
+      ctx->scratch[p] = below ? 2 : 0;
+    } else {
+      ctx->scratch[p] = ctx->level[v] < separator_level ? 0 : 1;
+    }
+    ++parts[ctx->scratch[p]];
+  }
+
+  position[0] = lo;
+  position[1] = lo + parts[0];
+  position[2] = hi - parts[2];
+  for (p = 0; p < count; ++p) {
+    ctx->order[position[ctx->scratch[p]]++] = ctx->queue[p];
+  }
+
+  push_range(ctx, &top, lo, lo + parts[0]);
+  push_range(ctx, &top, lo + parts[0], hi - parts[2]);
+  return top;
+}
+
+int sparse_nested_dissection(const SparseMatrix* matrix, int* order) {
+  int n = matrix->matrix_size;
+  NdContext ctx;
+  int v, lo, hi, top, id = 0;
+
+  ctx.matrix = matrix;
+  ctx.order = order;
+  ctx.subset = (int*)malloc(n * sizeof(int));
+  ctx.level = (int*)malloc(n * sizeof(int));
+  ctx.queue = (int*)malloc(n * sizeof(int));
+  ctx.scratch = (int*)malloc(n * sizeof(int));
+  ctx.ranges = (int*)malloc(2 * (size_t)n * sizeof(int));
+  if (!ctx.subset || !ctx.level || !ctx.queue || !ctx.scratch || !ctx.ranges) {
+    free(ctx.subset);
+    free(ctx.level);
+    free(ctx.queue);
+    free(ctx.scratch);
+    free(ctx.ranges);
+    return -1;
+  }
+
+  for (v = 0; v < n; ++v) {
+    order[v] = v;
+  }
+
+  // Ranges are independent, so they are dissected in any order.
+  top = 0;
+  push_range(&ctx, &top, 0, n);
+  while (top) {
+    hi = ctx.ranges[--top];
+    lo = ctx.ranges[--top];
+    top = nd_dissect(&ctx, lo, hi, id++, top);
+  }
+
+  free(ctx.subset);
+  free(ctx.level);
+  free(ctx.queue);
+  free(ctx.scratch);
+  free(ctx.ranges);
+  return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef SPARSE_ORDER_H
+#define SPARSE_ORDER_H
+
+#include "sparse_matrix.h"
+
+// Fill-reducing ordering of a sparse matrix by nested dissection.
+//
+// The graph of the matrix is split by a vertex separator into two parts that
+// are ordered first, recursively, and the separator last, so that the
+// factors of the parts are independent and fill only arises where the
+// separators meet. Separators are taken from the middle level of a
+// breadth-first level structure rooted at a pseudo-peripheral vertex, which
+// needs no coordinates and finds the natural separators of mesh-like
+// problems. Disconnected components are ordered one after another.
+
+// Computes the ordering: order[k] is the original index of the row and
+// column that is eliminated k-th.
+// Returns: 0 on success, -1 if there is not enough memory.
+int sparse_nested_dissection(const SparseMatrix* matrix, int* order);
+
+#endif  // SPARSE_ORDER_H
@@ -0,0 +1,72 @@
+#include "thread_barrier.h"
+
+#include <unistd.h>
+
+// Rounds to spin before parking, a few tens of microseconds.
+const int THREAD_BARRIER_SPINS = 1 << 13;
+
+void thread_spin_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+int thread_barrier_init(ThreadBarrier* barrier, int total_threads) {
+  barrier->total_threads = total_threads;
+  // A spinning thread would only delay the one it waits for if they share a CPU.
+  barrier->spins = total_threads <= sysconf(_SC_NPROCESSORS_ONLN) ? THREAD_BARRIER_SPINS : 0;
+  atomic_init(&barrier->count, total_threads);
+  atomic_init(&barrier->sense, 0);
+  atomic_init(&barrier->sleepers, 0);
+
+  if (pthread_mutex_init(&barrier->lock, NULL)) {
+    return -1;
+  }
+  if (pthread_cond_init(&barrier->wake, NULL)) {
+    pthread_mutex_destroy(&barrier->lock);
+    return -1;
+  }
+  return 0;
+}
+
+int thread_barrier_wait(ThreadBarrier* barrier) {
+  // The sense cannot flip before this thread arrives, so it identifies the
+  // episode without thread-local state.
+  int sense = atomic_load_explicit(&barrier->sense, memory_order_relaxed);
+  int i;
+
+  if (atomic_fetch_sub_explicit(&barrier->count, 1, memory_order_acq_rel) == 1) {
+    atomic_store_explicit(&barrier->count, barrier->total_threads, memory_order_relaxed);
+    atomic_store(&barrier->sense, !sense);
+    // Parking threads register before they re-check the sense, so either
+    // they see the flip or this sees them.
+    if (atomic_load(&barrier->sleepers)) {
+      pthread_mutex_lock(&barrier->lock);
+      pthread_cond_broadcast(&barrier->wake);
+      pthread_mutex_unlock(&barrier->lock);
+    }
+    return 1;
+  }
+
+  for (i = 0; i < barrier->spins; ++i) {
+    if (atomic_load_explicit(&barrier->sense, memory_order_acquire) != sense) {
+      return 0;
+    }
+    thread_spin_pause();
+  }
+
+  pthread_mutex_lock(&barrier->lock);
+  atomic_fetch_add(&barrier->sleepers, 1);
+  while (atomic_load(&barrier->sense) == sense) {
+    pthread_cond_wait(&barrier->wake, &barrier->lock);
+  }
+  atomic_fetch_sub(&barrier->sleepers, 1);
+  pthread_mutex_unlock(&barrier->lock);
+
+  return 0;
+}
+
+void thread_barrier_destroy(ThreadBarrier* barrier) {
+  pthread_mutex_destroy(&barrier->lock);
+  pthread_cond_destroy(&barrier->wake);
+}
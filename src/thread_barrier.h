@@ -0,0 +1,36 @@
+#ifndef THREAD_BARRIER_H
+#define THREAD_BARRIER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Sense-reversing team barrier that spins for a bounded number of rounds
+// before parking on a condition variable.
+//
+// Short waits, as between the block steps with a small block size, are
+// resolved in user space without futex calls; long waits still release the
+// CPU. Spinning is disabled when there are more threads than online CPUs.
+
+typedef struct _ThreadBarrier {
+  int total_threads;     // Number of threads taking part in every episode.
+  int spins;             // Rounds to spin before parking, 0 to park at once.
+  atomic_int count;      // Threads yet to arrive in the current episode.
+  atomic_int sense;      // Flipped by the last thread of every episode.
+  atomic_int sleepers;   // Threads parked on the condition variable.
+  pthread_mutex_t lock;  // Protects parking.
+  pthread_cond_t wake;   // Signals the end of an episode to parked threads.
+} ThreadBarrier;
+
+// Returns: 0 on success, -1 on failure.
+int thread_barrier_init(ThreadBarrier* barrier, int total_threads);
+
+// Blocks until all threads of the team have called it.
+// Returns: 1 in exactly one thread of every episode, 0 in the others.
+int thread_barrier_wait(ThreadBarrier* barrier);
+
+void thread_barrier_destroy(ThreadBarrier* barrier);
+
+// Tells the CPU that the caller is in a spin-wait loop.
+void thread_spin_pause(void);
+
+#endif  // THREAD_BARRIER_H
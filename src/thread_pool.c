@@ -0,0 +1,153 @@
+#include "thread_pool.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Waits until the generation moves past seen, spinning as long as the team
+// barrier does before parking.
+// Returns: the new generation.
+static long thread_pool_wait_job(ThreadPool* pool, long seen) {
+  long generation;
+  int i;
+
+  for (i = 0;; ++i) {
+    if ((generation = atomic_load_explicit(&pool->generation, memory_order_acquire)) != seen) {
+      return generation;
+    }
+    if (i < pool->barrier.spins) {
+      thread_spin_pause();
+    } else if (pool->keep_hot) {
+      // Hot workers on an oversubscribed machine still let the others run.
+      sched_yield();
+      i = pool->barrier.spins;
+    } else {
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  while ((generation = atomic_load(&pool->generation)) == seen) {
+    pthread_cond_wait(&pool->wake, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return generation;
+}
+
+// Waits for jobs and runs them until the pool is destroyed.
+static void* thread_pool_worker(void* ptr) {
+  ThreadPoolWorker* worker = (ThreadPoolWorker*)ptr;
+  ThreadPool* pool = worker->pool;
+  long seen = 0;
+
+  for (;;) {
+    seen = thread_pool_wait_job(pool, seen);
+    if (atomic_load(&pool->stop)) {
+      break;
+    }
+
+    pool->job(pool->job_args + worker->thread_id * pool->job_arg_size);
+
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+      pthread_mutex_lock(&pool->lock);
+      pthread_cond_signal(&pool->done);
+      pthread_mutex_unlock(&pool->lock);
+    }
+  }
+
+  return 0;
+}
+
+// Publishes a new generation and wakes the parked workers.
+static void thread_pool_publish(ThreadPool* pool) {
+  pthread_mutex_lock(&pool->lock);
+  atomic_fetch_add_explicit(&pool->generation, 1, memory_order_release);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+int thread_pool_init(ThreadPool* pool, int total_threads, int keep_hot) {
+  int i;
+
+  memset(pool, 0, sizeof(ThreadPool));
+  pool->total_threads = total_threads;
+  pool->keep_hot = keep_hot;
+
+  if (!(pool->threads = (pthread_t*)malloc(total_threads * sizeof(pthread_t))) ||
+      !(pool->workers = (ThreadPoolWorker*)malloc(total_threads * sizeof(ThreadPoolWorker)))) {
+    free(pool->threads);
+    return -1;
+  }
+
+  if (thread_barrier_init(&pool->barrier, total_threads)) {
+    free(pool->threads);
+    free(pool->workers);
+    return -1;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  atomic_init(&pool->generation, 0);
+  atomic_init(&pool->pending, 0);
+  atomic_init(&pool->stop, 0);
+
+  for (i = 1; i < total_threads; ++i) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].thread_id = i;
+    if (pthread_create(pool->threads + i, 0, thread_pool_worker, pool->workers + i)) {
+      fprintf(stderr, "Cannot create thread #%d\n", i);
+      pool->total_threads = i;
+      thread_pool_destroy(pool);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void thread_pool_run(ThreadPool* pool, void* (*job)(void*), void* args, size_t arg_size) {
+  int i;
+
+  pool->job = job;
+  pool->job_args = (char*)args;
+  pool->job_arg_size = arg_size;
+  atomic_store(&pool->pending, pool->total_threads - 1);
+  thread_pool_publish(pool);
+
+  // The calling thread works as thread 0.
+  job(args);
+
+  for (i = 0; i < pool->barrier.spins; ++i) {
+    if (!atomic_load_explicit(&pool->pending, memory_order_acquire)) {
+      return;
+    }
+    thread_spin_pause();
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  while (atomic_load(&pool->pending)) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(ThreadPool* pool) {
+  int i;
+
+  atomic_store(&pool->stop, 1);
+  thread_pool_publish(pool);
+
+  for (i = 1; i < pool->total_threads; ++i) {
+    if (pthread_join(pool->threads[i], 0)) {
+      fprintf(stderr, "Cannot wait for thread #%d\n", i);
+    }
+  }
+
+  thread_barrier_destroy(&pool->barrier);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  pthread_cond_destroy(&pool->done);
+  free(pool->threads);
+  free(pool->workers);
+}
@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "thread_barrier.h"
+
+// Fixed team of worker threads that is created once and reused for every
+// parallel phase. The calling thread joins each job as thread 0.
+//
+// Between jobs the workers spin for a while and then park. With keep_hot they
+// never park, so back-to-back factorizations start without a wake-up, at the
+// price of the workers occupying their CPUs while idle.
+
+// Worker-side view of the pool.
+typedef struct _ThreadPoolWorker {
+  struct _ThreadPool* pool;  // Owning pool.
+  int thread_id;             // Index of the worker, 1..total_threads-1.
+} ThreadPoolWorker;
+
+typedef struct _ThreadPool {
+  int total_threads;          // Team size, including the calling thread.
+  int keep_hot;               // Non-zero if idle workers never park.
+  pthread_t* threads;         // Worker threads 1..total_threads-1.
+  ThreadPoolWorker* workers;  // Arguments of the worker threads.
+  pthread_mutex_t lock;       // Protects parking on the condition variables.
+  pthread_cond_t wake;        // Signals a new job or shutdown.
+  pthread_cond_t done;        // Signals that all workers finished the job.
+  void* (*job)(void*);        // Function run by every thread of the team.
+  char* job_args;             // Per-thread argument array of the job.
+  size_t job_arg_size;        // Size of one element of job_args.
+  atomic_long generation;     // Incremented for every job.
+  atomic_int pending;         // Workers still running the current job.
+  atomic_int stop;            // Set when the pool shuts down.
+  ThreadBarrier barrier;      // Team barrier available to the jobs.
+} ThreadPool;
+
+// Starts total_threads - 1 workers.
+// keep_hot: non-zero to keep idle workers spinning instead of parking.
+// Returns: 0 on success, -1 if the threads cannot be created.
+int thread_pool_init(ThreadPool* pool, int total_threads, int keep_hot);
+
+// Runs job((char*)args + thread_id * arg_size) on every thread of the team
+// and returns when all of them have finished.
+void thread_pool_run(ThreadPool* pool, void* (*job)(void*), void* args, size_t arg_size);
+
+// Stops and joins the workers.
+void thread_pool_destroy(ThreadPool* pool);
+
+#endif  // THREAD_POOL_H
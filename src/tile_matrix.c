@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200112L
+#include "tile_matrix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_op.h"
+
+// Alignment of every tile slot when block_size * block_size is a multiple of 8.
+const int TILE_ALIGNMENT = 64;
+
+int tile_count(int matrix_size, int block_size) {
+  return (matrix_size + block_size - 1) / block_size;
+}
+
+size_t tile_matrix_length(int matrix_size, int block_size) {
+  size_t nb = tile_count(matrix_size, block_size);
+  return ((nb * (nb + 1)) / 2) * block_size * block_size;
+}
+
+double* tile_matrix_alloc(int matrix_size, int block_size) {
+  void* tiles;
+  size_t len = tile_matrix_length(matrix_size, block_size) * sizeof(double);
+
+  if (posix_memalign(&tiles, TILE_ALIGNMENT, len)) {
+    return NULL;
+  }
+  memset(tiles, 0, len);
+  return (double*)tiles;
+}
+
+void* tile_matrix_reserve(size_t size) {
+  void* tiles;
+
+  return posix_memalign(&tiles, TILE_ALIGNMENT, size) ? NULL : tiles;
+}
+
+// Tiles of block row bi start right after the nb - k tiles of every earlier
+// block row k, mirroring the packed element indexing one level up.
+double* tile_block(double* tiles, int row, int column, int matrix_size, int block_size) {
+  int nb = tile_count(matrix_size, block_size);
+  int bi = row / block_size;
+  int bj = column / block_size;
+  size_t k = (((size_t)bi * ((nb << 1) - bi + 1)) >> 1) + bj - bi;
+
+  return tiles + k * block_size * block_size;
+}
+
+// Packed to tile-major conversion, one tile at a time.
+void packed_to_tiles(int matrix_size, int block_size, double* packed, double* tiles) {
+  packed_to_tile_rows(matrix_size, block_size, packed, tiles, 0, 1);
+}
+
+void packed_to_tile_rows(int matrix_size, int block_size, double* packed, double* tiles,
+                         int first_row, int row_step) {
+  int i, j, pn, pm;
+
+  for (i = first_row * block_size; i < matrix_size; i += row_step * block_size) {
+    pn = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    cpy_diagonal_block_to_block(packed, i, matrix_size, pn,
+                                tile_block(tiles, i, i, matrix_size, block_size));
+
+    for (j = i + block_size; j < matrix_size; j += block_size) {
+      pm = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      cpy_matrix_block_to_block(packed, i, j, matrix_size, pn, pm,
+                                tile_block(tiles, i, j, matrix_size, block_size));
+    }
+  }
+}
+
+// Tile-major to packed conversion, one tile at a time.
+void tiles_to_packed(int matrix_size, int block_size, double* tiles, double* packed) {
+  int i, j, pn, pm;
+
+  for (i = 0; i < matrix_size; i += block_size) {
+    pn = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    cpy_block_to_diagonal_block(packed, i, matrix_size, pn,
+                                tile_block(tiles, i, i, matrix_size, block_size));
+
+    for (j = i + block_size; j < matrix_size; j += block_size) {
+      pm = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      cpy_block_to_matrix_block(packed, i, j, matrix_size, pn, pm,
+                                tile_block(tiles, i, j, matrix_size, block_size));
+    }
+  }
+}
+
+float* tile_block_float(float* tiles, int row, int column, int matrix_size, int block_size) {
+  int nb = tile_count(matrix_size, block_size);
+  int bi = row / block_size;
+  int bj = column / block_size;
+  size_t k = (((size_t)bi * ((nb << 1) - bi + 1)) >> 1) + bj - bi;
+
+  return tiles + k * block_size * block_size;
+}
+
+// Walks the packed rows once; element (i, j) of the upper triangle lands in
+// tile (i / block_size, j / block_size), whose rows are pm wide.
+void packed_to_tile_rows_float(int matrix_size, int block_size, double* packed, float* tiles,
+                               int first_row, int row_step) {
+  int i, j, r, c, pn, pm;
+  double* row;
+  float* tile;
+
+  for (i = first_row * block_size; i < matrix_size; i += row_step * block_size) {
+    pn = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    for (r = i; r < i + pn; ++r) {
+      row = packed + packed_row_offset(matrix_size, r) - r;
+      for (j = i; j < matrix_size; j += block_size) {
+        pm = (j + block_size < matrix_size ? block_size : matrix_size - j);
+        tile = tile_block_float(tiles, i, j, matrix_size, block_size) + (r - i) * pm - j;
+        for (c = (j > r ? j : r); c < j + pm; ++c) {
+          tile[c] = (float)row[c];
+        }
+      }
+    }
+  }
+}
+
+void tiles_float_to_packed(int matrix_size, int block_size, float* tiles, double* packed) {
+  int i, j, r, c, pm;
+  double* row;
+  float* tile;
+
+  for (r = 0; r < matrix_size; ++r) {
+    i = r - r % block_size;
+    row = packed + packed_row_offset(matrix_size, r) - r;
+    for (j = i; j < matrix_size; j += block_size) {
+      pm = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      tile = tile_block_float(tiles, i, j, matrix_size, block_size) + (r - i) * pm - j;
+      for (c = (j > r ? j : r); c < j + pm; ++c) {
+        row[c] = tile[c];
+      }
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef TILE_MATRIX_H
+#define TILE_MATRIX_H
+
+#include <stddef.h>
+
+// Tile-major storage for the upper triangle of a symmetric matrix.
+//
+// The matrix is split into block_size x block_size tiles. Tiles of the upper
+// block triangle are stored one after another in block-row order, every tile
+// occupying a block_size * block_size slot. Inside a slot the tile is kept
+// row-major and contiguous, with its actual (possibly truncated) width as the
+// row stride, which is exactly the layout the block kernels in array_op.h
+// expect. Diagonal tiles are stored as full squares; only their upper
+// triangle is meaningful.
+
+// Number of tiles along one dimension of the matrix.
+int tile_count(int matrix_size, int block_size);
+
+// Number of doubles needed to store the matrix in tile-major format.
+size_t tile_matrix_length(int matrix_size, int block_size);
+
+// Allocates zero-initialized, cache-line aligned tile-major storage.
+// Returns: NULL if there is not enough memory.
+double* tile_matrix_alloc(int matrix_size, int block_size);
+
+// Allocates cache line aligned storage of the given size without touching
+// it, so that the threads that own the tiles can place the pages on their
+// NUMA nodes by writing them first.
+// Returns: NULL if there is not enough memory.
+void* tile_matrix_reserve(size_t size);
+
+// Returns a pointer to the tile which starts at element (row, column).
+//
+// row, column: Element offsets of the tile, multiples of block_size with
+//              row <= column.
+double* tile_block(double* tiles, int row, int column, int matrix_size, int block_size);
+
+// Converts a packed upper triangular matrix to tile-major format.
+void packed_to_tiles(int matrix_size, int block_size, double* packed, double* tiles);
+
+// Converts the block rows first_row, first_row + row_step, ... of a packed
+// matrix, so that several threads can share one conversion.
+void packed_to_tile_rows(int matrix_size, int block_size, double* packed, double* tiles,
+                         int first_row, int row_step);
+
+// Converts a tile-major matrix back to packed upper triangular format.
+void tiles_to_packed(int matrix_size, int block_size, double* tiles, double* packed);
+
+// Single precision storage with the same layout, for the mixed precision
+// factorization. The packed matrix stays in double precision.
+//
+// Returns a pointer to the tile which starts at element (row, column).
+float* tile_block_float(float* tiles, int row, int column, int matrix_size, int block_size);
+
+// Rounds the block rows first_row, first_row + row_step, ... of a packed
+// matrix to single precision tiles.
+void packed_to_tile_rows_float(int matrix_size, int block_size, double* packed, float* tiles,
+                               int first_row, int row_step);
+
+// Converts a single precision tile-major matrix to packed double precision.
+void tiles_float_to_packed(int matrix_size, int block_size, float* tiles, double* packed);
+
+#endif  // TILE_MATRIX_H
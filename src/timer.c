@@ -201,4 +201,10 @@ double get_time_pthread(void) {
   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &timer);
   return (double)(timer.tv_sec) * 1e9 + (double)(timer.tv_nsec);
 }
+
+double get_time_monotonic(void) {
+  struct timespec timer;
+  clock_gettime(CLOCK_MONOTONIC, &timer);
+  return (double)(timer.tv_sec) * 1e9 + (double)(timer.tv_nsec);
+}
 #endif
@@ -42,4 +42,8 @@ void sprint_time(char* buffer);
 // Returns: Thread CPU time in nanoseconds.
 double get_time_pthread(void);
 
+// Gets a monotonic wall clock time for measuring short intervals.
+// Returns: Wall clock time in nanoseconds.
+double get_time_monotonic(void);
+
 #endif  // TIMER_H
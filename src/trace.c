@@ -0,0 +1,277 @@
+#include "trace.h"
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "timer.h"
+
+// Events allocated at once per thread.
+const int TRACE_CHUNK = 4096;
+
+static const char* const TRACE_PHASE_NAMES[TRACE_PHASE_COUNT] = {"update", "factor", "scale",
+                                                                  "wait"};
+
+static const char* const TRACE_COUNTER_NAMES[TRACE_COUNTER_COUNT] = {"cycles", "instructions",
+                                                                      "llc_misses"};
+
+// Opens the counters of the calling thread as one group, so that a single
+// read returns all of them. User space only, which unprivileged processes
+// may count with the default perf_event_paranoid.
+// fds: Receives the group, leader first.
+// Returns: 0 on success, -1 if the counters are not available.
+static int trace_open_counters(int* fds) {
+  static const uint64_t configs[TRACE_COUNTER_COUNT] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+  struct perf_event_attr attr;
+  int c, k;
+
+  for (c = 0; c < TRACE_COUNTER_COUNT; ++c) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[c];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = !c;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    if ((fds[c] = syscall(SYS_perf_event_open, &attr, 0, -1, c ? fds[0] : -1, 0)) < 0) {
+      for (k = 0; k < c; ++k) {
+        close(fds[k]);
+        fds[k] = -1;
+      }
+      return -1;
+    }
+  }
+
+  ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return 0;
+}
+
+static void trace_read_counters(TraceThread* thread, uint64_t* values) {
+  uint64_t group[1 + TRACE_COUNTER_COUNT];
+
+  if (thread->perf_fd[0] < 0 ||
+      read(thread->perf_fd[0], group, sizeof(group)) != (ssize_t)sizeof(group)) {
+    memset(values, 0, TRACE_COUNTER_COUNT * sizeof(uint64_t));
+    return;
+  }
+  memcpy(values, group + 1, TRACE_COUNTER_COUNT * sizeof(uint64_t));
+}
+
+int trace_init(Trace* trace, int total_threads, int counters) {
+  int t, c;
+
+  memset(trace, 0, sizeof(Trace));
+  if (!(trace->threads = (TraceThread*)calloc(total_threads, sizeof(TraceThread)))) {
+    return -1;
+  }
+  trace->total_threads = total_threads;
+  trace->counters = counters;
+  for (t = 0; t < total_threads; ++t) {
+    for (c = 0; c < TRACE_COUNTER_COUNT; ++c) {
+      trace->threads[t].perf_fd[c] = -1;
+    }
+  }
+  trace_reset(trace);
+  return 0;
+}
+
+void trace_reset(Trace* trace) {
+  int t;
+
+  if (!trace) {
+    return;
+  }
+  for (t = 0; t < trace->total_threads; ++t) {
+    trace->threads[t].count = 0;
+  }
+  trace->elapsed = 0;
+  trace->origin = get_time_monotonic();
+}
+
+void trace_finish(Trace* trace) {
+  if (trace) {
+    trace->elapsed = get_time_monotonic() - trace->origin;
+  }
+}
+
+void trace_begin(Trace* trace, int thread_id) {
+  TraceThread* thread;
+
+  if (!trace) {
+    return;
+  }
+  thread = trace->threads + thread_id;
+
+  // Counters count the thread that opens them, so every thread opens its own.
+  if (trace->counters && !thread->perf_tried) {
+    thread->perf_tried = 1;
+    if (trace_open_counters(thread->perf_fd) && !thread_id) {
+      printf("Hardware counters are not available\n");
+    }
+  }
+  if (trace->counters) {
+    trace_read_counters(thread, thread->counter_start);
+  }
+  thread->start = get_time_monotonic();
+}
+
+void trace_end(Trace* trace, int thread_id, TracePhase phase, int step, double flops) {
+  TraceThread* thread;
+  TraceEvent* event;
+  double end;
+  int c;
+
+  if (!trace) {
+    return;
+  }
+  end = get_time_monotonic();
+  thread = trace->threads + thread_id;
+
+  if (thread->count == thread->capacity) {
+    event = (TraceEvent*)realloc(thread->events,
+                                 (thread->capacity + TRACE_CHUNK) * sizeof(TraceEvent));
+    if (!event) {
+      return;
+    }
+    thread->events = event;
+    thread->capacity += TRACE_CHUNK;
+  }
+
+  event = thread->events + thread->count++;
+  event->phase = phase;
+  event->step = step;
+  event->start = thread->start - trace->origin;
+  event->end = end - trace->origin;
+  event->flops = flops;
+  if (trace->counters) {
+    trace_read_counters(thread, event->counters);
+    for (c = 0; c < TRACE_COUNTER_COUNT; ++c) {
+      event->counters[c] -= thread->counter_start[c];
+    }
+  } else {
+    memset(event->counters, 0, sizeof(event->counters));
+  }
+}
+
+int trace_barrier_wait(Trace* trace, int thread_id, ThreadBarrier* barrier, int step) {
+  int result;
+
+  trace_begin(trace, thread_id);
+  result = thread_barrier_wait(barrier);
+  trace_end(trace, thread_id, TRACE_WAIT, step, 0);
+  return result;
+}
+
+int trace_write_chrome(const Trace* trace, const char* file_name) {
+  FILE* file = fopen(file_name, "w");
+  const TraceEvent* event;
+  int t, e, c, first = 1;
+
+  if (!file) {
+    printf("Cannot write trace %s\n", file_name);
+    return -1;
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  for (t = 0; t < trace->total_threads; ++t) {
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+                  "\"args\":{\"name\":\"Thread %d\"}}",
+            first ? "" : ",\n", t, t);
+    first = 0;
+    for (e = 0; e < trace->threads[t].count; ++e) {
+      event = trace->threads[t].events + e;
+      fprintf(file,
+              ",\n{\"name\":\"%s\",\"cat\":\"cholesky\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+              "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%d,\"flops\":%.0f",
+              TRACE_PHASE_NAMES[event->phase], t, event->start / 1000.0,
+              (event->end - event->start) / 1000.0, event->step, event->flops);
+      if (trace->counters) {
+        for (c = 0; c < TRACE_COUNTER_COUNT; ++c) {
+          fprintf(file, ",\"%s\":%llu", TRACE_COUNTER_NAMES[c],
+                  (unsigned long long)event->counters[c]);
+        }
+      }
+      fprintf(file, "}}");
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  if (fclose(file)) {
+    printf("Cannot write trace %s\n", file_name);
+    return -1;
+  }
+  return 0;
+}
+
+void trace_print_summary(const Trace* trace) {
+  double time[TRACE_PHASE_COUNT] = {0};
+  double flops[TRACE_PHASE_COUNT] = {0};
+  uint64_t counters[TRACE_PHASE_COUNT][TRACE_COUNTER_COUNT] = {{0}};
+  double busy, total_time = 0, total_flops = 0;
+  const TraceEvent* event;
+  int t, e, p, c;
+
+  for (t = 0; t < trace->total_threads; ++t) {
+    busy = 0;
+    for (e = 0; e < trace->threads[t].count; ++e) {
+      event = trace->threads[t].events + e;
+      time[event->phase] += event->end - event->start;
+      flops[event->phase] += event->flops;
+      for (c = 0; c < TRACE_COUNTER_COUNT; ++c) {
+        counters[event->phase][c] += event->counters[c];
+      }
+      if (event->phase != TRACE_WAIT) {
+        busy += event->end - event->start;
+      }
+    }
+    printf("Thread %d: busy %.2f ms of %.2f ms\n", t, busy / 1e6, trace->elapsed / 1e6);
+  }
+  for (p = 0; p < TRACE_PHASE_COUNT; ++p) {
+    total_time += time[p];
+    total_flops += flops[p];
+  }
+
+  printf("%-8s %12s %7s %10s", "phase", "time (ms)", "share", "GFLOP/s");
+  if (trace->counters) {
+    printf(" %14s %14s %12s", TRACE_COUNTER_NAMES[0], TRACE_COUNTER_NAMES[1],
+           TRACE_COUNTER_NAMES[2]);
+  }
+  printf("\n");
+  for (p = 0; p < TRACE_PHASE_COUNT; ++p) {
+    printf("%-8s %12.3f %6.1f%% %10.2f", TRACE_PHASE_NAMES[p], time[p] / 1e6,
+           total_time > 0 ? 100.0 * time[p] / total_time : 0.0,
+           time[p] > 0 ? flops[p] / time[p] : 0.0);
+    if (trace->counters) {
+      printf(" %14llu %14llu %12llu", (unsigned long long)counters[p][0],
+             (unsigned long long)counters[p][1], (unsigned long long)counters[p][2]);
+    }
+    printf("\n");
+  }
+  printf("Decomposition: %.3f ms, %.3f GFLOP, %.2f GFLOP/s\n", trace->elapsed / 1e6,
+         total_flops / 1e9, trace->elapsed > 0 ? total_flops / trace->elapsed : 0.0);
+}
+
+void trace_destroy(Trace* trace) {
+  int t, c;
+
+  if (!trace->threads) {
+    return;
+  }
+  for (t = 0; t < trace->total_threads; ++t) {
+    for (c = 0; c < TRACE_COUNTER_COUNT; ++c) {
+      if (trace->threads[t].perf_fd[c] >= 0) {
+        close(trace->threads[t].perf_fd[c]);
+      }
+    }
+    free(trace->threads[t].events);
+  }
+  free(trace->threads);
+  trace->threads = NULL;
+}
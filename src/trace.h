@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "thread_barrier.h"
+
+// Per-thread, per-step timeline of a decomposition.
+//
+// Every worker records one event per tile operation and per barrier wait:
+// the phase, the block step, nanosecond timestamps, the floating point
+// operations the kernel performs and, optionally, hardware counters read
+// through perf_event_open. The timeline is exported as Chrome trace JSON
+// (chrome://tracing, Perfetto) and condensed into a per-phase summary, which
+// shows whether a slow run is bound by the kernels or by waiting.
+//
+// Every function accepts a NULL trace and then does nothing, so the engines
+// call them unconditionally.
+
+typedef enum {
+  TRACE_UPDATE = 0,  // Stage 1: C -= A^T D B updates of the trailing tiles.
+  TRACE_FACTOR = 1,  // Stage 2: factorization of a diagonal tile.
+  TRACE_SCALE = 2,   // Stage 3: solve of a row tile against the diagonal tile.
+  TRACE_WAIT = 3,    // Barrier waits, or idle time without a ready task.
+  TRACE_PHASE_COUNT = 4,
+} TracePhase;
+
+// Hardware counters read when enabled: cycles, instructions, LLC misses.
+#define TRACE_COUNTER_COUNT 3
+
+typedef struct _TraceEvent {
+  TracePhase phase;                        // What the thread was doing.
+  int step;                                // Block step (block row) of the operation, or -1.
+  double start;                            // Start in ns since the trace origin.
+  double end;                              // End in ns since the trace origin.
+  double flops;                            // Floating point operations of the kernels.
+  uint64_t counters[TRACE_COUNTER_COUNT];  // Hardware counter deltas, or zeros.
+} TraceEvent;
+
+// Events of one thread, written only by that thread.
+typedef struct _TraceThread {
+  TraceEvent* events;                           // Recorded events.
+  int count;                                    // Number of recorded events.
+  int capacity;                                 // Allocated events.
+  double start;                                 // Start of the open event.
+  uint64_t counter_start[TRACE_COUNTER_COUNT];  // Counters at the start of the open event.
+  int perf_fd[TRACE_COUNTER_COUNT];             // Counter group, leader first, or -1.
+  int perf_tried;                               // Non-zero once opening was attempted.
+  char pad[64];                                 // Keeps threads on separate cache lines.
+} TraceThread;
+
+typedef struct _Trace {
+  int total_threads;     // Number of traced threads.
+  int counters;          // Non-zero to read hardware counters.
+  double origin;         // Monotonic time of trace_reset in ns.
+  double elapsed;        // Wall time of the traced run in ns, set by trace_finish.
+  TraceThread* threads;  // Per-thread event buffers.
+} Trace;
+
+// Returns: 0 on success, -1 if there is not enough memory.
+int trace_init(Trace* trace, int total_threads, int counters);
+
+// Drops the recorded events and restarts the clock.
+void trace_reset(Trace* trace);
+
+// Stops the clock of the traced run.
+void trace_finish(Trace* trace);
+
+// Opens an event on the calling thread.
+void trace_begin(Trace* trace, int thread_id);
+
+// Closes the open event of the calling thread and records it.
+void trace_end(Trace* trace, int thread_id, TracePhase phase, int step, double flops);
+
+// thread_barrier_wait() recorded as a TRACE_WAIT event.
+int trace_barrier_wait(Trace* trace, int thread_id, ThreadBarrier* barrier, int step);
+
+// Writes the events as Chrome trace JSON, timestamps in microseconds.
+// Returns: 0 on success, -1 if the file cannot be written.
+int trace_write_chrome(const Trace* trace, const char* file_name);
+
+// Prints the time, share and rate of every phase, the overall GFLOP/s and,
+// when enabled, the counter totals.
+void trace_print_summary(const Trace* trace);
+
+// Closes the counters and releases the buffers.
+void trace_destroy(Trace* trace);
+
+#endif  // TRACE_H
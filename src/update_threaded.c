@@ -0,0 +1,122 @@
+#include "update_threaded.h"
+
+#include <math.h>
+
+#include "tile_matrix.h"
+
+// Pivots below this magnitude make the modified matrix singular, as in
+// cholesky_for_block.
+const double UPDATE_EPS = 1e-16;
+
+// Entry point for each update thread.
+void* update_threaded(void* ptr) {
+  UpdateArgs* pa = (UpdateArgs*)ptr;
+
+  update_factor(pa->matrix_size, pa->matrix, pa->diagonal, pa->vectors, pa->rank, pa->weights,
+                pa->coefficients, pa->block_size, pa->thread_id, pa->total_threads, pa->barrier,
+                pa->error);
+
+  return 0;
+}
+
+// Runs the rank-one recurrence for every vector on the n x n diagonal tile a
+// and the matching n columns of the vectors, which are stride elements
+// apart. Records for row i and vector k the map applied to the elements to
+// the right of the pivot at coefficients[3 * (i * rank + k)]:
+//   v_k -= c0 * r_i;  r_i = c1 * r_i + c2 * v_k.
+// Returns: 0 on success, -1 if a pivot vanishes.
+static int update_diagonal_block(int n, int rank, int stride, double* a, double* diagonal,
+                                 double* vectors, double* weights, double* coefficients) {
+  double *ai, *vk, *c;
+  double p, old_pivot, new_pivot, scaled;
+  int i, j, k;
+
+  for (i = 0; i < n; ++i) {
+    ai = a + i * n;
+    for (k = 0; k < rank; ++k) {
+      vk = vectors + k * stride;
+      c = coefficients + 3 * (i * rank + k);
+      p = vk[i];
+
+      // The pivot of L * E * L^T with unit L is d * r^2.
+      old_pivot = diagonal[i] * ai[i] * ai[i];
+      new_pivot = old_pivot + weights[k] * p * p;
+      scaled = sqrt(fabs(new_pivot));
+      if (scaled < UPDATE_EPS) {
+        return -1;
+      }
+      c[0] = p / ai[i];
+      c[1] = scaled / ai[i];
+      c[2] = scaled * p * weights[k] / new_pivot;
+      weights[k] *= old_pivot / new_pivot;
+
+      for (j = i + 1; j < n; ++j) {
+        vk[j] -= c[0] * ai[j];
+        ai[j] = c[1] * ai[j] + c[2] * vk[j];
+      }
+      ai[i] = scaled;
+      diagonal[i] = new_pivot < 0 ? -1.0 : 1.0;
+    }
+  }
+  return 0;
+}
+
+// Applies the maps recorded by update_diagonal_block to the rows x columns
+// tile a right of the diagonal and the matching columns of the vectors.
+static void update_off_diagonal_block(int rows, int columns, int rank, int stride,
+                                      const double* coefficients, double* a, double* vectors) {
+  const double* c;
+  double *ai, *vk;
+  int i, j, k;
+
+  for (i = 0; i < rows; ++i) {
+    ai = a + i * columns;
+    for (k = 0; k < rank; ++k) {
+      vk = vectors + k * stride;
+      c = coefficients + 3 * (i * rank + k);
+      for (j = 0; j < columns; ++j) {
+        vk[j] -= c[0] * ai[j];
+        ai[j] = c[1] * ai[j] + c[2] * vk[j];
+      }
+    }
+  }
+}
+
+int update_factor(int matrix_size, double* matrix, double* diagonal, double* vectors, int rank,
+                  double* weights, double* coefficients, int block_size, int thread_id,
+                  int total_threads, ThreadBarrier* barrier, int* error) {
+  int i, j, pi_n, pj_n;
+  int step = total_threads * block_size;
+  double* map;
+
+  for (i = 0; i < matrix_size; i += block_size) {
+    pi_n = (i + block_size < matrix_size ? block_size : matrix_size - i);
+    // The maps of two consecutive steps alternate, so the owner of the next
+    // step does not overwrite the ones still being applied.
+    map = coefficients + ((i / block_size) % 2) * 3 * block_size * rank;
+
+    if ((i / block_size) % total_threads == thread_id &&
+        update_diagonal_block(pi_n, rank, matrix_size,
+                              tile_block(matrix, i, i, matrix_size, block_size), diagonal + i,
+                              vectors + i, weights, map)) {
+      *error = 1;
+    }
+
+    thread_barrier_wait(barrier);
+    if (*error) {
+      return -1;
+    }
+
+    // Start at the first block column after i owned by this thread.
+    j = i + block_size +
+        ((thread_id - (i / block_size + 1) % total_threads + total_threads) % total_threads) *
+            block_size;
+    for (; j < matrix_size; j += step) {
+      pj_n = (j + block_size < matrix_size ? block_size : matrix_size - j);
+      update_off_diagonal_block(pi_n, pj_n, rank, matrix_size, map,
+                                tile_block(matrix, i, j, matrix_size, block_size), vectors + j);
+    }
+  }
+
+  return 0;
+}
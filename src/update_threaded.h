@@ -0,0 +1,43 @@
+#ifndef UPDATE_THREADED_H
+#define UPDATE_THREADED_H
+
+#include "thread_barrier.h"
+
+// Arguments passed to each update thread.
+typedef struct _UpdateArgs {
+  int matrix_size;         // Total size of the matrix (N x N).
+  double* matrix;          // Tile-major factor R, updated in place.
+  double* diagonal;        // Diagonal scaling elements D, updated in place.
+  double* vectors;         // K x N update vectors, one per row, destroyed.
+  int rank;                // Number of update vectors K.
+  double* weights;         // K scaling factors of the vectors, destroyed.
+  double* coefficients;    // 2 x 3 x M x K maps of the last two block rows.
+  int block_size;          // Size of the computation blocks (M x M).
+  int thread_id;           // Unique ID for the current thread.
+  int total_threads;       // Total number of active threads.
+  ThreadBarrier* barrier;  // Synchronization barrier.
+  int* error;              // Shared error flag for re-entrant reporting.
+} UpdateArgs;
+
+// Entry point for pthread_create.
+void* update_threaded(void* ptr);
+
+// Multi-threaded rank-K modification of a factor: turns R^T * D * R into the
+// factor of R^T * D * R + sum_k weights[k] * v_k * v_k^T in O(K * N^2), with
+// weights of +1 for updates and -1 for downdates.
+//
+// Row i of R is revised by the rank-one recurrence of Gill, Golub, Murray and
+// Saunders for every vector in turn, which is the same linear map of rows i of
+// R and of the vectors for all columns right of the pivot. Block column j is
+// owned by thread j mod total_threads. On each step the owner of the current
+// block row runs the recurrence on its diagonal block and records the map of
+// every row and vector in coefficients; after one barrier all threads apply
+// it to their own tiles of the block row and the matching columns of the
+// vectors. A pivot may change its sign, which flips its element of D.
+// Returns: 0 on success, -1 if the modified matrix is singular; the factor is
+//          then partially modified.
+int update_factor(int matrix_size, double* matrix, double* diagonal, double* vectors, int rank,
+                  double* weights, double* coefficients, int block_size, int thread_id,
+                  int total_threads, ThreadBarrier* barrier, int* error);
+
+#endif  // UPDATE_THREADED_H